@@ -0,0 +1,125 @@
+/////////////////////////////////////////////////////
+// FILENAME:    bridge.h                           //
+// DESCRIPTION: radio <-> MQTT message handling    //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio.h"
+#include "route.h"
+#include "stats.h"
+#include "cache.h"
+#include "edge.h"
+#include "journal.h"
+#include "capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Message handling of the base station between the radio lib and MQTT, used by the firmware (main.cpp) and the
+// host replay (tools/replay.c), so both run the same steps:
+// - uplinks, bridge_receive() from receive() of the radio lib: passed on once (route), last value cache, raw topic,
+//   report by exception, published on "base_0x01_rx/..." or stored in the journal while offline
+// - downlinks, bridge_mqtt_in() from the MQTT callback: "base_0x01_tx/...", group messages, bulk transfers and the
+//   control topics "base_0x01_ctl/..."
+// - command status: queued by bridge_tx_status() (called from inside the MQTT callback, publishing there would
+//   overwrite the MQTT buffer the command is still read from), published by bridge_loop()
+// The MQTT client, display and LEDs are callbacks, the journal and the capture are optional (NULL).
+// Configuration: main.h (EDGE_FILTER, GROUP_COLLECT_ACKS, MQTT_RETAIN, RAW_TIMEOUT_MS, BULK_MAX_RESUMES).
+
+#define BRIDGE_TX_STATUS_SIZE 16        // command status reports queued for "base_0x01_tx_status/...", oldest dropped
+                                        // (counted, "txd" of "stats/base")
+#define BRIDGE_TOPIC_SIZE     50
+
+// MQTT client: publish (payload not terminated), connection state
+typedef bool (*bridge_publish_t)  (const char* topic, const uint8_t* payload, uint16_t len, bool retain);
+typedef bool (*bridge_connected_t)(void);
+
+// notifications (optional): uplink passed on, downlink passed to the radio (group message: handle 0),
+// first uplink published (boot phase times), log line
+typedef void (*bridge_rx_t)   (uint8_t source, uint8_t* data, uint16_t len);
+typedef void (*bridge_tx_t)   (uint8_t dest, uint16_t handle, radio_tx_status_t status, uint8_t* data, uint16_t len);
+typedef void (*bridge_event_t)(void);
+typedef void (*bridge_log_t)  (const char* text);
+
+// command status, queued until bridge_loop()
+typedef struct {
+	uint16_t handle;
+	uint8_t  dest;
+	uint8_t  status;                    // radio_tx_status_t
+} bridge_tx_report_t;
+
+typedef struct {
+	route_t*   route;
+	stats_t*   stats;
+	cache_t*   cache;
+	edge_t*    edge;
+	journal_t* journal;                 // NULL = uplinks are dropped while offline
+	capture_t* capture;                 // NULL = no traffic capture
+	uint8_t    address;
+
+	// "base_0x01_ctl/snapshot" received (published by bridge_loop()), "base_0x01_ctl/raw" = on (until RAW_TIMEOUT_MS)
+	bool     snapshot_pending;
+	bool     raw_enabled;
+	uint32_t raw_time;
+
+	// bulk transfer (one blob from "base_0x01_bulk/node_0x11" at a time)
+	uint8_t* bulk_blob;
+	uint32_t bulk_blob_len;
+	uint8_t  bulk_transfer_id;
+	uint8_t  bulk_resume_cnt;
+	radio_t* bulk_radio;                // radio of the destination
+
+	// command status
+	bridge_tx_report_t tx_reports[BRIDGE_TX_STATUS_SIZE];
+	uint8_t  tx_report_head;
+	uint8_t  tx_report_count;
+
+	// callback functions
+	bridge_publish_t   publish;
+	bridge_connected_t connected;
+	bridge_rx_t        rx;
+	bridge_tx_t        tx;
+	bridge_event_t     first_publish;
+	bridge_log_t       log;
+} bridge_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void bridge_init(bridge_t* obj, uint8_t address, route_t* route, stats_t* stats, cache_t* cache, edge_t* edge,
+                 journal_t* journal, capture_t* capture);
+void bridge_set_cb_mqtt  (bridge_t* obj, void* publish, void* connected);
+void bridge_set_cb_notify(bridge_t* obj, void* rx, void* tx, void* first_publish, void* log);
+
+// receive() of the radio lib
+void bridge_receive(bridge_t* obj, uint8_t source, uint8_t* data, uint16_t len, uint32_t time);
+
+// MQTT message ("base_0x01_tx/+", "base_0x01_bulk/+", "base_0x01_ctl/+"), false = no destination
+bool bridge_mqtt_in(bridge_t* obj, const char* topic, uint8_t* payload, uint16_t len, uint32_t time);
+
+// command status reports, snapshot (after the journal replay), raw topic timeout
+void bridge_loop(bridge_t* obj, uint32_t time);
+
+// "base_0x01_rx/nodes_0x10/node_0x11" (journal replay, snapshot), aggregates of edge.h on "base_0x01_agg/..."
+bool bridge_publish_rx       (bridge_t* obj, uint8_t node, char* payload, uint16_t len, uint32_t time);
+void bridge_publish_aggregate(bridge_t* obj, uint8_t node, char* payload, uint16_t len);
+
+// callbacks of the radio lib (radio_set_cb_tx_status(), radio_set_cb_bulk())
+void     bridge_tx_status(bridge_t* obj, uint8_t dest, uint16_t handle, radio_tx_status_t status);
+uint16_t bridge_bulk_read(bridge_t* obj, uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len);
+void     bridge_bulk_done(bridge_t* obj, uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset);
+
+// bulk transfer: resume after a pause (e.g. sleeping node), given up after BULK_MAX_RESUMES
+void bridge_bulk_resume (bridge_t* obj);
+bool bridge_bulk_running(bridge_t* obj);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////
+// FILENAME:    cache.h                            //
+// DESCRIPTION: last value cache of the nodes      //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// last uplink message of each node, stored back to back in a fixed arena (no malloc)
+// the arena is compacted if the free space at the end is too small, the oldest value is discarded if still full
+#define CACHE_ARENA_SIZE      4096
+#define CACHE_MAX_ENTRIES     32
+#define CACHE_MAX_VALUE_SIZE  512     // longer messages are not cached
+
+typedef struct {
+	bool     valid;
+	uint8_t  node;
+	uint16_t offset;                  // position in the arena
+	uint16_t length;
+	uint32_t time;                    // time of the update
+} cache_entry_t;
+
+typedef struct {
+	uint8_t  arena[CACHE_ARENA_SIZE];
+	uint16_t arena_end;               // first unused byte (behind it everything is free)
+	uint16_t arena_used;              // bytes of valid entries
+	cache_entry_t entries[CACHE_MAX_ENTRIES];
+	uint32_t evictions;               // values discarded because the arena or the table was full
+} cache_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void cache_init(cache_t* obj);
+
+// store the last value of a node, false = not cached (too long)
+bool cache_put(cache_t* obj, uint8_t node, uint8_t* data, uint16_t len, uint32_t time);
+
+// entry of a node, NULL = no value
+cache_entry_t* cache_get(cache_t* obj, uint8_t node);
+
+// iterate all values: for (int i = 0; i < CACHE_MAX_ENTRIES; i++) { if (obj->entries[i].valid) { ... } }
+uint8_t* cache_data(cache_t* obj, cache_entry_t* entry);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,135 @@
+/////////////////////////////////////////////////////
+// FILENAME:    capture.h                          //
+// DESCRIPTION: radio / MQTT traffic capture       //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary trace of the radio frames and MQTT messages of the base station, replayed on a host (see tools/replay.c).
+// The trace is a sequence of blocks (little endian), written to a file (LittleFS) or streamed (serial):
+//   [0xA6][length (2)][time (4)][records (length)][crc8]
+// every record starts with [type][time (varint, ms since the previous record of the block)]:
+//   START     [version][base address][radios]
+//   RX        [radio][source][rssi][flags][length][frame]    frame with radio header, flags see CAPTURE_FLAG_x
+//   TX        [radio][destination][flags][length][frame]
+//   ACK       [radio][source]                                ACK received for the frame in flight
+//   MQTT_IN   [topic length][topic][length (2)][payload]
+//   MQTT_OUT  [topic length][topic][length (2)]               (payload not stored, the uplinks are in the RX frames)
+// A stream may be mixed with debug output, the reader skips everything that is not a valid block.
+// The file is accessed with stdio like the journal (e.g. "/littlefs/capture.bin"), on a host it is a normal file.
+
+#define CAPTURE_VERSION             1
+#define CAPTURE_BLOCK_SIZE          512       // records are collected in RAM and written in blocks (flash wear)
+#define CAPTURE_FLUSH_INTERVAL_MS   5000      // max time a record stays in RAM
+#define CAPTURE_MAX_SIZE            1048576   // file capture stops when the file is full (bytes)
+#define CAPTURE_PATH_SIZE           32
+
+#define CAPTURE_FLAG_ACK_REQUESTED  0x01      // RX: sender requested an ACK
+#define CAPTURE_FLAG_BROADCAST      0x02      // RX: sent to the broadcast address
+#define CAPTURE_FLAG_ACK            0x04      // TX: ACK frame (radio_rfm_sendACK())
+
+typedef enum {
+	capture_START = 1,
+	capture_RX,
+	capture_TX,
+	capture_ACK,
+	capture_MQTT_IN,
+	capture_MQTT_OUT
+} capture_type_t;
+
+typedef enum {
+	capture_OFF,
+	capture_FILE,                 // append to the file (new file per capture_start())
+	capture_SERIAL                // stream output, see capture_init()
+} capture_mode_t;
+
+// stream output (e.g. Serial.write()), false = not written
+typedef bool (*capture_write_t)(uint8_t* data, uint16_t len);
+
+typedef struct {
+	char     path[CAPTURE_PATH_SIZE];
+	uint8_t  block[CAPTURE_BLOCK_SIZE];   // header + records + crc
+	uint16_t block_len;                   // 0 = no record yet
+	uint16_t block_records;
+	uint32_t time_block;          // time of the first record in the block
+	uint32_t time_last;           // time of the last record (deltas)
+	uint32_t size;                // bytes in the file
+	capture_mode_t  mode;
+	capture_write_t write;
+
+	// statistics
+	uint32_t records;
+	uint32_t records_dropped;     // file full, no memory or write error
+	uint32_t bytes;               // written to the file / stream
+} capture_t;
+
+// record read from a trace
+typedef struct {
+	capture_type_t type;
+	uint32_t time;                // ms (time base of the base station)
+	uint8_t  radio;               // START: number of radios
+	uint8_t  address;             // RX / ACK: source, TX: destination, START: base address
+	int8_t   rssi;                // RX (dBm)
+	uint8_t  flags;               // RX / TX: CAPTURE_FLAG_x, START: version
+	uint8_t  topic_len;
+	const char* topic;            // MQTT (not terminated)
+	const uint8_t* data;          // frame / MQTT_IN payload, NULL for MQTT_OUT (valid until the next capture_read())
+	uint16_t len;                 // frame / payload length
+} capture_record_t;
+
+typedef struct {
+	FILE*    file;
+	uint8_t* block;               // records of the current block (HEAP_MALLOC)
+	uint16_t len;
+	uint16_t pos;
+	uint32_t time;
+
+	// statistics
+	uint32_t blocks;
+	uint32_t blocks_damaged;      // CRC error, incomplete or malformed block
+	uint32_t bytes_skipped;       // not part of a block (e.g. debug output of a serial stream)
+} capture_reader_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+// path of the file capture, write = stream output (optional)
+void capture_init (capture_t* obj, const char* path, capture_write_t write);
+
+// start a new trace (capture_FILE: the old file is replaced), false = no file / stream output
+bool capture_start(capture_t* obj, capture_mode_t mode, uint8_t address, uint8_t radios, uint32_t time);
+void capture_stop (capture_t* obj);
+
+// records (ignored while off)
+void capture_rx      (capture_t* obj, uint8_t radio, uint8_t source, int16_t rssi, uint8_t flags, uint8_t* frame, uint8_t len, uint32_t time);
+void capture_tx      (capture_t* obj, uint8_t radio, uint8_t dest, uint8_t flags, uint8_t* frame, uint8_t len, uint32_t time);
+void capture_ack     (capture_t* obj, uint8_t radio, uint8_t source, uint32_t time);
+void capture_mqtt_in (capture_t* obj, const char* topic, uint8_t* payload, uint16_t len, uint32_t time);
+void capture_mqtt_out(capture_t* obj, const char* topic, uint16_t len, uint32_t time);
+
+// write the block on time
+void capture_loop (capture_t* obj, uint32_t time);
+void capture_flush(capture_t* obj);
+
+// copy the file to the stream output (e.g. fetch a flash trace over serial), false = no file / stream output
+bool capture_dump (capture_t* obj);
+
+// trace reader (host replay), capture_read() returns false at the end of the trace
+bool capture_read_open (capture_reader_t* obj, const char* path);
+bool capture_read      (capture_reader_t* obj, capture_record_t* record);
+void capture_read_close(capture_reader_t* obj);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,23 +2,25 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <Adafruit_SSD1306.h>
+#include "sched.h"
 
 
 #define DISP_SCREENSAVER_TIME	30
-#define DISP_MAX_MSG_SIZE		100
+#define DISP_MAX_MSG_SIZE		(4 * 21 + 1)	// 4 lines of 21 characters on the message pages + \0
 #define DISP_MAX_IP_SIZE		20
 #define DISP_SLAVE_LIST_PAGES	3		// Anzahl der Seiten. Siehe "Slave RX List"
 #define DISP_SLAVE_LIST_ROWS	5		// Anzahl der Listeneinträge pro Seite. Siehe "Slave RX List"
 #define DISP_SLAVE_LIST_SIZE	DISP_SLAVE_LIST_PAGES * DISP_SLAVE_LIST_ROWS
 
 
+// 8 bytes per slave
 typedef struct {
-	bool	valid;
-	uint8_t addr;
-	float	voltage;
-	bool	voltage_valid; 	// false = no battery voltage is parsable
-	uint32_t time;
-	bool	 time_valid;	// false = time > 9999s
+	uint32_t time;				// sched_millis(), 32 bit are enough (time_valid = false after 9999s)
+	uint16_t voltage_mv;
+	uint8_t  addr;
+	uint8_t  valid			: 1;
+	uint8_t  voltage_valid	: 1;	// false = no battery voltage is parsable
+	uint8_t  time_valid		: 1;	// false = time > 9999s
 } disp_slave_obj;
 
 typedef enum {
@@ -33,26 +35,27 @@ typedef struct {
 	uint8_t last_page;
 	disp_sort_type sort_type;
 	Adafruit_SSD1306 *display;
-	uint32_t time_display;
+	sched_t *sched;			// time base
+	uint64_t time_display;
 
 	// page 1 - general
+	uint64_t uptime_seconds;
 	uint32_t uptime_hours;
-	uint32_t uptime_seconds;
 	char addr_ip[DISP_MAX_IP_SIZE];
 	char addr_mqtt[DISP_MAX_IP_SIZE];
 	uint32_t rx_cnt;
 	uint32_t tx_cnt;
 
 	// page 2 - last msg RX
+	uint64_t last_msg_rx_time;
 	bool	 last_msg_rx_valid;
 	uint8_t  last_msg_rx_addr;
-	uint32_t last_msg_rx_time;
 	char last_msg_rx[DISP_MAX_MSG_SIZE];
 
 	// page 3 - last msg TX
+	uint64_t last_msg_tx_time;
 	bool	 last_msg_tx_valid;
 	uint8_t  last_msg_tx_addr;
-	uint32_t last_msg_tx_time;
 	char last_msg_tx[DISP_MAX_MSG_SIZE];
 
 	// page 4 to x - slave list
@@ -63,7 +66,7 @@ typedef struct {
 
 
 
-void disp_init(disp_t* obj, Adafruit_SSD1306* display, const char* ip_base, const char* ip_mqtt);
+void disp_init(disp_t* obj, Adafruit_SSD1306* display, sched_t* sched, const char* ip_base, const char* ip_mqtt);
 
 void disp_refresh_display(disp_t* obj);
 void disp_set_next_page(disp_t* obj);
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////
+// FILENAME:    edge.h                             //
+// DESCRIPTION: uplink report-by-exception         //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Processing stage between receive() and the MQTT publish, only for flat JSON objects with numeric values
+// (e.g. {"t":21.5,"h":48}), everything else is passed through:
+// - report by exception: a message is published if a value left the deadband of its last published value,
+//   a new value appears or nothing was published for EDGE_HEARTBEAT_MS
+// - downsampling: min / max / avg of every value over EDGE_WINDOW_MS, see edge_loop()
+// The state of all nodes lives in fixed-size tables (least recently heard node is replaced).
+
+#define EDGE_MAX_NODES        16
+#define EDGE_MAX_VALUES       64        // numeric values of all nodes
+#define EDGE_MAX_MSG_VALUES   8         // numeric values per message
+#define EDGE_KEY_SIZE         12        // max key length + 1
+#define EDGE_MAX_PAYLOAD      256       // longer messages are passed through
+#define EDGE_DEADBAND_ABS     0.1f      // change to publish: more than the absolute deadband ...
+#define EDGE_DEADBAND_PCT     1.0f      // ... and more than x percent of the last published value
+#define EDGE_HEARTBEAT_MS     300000    // publish at least every 5 minutes
+#define EDGE_WINDOW_MS        60000     // aggregation window
+#define EDGE_AGG_MAX_PAYLOAD  384
+
+// publish function for the aggregates {"t":{"min":21.1,"max":21.6,"avg":21.3},"n":12}
+typedef void (*edge_publish_t)(uint8_t node, char* data, uint16_t len);
+
+typedef struct {
+	bool     valid;
+	uint8_t  node;
+	char     key[EDGE_KEY_SIZE];
+	float    published;           // last published value
+	float    min;                 // window
+	float    max;
+	float    sum;
+	uint16_t count;
+} edge_value_t;
+
+typedef struct {
+	bool     valid;
+	uint8_t  address;
+	uint32_t time_published;      // last published message
+	uint32_t time_window;         // start of the aggregation window
+	uint32_t time_last;           // last message (replacement)
+	uint16_t window_messages;
+} edge_node_t;
+
+typedef struct {
+	edge_node_t  nodes[EDGE_MAX_NODES];
+	edge_value_t values[EDGE_MAX_VALUES];
+	edge_publish_t publish;
+
+	// statistics
+	uint32_t messages_in;
+	uint32_t messages_published;  // changed, heartbeat or passed through
+	uint32_t messages_suppressed;
+	uint32_t aggregates;
+} edge_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void edge_init(edge_t* obj, edge_publish_t publish);
+
+// true = publish the message, false = suppressed (unchanged)
+bool edge_process(edge_t* obj, uint8_t node, uint8_t* data, uint16_t len, uint32_t time);
+
+// publish the aggregates of all finished windows
+void edge_loop(edge_t* obj, uint32_t time);
+
+// messages not published (suppressed - aggregates) in percent of all messages
+uint8_t edge_reduction(edge_t* obj);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////
+// FILENAME:    heap.h                             //
+// DESCRIPTION: heap allocation monitor            //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// malloc() / free() wrappers (HEAP_MALLOC() / HEAP_FREE()) with counters per call site (file + line):
+// allocated blocks / bytes, peak bytes and failed allocations, a leak shows up as a site with growing blocks.
+// heap_sample() tracks the free heap (low watermark) and the fragmentation (largest free block vs free heap)
+// from the platform functions of heap_init().
+// Every block gets a header of HEAP_HEADER_SIZE bytes, pointers of HEAP_MALLOC() have to be freed by HEAP_FREE().
+
+#define HEAP_MONITOR          true
+#define HEAP_MAX_SITES        24        // further call sites are counted as one "other" site
+#define HEAP_HEADER_SIZE      8         // keeps the 8 byte alignment of malloc()
+
+#if HEAP_MONITOR
+#define HEAP_MALLOC(size)     heap_malloc((size), __FILE__, __LINE__)
+#define HEAP_FREE(ptr)        heap_free(ptr)
+#else
+#define HEAP_MALLOC(size)     malloc(size)
+#define HEAP_FREE(ptr)        free(ptr)
+#endif
+
+typedef struct {
+	const char* file;             // NULL = other call sites (table full)
+	uint16_t line;
+	uint32_t allocs;
+	uint32_t fails;
+	uint32_t blocks;              // allocated now
+	uint32_t bytes;               // allocated now (without headers)
+	uint32_t bytes_max;
+} heap_site_t;
+
+typedef struct {
+	heap_site_t sites[HEAP_MAX_SITES + 1];
+	uint8_t  site_count;
+
+	// all sites
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t fails;
+	uint32_t invalid_frees;       // pointer without a valid header (not from HEAP_MALLOC() or freed twice)
+	uint32_t blocks;
+	uint32_t bytes;
+	uint32_t bytes_max;
+
+	// platform heap, see heap_sample()
+	uint32_t free_size;
+	uint32_t free_min;
+	uint32_t largest_block;
+	uint8_t  fragmentation;       // percent, 100 - largest free block * 100 / free heap
+	uint8_t  fragmentation_max;
+
+	// callback functions (optional)
+	uint32_t (*get_free)(void);
+	uint32_t (*get_largest)(void);
+} heap_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+// free heap / largest free block of the platform, e.g. ESP.getFreeHeap() / ESP.getMaxAllocHeap()
+void heap_init(void* get_free, void* get_largest);
+
+void* heap_malloc(size_t size, const char* file, uint16_t line);
+void  heap_free  (void* ptr);
+
+// update free heap + fragmentation (e.g. once per second)
+void heap_sample(void);
+
+heap_t* heap_get(void);
+
+
+#ifdef __cplusplus
+}
+#endif
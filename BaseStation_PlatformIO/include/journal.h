@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////
+// FILENAME:    journal.h                          //
+// DESCRIPTION: offline uplink journal (flash)     //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Append-only binary log, one record per uplink message (little endian):
+// [0xA5][node][length (2)][time (4)][payload (length)][crc8]
+// The file is accessed with stdio: on the ESP32 through the LittleFS VFS (e.g. "/littlefs/journal.bin"),
+// on a host it is a normal file.
+
+#define JOURNAL_BATCH_SIZE          512       // records are collected in RAM and written in batches (flash wear)
+#define JOURNAL_FLUSH_INTERVAL_MS   10000     // max time a record stays in RAM
+#define JOURNAL_MAX_SIZE            262144    // new records are dropped if the file is full (bytes)
+#define JOURNAL_REPLAY_INTERVAL_MS  50        // time between two replayed records
+#define JOURNAL_PATH_SIZE           32
+
+// publish function for replayed records, false = not published (retried later)
+typedef bool (*journal_publish_t)(uint8_t node, uint8_t* data, uint16_t len, uint32_t time);
+
+typedef struct {
+	char     path[JOURNAL_PATH_SIZE];
+	uint8_t  batch[JOURNAL_BATCH_SIZE];
+	uint16_t batch_len;
+	uint32_t time_batch;          // time of the first record in the batch
+	uint32_t time_replay;         // time of the last replayed record
+	uint32_t size;                // bytes in the file
+	uint32_t replay_offset;       // next record to replay
+	bool     damaged;             // incomplete record not cut off (copy failed), no appends until repaired
+	journal_publish_t publish;
+
+	// statistics
+	uint32_t records_stored;
+	uint32_t records_replayed;
+	uint32_t records_dropped;     // file full, RAM full or write error
+	uint32_t bytes_recovered;     // bytes cut off after an incomplete write (crash)
+} journal_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+// opens an existing journal and removes an incomplete record at the end (crash during write)
+void journal_init (journal_t* obj, const char* path, journal_publish_t publish);
+
+// store an uplink message, false = dropped
+bool journal_add  (journal_t* obj, uint8_t node, uint8_t* data, uint16_t len, uint32_t time);
+
+// flush the batch on time, replay the journal if online (one record per JOURNAL_REPLAY_INTERVAL_MS)
+void journal_loop (journal_t* obj, uint32_t time, bool online);
+
+void journal_flush(journal_t* obj);
+
+// true = nothing to replay (new messages can be published directly without changing the order)
+bool journal_empty(journal_t* obj);
+
+
+#ifdef __cplusplus
+}
+#endif
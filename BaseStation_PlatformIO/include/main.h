@@ -9,6 +9,8 @@
 
 #define PIN_CS_RFM      17
 #define PIN_INT_RFM     25
+#define PIN_CS_RFM_2    26      // second RFM69 (RADIO_COUNT 2)
+#define PIN_INT_RFM_2   27
 #define PIN_CS_W5500    16
 #define PIN_BUTTON      4
 
@@ -18,6 +20,11 @@
 #define FREQUENCY       RF69_433MHZ
 #define ENCRYPTKEY      "1234567812345678"
 
+// RFM69 transceivers (max 2, see route.h): every node is routed to the radio with the best RSSI,
+// the RX / TX buffer sizes (radio_config.h) are shared by the radios
+#define RADIO_COUNT     1
+#define FREQUENCY_2     RF69_433MHZ         // second RFM69, e.g. RF69_868MHZ for another band
+
 
 // MQTT / Ethernet
 // Source: https://github.com/jozala/ESP32_W5500_MQTT
@@ -25,26 +32,101 @@
 #define ETHERNET_IP             "192.168.150.100"   // IP address of Ethernet connection
 #define ETHERNET_RESET_PIN      33                  // ESP32 pin where reset pin from W5500 is connected
 #define ETHERNET_CS_PIN         16                  // ESP32 pin where CS pin from W5500 is connected
+#define ETHERNET_POWER_UP_MS    500                 // delay before the W5500 reset (after the radio is up)
 #define MQTT_HOSTNAME           "192.168.150.101"
 #define MQTT_PORT                   1883
 #define MQTT_PUBLISH_INTERVAL_MS    250
+#define MQTT_BUFFER_SIZE            2048    // max MQTT packet size (bulk transfer payloads)
+#define MQTT_RECONNECT_INTERVAL_MS  5000
+#define MQTT_RETAIN                 true    // node messages are published retained (last value for new subscribers)
+
+// scheduler jobs (see sched.h)
+#define STATUS_INTERVAL_MS          250     // LAN / MQTT state LEDs
+#define BUTTON_POLL_INTERVAL_MS     20
+#define HEAP_SAMPLE_INTERVAL_MS     1000    // heap monitor + orphaned radio buffers (see heap.h, radio_sweep())
+
+// beacon mode (see radio_beacon_enable()): uplinks of the nodes in slots computed from their report intervals,
+// nodes without beacon support would pass the beacons on as messages
+#define BEACON_MODE                 false
+
+// link adaptation (see radio_link_enable()): bitrate step (beacon slots only) and TX power per node from its RSSI / losses,
+// all nodes have to support the control frames (a node ignoring them would not be heard in its slot any more)
+#define LINK_ADAPTATION             false
+
+// group messages "base_0x01_tx/nodes_0x10": collect group ACKs and repair with unicast messages
+#define GROUP_COLLECT_ACKS          true
+
+// report by exception for uplink messages (see edge.h), "base_0x01_ctl/raw" = on: full rate raw topic
+#define EDGE_FILTER                 true
+#define RAW_TIMEOUT_MS              600000
+
+// offline journal for uplink messages (LittleFS, see journal.h)
+#define JOURNAL_FILE                "/littlefs/journal.bin"
+
+// traffic capture of radio frames and MQTT messages (see capture.h, host replay: tools/replay.c),
+// mode at boot, "base_0x01_ctl/capture" = file / serial / off / dump (file over serial)
+#define CAPTURE_MODE                capture_OFF
+#define CAPTURE_FILE                "/littlefs/capture.bin"
+
+// bulk transfer
+#define BULK_RESUME_INTERVAL_MS     5000
+#define BULK_MAX_RESUMES            10
+
+// static RAM budget per subsystem (bytes), checked at compile time and printed at boot (see main.cpp)
+#define MEM_BUDGET_RADIO            10816   // radio_t + RX / TX buffers + RX frame pool (per radio)
+#define MEM_BUDGET_ROUTE            832     // routing table (see route.h)
+#define MEM_BUDGET_DISP             512
+#define MEM_BUDGET_SCHED            640
+#define MEM_BUDGET_STATS            128
+#define MEM_BUDGET_CACHE            4608
+#define MEM_BUDGET_EDGE             2816
+#define MEM_BUDGET_JOURNAL          640
+#define MEM_BUDGET_HEAP             832     // heap monitor (call site table)
+#define MEM_BUDGET_CAPTURE          640
+#define MEM_BUDGET_BRIDGE           192     // uplink / downlink handling, command status queue (see bridge.h)
+#define MEM_BUDGET_TOTAL            (22080 + (RADIO_COUNT - 1) * 4928)  // a radio_t per radio
 
 
 // MQTT tree example
 /*
-base_0x01_rx
+base_0x01_rx                               (report by exception if EDGE_FILTER, see edge.h)
            ├── nodes_0x10
            │            ├── node_0x11 = {...}
            │            └── node_0x12 = {...}
            └── nodes_0x20
                         ├── node_0x21 = {...}
                         └── node_0x22 = {...}
+base_0x01_raw                              (all messages while "base_0x01_ctl/raw" = on, not retained)
+           └── nodes_0x10
+                        └── node_0x11 = {...}
+base_0x01_agg                              (min / max / avg of the numeric values per EDGE_WINDOW_MS)
+           └── nodes_0x10
+                        └── node_0x11 = {"t":{"min":..,"max":..,"avg":..},"n":..}
 base_0x01_tx
-           ├── node_0x11 = {...}
-           └── node_0x32 = {...}
+           ├── node_0x11  = {...}
+           ├── node_0x32  = {...}
+           └── nodes_0x10 = {...}  (group message to all nodes 0x10..0x1F)
+
+base_0x01_tx_status
+                  └── node_0x11 = {"id":12,"status":"accepted"}  (per command to node_0x11: accepted / held / rejected_full /
+                                                                  rejected_limit / rejected, later delivered / failed / replaced /
+                                                                  merged = packed into the frame of a newer command,
+                                                                  forwarded = relayed node: ACKed by the first repeater)
+
+base_0x01_ctl
+            ├── snapshot = <any>   (publishes the last value of every node again, see cache.h)
+            ├── raw      = on/off  (full rate raw topic, off after RAW_TIMEOUT_MS)
+            └── capture  = file/serial/off/dump  (traffic capture, see capture.h)
+
+base_0x01_bulk
+             └── node_0x11 = <binary blob, up to MQTT_BUFFER_SIZE>
 
 base_0x01_stats
-              ├── uptime = 
-              ├── packets_rx = 
-              └── packets_tx =
+              ├── edge      = {"in":..,"pub":..,"sup":..,"agg":..,"red":..}
+              ├── route     = {"sw":..,"dup":..,"r":[[rx,hw_rx,hw_tx,nodes],..]}  (RADIO_COUNT > 1)
+              ├── heap      = {"free":..,"free_min":..,"largest":..,"frag":..,..,"sites":[[file,line,blocks,bytes,fails],..]}
+              ├── boot      = {"radio":..,"fs":..,"eth":..,"mqtt":..,"rx":..,"pub":..}  (ms since reset, retained)
+              ├── base      = {"up":..,"rx":..,"tx":..,"hw_rx":..,"hw_tx":..,"grp":{..},"sch":{..},"lnk":[..,..],"txs":[..],"err":[..]}
+              ├── node_0x11 = {"rssi":..,"rx":..,"tx":..,"crc":..,"dup":..,"ack":..,"rty":..,"reasm":..,"lat":..,"lat_max":..,"rto":..,"lz":..,"lz_saved":..,"mbox":..,"mbox_rpl":..,"ackd":..,"coal":..,"air_saved":..,"hops":..,"int":..,"link":[..,..]}
+              └── node_0x21 = {...}
 */
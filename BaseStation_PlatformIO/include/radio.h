@@ -1,72 +1,432 @@
-/////////////////////////////////////////////////////
-// FILENAME:    radio.h                            //
-// DESCRIPTION: function handler for RFM69 modules //
-// AUTHOR:      Moritz Kimmig                      //
-// DATE:        30.05.2024                         //
-// VERSION:     0.1                                //
-/////////////////////////////////////////////////////
-
-#include <stdint.h>
-#include <stdbool.h>
-#include "radio_config.h"
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-typedef enum {
-	radio_error_RX_BUFFER_FULL,               // RX buffer full
-	radio_error_TX_BUFFER_FULL,               // TX buffer full
-	radio_error_RAM_FULL,                     // no more memory allocation possible with malloc()
-	radio_error_RX_CRC_WRONG,                 // CRC of received message is wrong
-	radio_error_RFM_ACK_TIMEOUT               // ACK timeout after the configured number of retries
-} radio_error_code_t;
-
-typedef struct {
-	bool valid;
-	uint8_t source;
-	uint8_t destination;
-	uint16_t data_length;
-	uint8_t* data;
-	uint8_t part;
-	uint8_t parts_total;
-	uint8_t retries;
-} radio_message_t;
-
-typedef struct {
-	uint8_t address;
-	uint16_t error_cnt;
-	radio_message_t buffer_rx[RADIO_BUFFER_RX_SIZE];
-	radio_message_t buffer_tx[RADIO_BUFFER_TX_SIZE];
-
-	// rfm functions
-	uint8_t(*rfm_transmit)    (uint8_t dest, uint8_t* data, uint8_t  len);
-	uint8_t(*rfm_receive)     (uint8_t* src, uint8_t* data, uint8_t* len);
-	uint8_t(*rfm_sendACK)     (uint8_t dest);
-	uint8_t(*rfm_ACKReceived) (uint8_t dest);
-	uint8_t(*rfm_ACKRequested)(uint8_t src);
-	uint8_t(*rfm_receiveDone) (void);
-
-	// other external functions
-	// error_handler() and receive() are optional
-	void (*delay)        (uint32_t ms);
-	void (*error_handler)(radio_error_code_t error);
-	void (*receive)      (uint8_t source, uint8_t* data, uint16_t len);
-} radio_t;
-
-
-/* Public function prototypes -------------------------------------------------------------------*/
-
-void radio_init(radio_t* obj, uint8_t address);
-void radio_set_cb_rfm(radio_t* obj, void* transmit, void* receive, void* sendACK, void* ACKReceived, void* ACKRequested, void* receiveDone);
-void radio_set_cb_func(radio_t* obj, void* receive, void* delay, void* error_handler);
-void radio_loop(radio_t* obj);
-
-bool radio_buffer_empty_rx(radio_t* obj);
-bool radio_buffer_empty_tx(radio_t* obj);
-void radio_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len);
-
-
-#ifdef __cplusplus
-}
+/////////////////////////////////////////////////////
+// FILENAME:    radio.h                            //
+// DESCRIPTION: function handler for RFM69 modules //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        30.05.2024                         //
+// VERSION:     0.1                                //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __cplusplus
+#define RADIO_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define RADIO_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+#define RADIO_HEADER_SIZE         6     // see radio_header_t in radio.c
+#define RADIO_FRAME_SIZE_MAX      61    // max frame length (header + data) of the RFM69
+#define RADIO_BROADCAST           0xFF  // destination of group messages (RF69_BROADCAST_ADDR)
+#define RADIO_RX_FRAME_NONE       0xFF  // RX message data is malloc'ed (merged or decompressed), not in the frame pool
+
+typedef enum {
+	radio_error_RX_BUFFER_FULL,               // RX buffer full
+	radio_error_TX_BUFFER_FULL,               // TX buffer full
+	radio_error_RAM_FULL,                     // no more memory allocation possible with malloc()
+	radio_error_RX_CRC_WRONG,                 // CRC of received message is wrong
+	radio_error_RFM_ACK_TIMEOUT,              // ACK timeout after the configured number of retries
+	radio_error_REASSEMBLY_TIMEOUT,           // splitted message was not completed in time
+	radio_error_MSG_TOO_LONG,                 // message needs more than 255 parts, use radio_bulk_send()
+	radio_error_RX_DECOMPRESS,                // compressed message could not be decompressed
+	radio_error_MAILBOX_EXPIRED,              // command for a sleeping node discarded after RADIO_MAILBOX_TIMEOUT
+	radio_error_RELAY_DROPPED,                // relayed frame not forwarded (no repeater, not in the path or TX buffer full)
+	radio_error_RELAY_TIMEOUT,                // relayed message not confirmed by the target in time
+	radio_error_COUNT                         // number of error codes (keep last)
+} radio_error_code_t;
+
+// outcome of a downlink message (see radio_transmit() and radio_set_cb_tx_status())
+typedef enum {
+	radio_tx_ACCEPTED,                        // queued
+	radio_tx_HELD,                            // held for a sleeping node until its next uplink
+	radio_tx_DELIVERED,                       // ACKed by the node
+	radio_tx_FAILED,                          // no ACK after the last retry or held too long
+	radio_tx_REPLACED,                        // command replaced by a newer one before it was sent (latest wins)
+	radio_tx_MERGED,                          // command packed into the frame of a newer one (see its status)
+	radio_tx_REJECTED_FULL,                   // TX buffer above the high watermark
+	radio_tx_REJECTED_LIMIT,                  // too many fragments queued for the node
+	radio_tx_REJECTED,                        // invalid, too long or no memory
+	radio_tx_FORWARDED,                       // relayed message ACKed by the first repeater, DELIVERED / FAILED follows
+	radio_tx_COUNT                            // number of status codes (keep last)
+} radio_tx_status_t;
+
+// members ordered by size (no padding, 28 bytes on the ESP32)
+typedef struct {
+	uint8_t* data;
+	uint32_t time;                  // time the message was added to the buffer (ms)
+	uint32_t time_retry;            // TX: earliest time for the next transmission attempt (ms)
+	uint16_t data_length;
+	uint16_t handle;                // TX: identifies the message in tx_status() (0 = internal message)
+	bool valid;
+	uint8_t source;
+	uint8_t destination;
+	uint8_t part;
+	uint8_t parts_total;
+	uint8_t retries;
+	uint8_t seq;                    // sequence number (0 = none)
+	uint8_t msg_id;                 // message id, identical for all parts of a splitted message
+	uint8_t flags;                  // header flags (radio.c)
+	uint8_t frame;                  // RX: frame pool slot of data (RADIO_RX_FRAME_NONE = malloc'ed)
+	bool in_flight;                 // TX: transmitted, waiting for the ACK (see radio_loop())
+	uint8_t via;                    // TX: next hop, first repeater of a relayed message (otherwise destination)
+} radio_message_t;
+
+typedef struct {
+	int16_t  rssi;                  // RSSI of the last received frame (dBm)
+	uint32_t packets_rx;            // received frames (CRC ok)
+	uint32_t packets_tx;            // transmitted frames (ACK received)
+	uint32_t crc_errors;            // received frames with wrong CRC
+	uint32_t ack_timeouts;          // messages discarded after the last retry
+	uint32_t retries;               // retransmissions
+	uint32_t reassembly_timeouts;   // splitted messages discarded incomplete
+	uint32_t duplicates;            // retransmitted frames ACKed but not delivered again
+	uint32_t lz_messages;           // compressed downlink messages
+	uint32_t lz_fragments_saved;    // downlink fragments saved by compression
+	uint32_t mailbox_held;          // commands held until the next uplink (node sleeping)
+	uint32_t mailbox_replaced;      // held commands replaced by a newer one
+	uint32_t coalesced;             // queued commands replaced or packed by a newer one
+	uint32_t airtime_saved;         // us, estimate of the coalesced frames and ACKs
+	uint32_t ack_data;              // downlink frames sent within an ACK
+	uint16_t latency;               // last downlink latency, queued -> ACK (ms)
+	uint16_t latency_max;           // max downlink latency (ms)
+} radio_node_stats_t;
+
+// members ordered by size (no padding)
+typedef struct {
+	uint32_t time_last_seen;
+	uint32_t listen_until;                      // end of the current listen window
+	uint32_t mailbox_time;
+	uint32_t ack_data_time;
+	uint32_t time_report;                       // start of the report interval measurement
+	uint8_t* mailbox;                           // latest command held for the sleeping node (NULL = empty)
+	uint16_t srtt;                              // smoothed round trip time (ms * 8), 0 = no sample yet
+	uint16_t rttvar;                            // round trip time variance (ms * 4)
+	uint16_t ack_timeout;                       // current ACK timeout (ms)
+	uint16_t mailbox_length;
+	uint16_t mailbox_handle;
+	uint16_t report_interval;                   // smoothed interval of the new uplink messages (100 ms), 0 = unknown
+	int16_t  link_rssi;                         // smoothed RSSI (dBm * 4), 0 = no sample yet
+	bool valid;
+	uint8_t address;
+	uint8_t seq_tx;                             // last sequence number sent to the node
+	uint8_t msg_id_tx;                          // last message id sent to the node
+	uint8_t seq_rx[RADIO_DEDUP_WINDOW];         // last sequence numbers received from the node
+	uint8_t seq_rx_pos;
+	uint8_t seq_rx_last;                        // sequence number of the last received frame
+	bool sleepy;                                // node only listens shortly after its uplinks (RADIO_FLAG_SLEEPY in its uplinks)
+	uint8_t mailbox_flags;
+	bool ack_data;                              // node accepts a downlink frame in the ACK payload
+	bool ack_data_pending;                      // downlink sent in an ACK, confirmed by the node (its sequence number)
+	uint8_t ack_data_seq;                       // sequence number of the downlink frame in the ACK
+	uint8_t ack_data_uplink;                    // sequence number of the uplink that was ACKed with it
+	uint8_t relay_hops;                         // repeaters to the node, 0 = direct
+	uint8_t relay_path[RADIO_RELAY_MAX_HOPS];   // repeaters to the node, first = our neighbour
+	uint8_t report_count;                       // new uplink messages since time_report
+	uint8_t link_rate;                          // link profile to / from the node: bitrate step (beacon slot only)
+	int8_t  link_power;                         // and TX power (dBm)
+	uint8_t link_samples;                       // base: new uplink messages since the last decision
+	uint8_t link_loss;                          // base: ack_timeouts + duplicates + crc_errors at the last decision
+	uint8_t link_failures;                      // failed messages in a row (fallback)
+	bool    link_pending;                       // base: control frame with a new profile queued
+	radio_node_stats_t stats;
+} radio_node_t;
+
+// relayed message ACKed by the first repeater, waiting for the confirmation of the target
+typedef struct {
+	uint32_t time;                  // queued (latency)
+	uint32_t time_forwarded;        // ACKed by the first repeater (timeout)
+	uint32_t bulk_offset;           // bulk frame: offset behind its chunk (0 = other message)
+	uint16_t handle;
+	uint8_t  destination;
+	uint8_t  msg_id;
+	bool     valid;
+} radio_relay_wait_t;
+
+// uplink slot of a node in the beacon mode (3 bytes per entry in the beacon)
+typedef struct {
+	uint8_t address;                // 0 = none
+	uint8_t slot;                   // slot number after the beacon
+	uint8_t period;                 // high nibble: used every 2^n superframes, low nibble: phase (superframe counter)
+} radio_beacon_slot_t;
+
+typedef struct {
+	uint32_t time_start;            // start of the current superframe (beacon sent / received)
+	uint32_t time_base;             // node: time of the base station in the last beacon
+	uint32_t sent;                  // base: beacons sent
+	uint16_t period;                // superframe length (ms)
+	uint16_t pages_seen;            // node: pages of the current slot map version received (bit mask)
+	bool     enabled;               // base: sends beacons
+	bool     synced;                // node: follows the beacons of the base
+	bool     own_current;           // node: own slot found in the current slot map version
+	uint8_t  slot_length;           // ms
+	uint8_t  slots;                 // uplink slots after the beacon, followed by the contention period
+	uint8_t  frame;                 // superframe counter
+	uint8_t  version;               // slot map version
+	uint8_t  page;                  // base: next page of the slot map
+	uint8_t  entries;               // base: entries of the slot map
+	radio_beacon_slot_t own;        // node: own slot (address 0 = contention period), kept until the new one is known
+	radio_beacon_slot_t map[RADIO_NODE_TABLE_SIZE]; // base: slot map
+} radio_beacon_t;
+
+typedef enum {
+	radio_bulk_IDLE,
+	radio_bulk_RUNNING,
+	radio_bulk_PAUSED,              // ACK timeout or read error, continue with radio_bulk_resume()
+	radio_bulk_DONE
+} radio_bulk_status_t;
+
+typedef struct {
+	radio_bulk_status_t state;
+	uint8_t  destination;
+	uint8_t  transfer_id;
+	uint32_t total;                 // length of the transfer (bytes)
+	uint32_t offset_queued;         // next offset to read from the source
+	uint32_t offset_acked;          // everything before was ACKed by the destination
+	uint8_t  rewinds;               // relayed frames not confirmed, in a row without progress
+} radio_bulk_tx_t;
+
+typedef struct {
+	bool     valid;
+	uint8_t  source;
+	uint8_t  transfer_id;
+	uint32_t offset;                // next expected offset
+	uint32_t time_last;
+} radio_bulk_rx_t;
+
+typedef enum {
+	radio_group_IDLE,
+	radio_group_SENDING,            // broadcast queued
+	radio_group_COLLECTING,         // waiting for group ACKs
+	radio_group_REPAIR              // unicast to members without group ACK
+} radio_group_state_t;
+
+// running group message (one at a time), members are known nodes of the class (bit = address & 0x0F)
+typedef struct {
+	radio_group_state_t state;
+	uint8_t  group;                 // node class (address & 0xF0)
+	uint8_t  msg_id;
+	bool     collect_acks;
+	uint8_t* data;                  // copy for the unicast repair
+	uint16_t data_length;
+	uint16_t members;
+	uint16_t confirmed;             // group ACK or unicast ACK received
+	uint16_t failed;                // unicast repair failed
+	uint8_t  repair_msg_id[16];
+	uint32_t time_start;
+	uint32_t time_sent;             // broadcast sent, start of the ACK window
+} radio_group_tx_t;
+
+typedef struct {
+	uint32_t messages;              // group messages sent
+	uint32_t repairs;               // members repaired with a unicast message
+	uint32_t failed;                // members not reached
+	uint8_t  members;               // members of the last group message
+	uint16_t latency;               // last group message: queued -> all members confirmed (ms)
+	uint16_t latency_max;
+} radio_group_stats_t;
+
+// retry / ACK timeout policy of one radio instance (defaults: RADIO_RFM_x, see radio_set_retry_policy())
+typedef struct {
+	uint16_t ack_timeout_init;      // until the first round trip time of a node (ms)
+	uint16_t ack_timeout_min;
+	uint16_t ack_timeout_max;
+	uint16_t time_budget;           // sum of the (doubling) ACK timeouts of all attempts (ms)
+	uint8_t  retries_min;
+	uint8_t  retries_max;
+	uint16_t backoff_time;          // random delay before a retry: 0 .. (backoff_time << retries) ms, 0 = retry at once
+	uint16_t backoff_max;
+} radio_retry_t;
+
+// buffers and frame size of one radio instance, use RADIO_DEFINE_GEOMETRY()
+// RX frames are received directly into the frame pool (one frame per RX buffer slot), the data of a queued
+// frame stays there until it is passed to receive()
+typedef struct {
+	radio_message_t* buffer_rx;
+	radio_message_t* buffer_tx;
+	uint8_t* rx_frames;             // buffer_rx_size * RADIO_FRAME_SIZE_MAX
+	uint32_t* rx_frame_map;         // bit set = frame in use
+	uint8_t buffer_rx_size;
+	uint8_t buffer_tx_size;
+	uint8_t frame_size;             // max frame length (header + data) of the transceiver
+} radio_geometry_t;
+
+// static RAM of the buffers defined by RADIO_DEFINE_GEOMETRY() (memory budget, the TX data is malloc'ed)
+#define RADIO_RX_FRAME_MAP_WORDS(rx_size)     (((rx_size) + 31) / 32)
+#define RADIO_GEOMETRY_BYTES(rx_size, tx_size) \
+	((rx_size) * (sizeof(radio_message_t) + RADIO_FRAME_SIZE_MAX) + RADIO_RX_FRAME_MAP_WORDS(rx_size) * 4 + \
+	 (tx_size) * sizeof(radio_message_t))
+
+// defines the buffers of a radio instance, the geometry is checked at compile time
+// e.g. RADIO_DEFINE_GEOMETRY(radio_geometry, 50, 50, RADIO_FRAME_SIZE_MAX);
+//      radio_init(&radio_drv, NODEID, &radio_geometry);
+#define RADIO_DEFINE_GEOMETRY(name, rx_size, tx_size, frame_size)                                        \
+	RADIO_STATIC_ASSERT((rx_size) > 0 && (rx_size) <= 255, #name ": RX buffer size must be 1..255");      \
+	RADIO_STATIC_ASSERT((tx_size) > 0 && (tx_size) <= 255, #name ": TX buffer size must be 1..255");      \
+	RADIO_STATIC_ASSERT((frame_size) > RADIO_HEADER_SIZE && (frame_size) <= RADIO_FRAME_SIZE_MAX,         \
+		#name ": frame size must be larger than the header and fit into RADIO_FRAME_SIZE_MAX");          \
+	static radio_message_t name##_buffer_rx[rx_size];                                                     \
+	static radio_message_t name##_buffer_tx[tx_size];                                                     \
+	static uint8_t name##_rx_frames[(rx_size) * RADIO_FRAME_SIZE_MAX];                                    \
+	static uint32_t name##_rx_frame_map[RADIO_RX_FRAME_MAP_WORDS(rx_size)];                               \
+	static const radio_geometry_t name = { name##_buffer_rx, name##_buffer_tx, name##_rx_frames, name##_rx_frame_map, \
+		(rx_size), (tx_size), (frame_size) }
+
+typedef struct {
+	uint8_t address;
+	uint16_t error_cnt;
+	uint32_t random;                // state of the backoff random generator
+	radio_message_t* buffer_rx;
+	radio_message_t* buffer_tx;
+	uint8_t* rx_frames;
+	uint32_t* rx_frame_map;
+	uint8_t buffer_rx_size;
+	uint8_t buffer_tx_size;
+	uint8_t frame_size;
+	uint8_t buffer_rx_high_water;   // max number of used RX buffer slots
+	uint8_t buffer_tx_high_water;   // max number of used TX buffer slots
+	radio_node_t nodes[RADIO_NODE_TABLE_SIZE];
+	radio_bulk_tx_t bulk_tx;
+	radio_bulk_rx_t bulk_rx[RADIO_BULK_RX_CONTEXTS];
+	radio_group_tx_t group_tx;
+	radio_group_stats_t group_stats;
+	uint8_t msg_id_broadcast;
+	bool tx_throttled;              // above the high watermark, wait for the low watermark
+	uint16_t tx_handle;             // last handle of radio_transmit()
+	uint32_t tx_status_cnt[radio_tx_COUNT];
+	radio_retry_t retry;
+	uint32_t orphans;               // buffers removed by radio_sweep()
+	uint32_t tx_time;               // transmission time of the frame in flight
+	bool tx_wait;                   // a frame is in flight, its ACK is polled by radio_loop()
+	uint8_t rx_seq;                 // sequence number of the message passed to receive() (0 = none)
+	bool relay;                     // repeater: forward relayed frames of other nodes (see radio_set_relay())
+	radio_relay_wait_t relay_wait[RADIO_RELAY_PENDING];
+	uint32_t relay_forwarded;       // frames forwarded as repeater
+	uint32_t relay_dropped;         // relayed frames not forwarded
+	radio_beacon_t beacon;
+	bool link_adapt;                // base: link adaptation of the nodes (see radio_link_enable())
+	bool link_fallback;             // node: fell back to the default profile, signalled with a control frame
+	bool link_notice;               // node: fallback notice queued
+	uint8_t link_rate;              // profile of the transceiver (last radio_rfm_setLink())
+	int8_t link_power;
+	uint32_t link_changes;          // profiles confirmed (base) / received (node)
+	uint32_t link_fallbacks;        // fallbacks to the default profile (base: signalled by the nodes)
+
+#if !RADIO_RFM_STATIC
+	// rfm functions
+	uint8_t(*rfm_transmit)    (uint8_t dest, uint8_t* data, uint8_t  len);
+	uint8_t(*rfm_receive)     (uint8_t* src, uint8_t* data, uint8_t* len);
+	uint8_t(*rfm_sendACK)     (uint8_t dest, uint8_t* data, uint8_t len);
+	uint8_t(*rfm_ACKReceived) (uint8_t dest);
+	uint8_t(*rfm_ACKRequested)(uint8_t src);
+	uint8_t(*rfm_receiveDone) (void);
+	uint8_t(*rfm_setLink)     (uint8_t rate, int8_t power);   // optional, see radio_set_cb_rfm_link()
+#endif
+
+	// other external functions
+	// error_handler(), receive() and millis() are optional
+	// receive(): data is only valid during the call (frame pool), single frame messages are not copied
+	// without millis() there are no timeouts for splitted messages and no latency values
+	void     (*delay)        (uint32_t ms);
+	void     (*error_handler)(radio_error_code_t error);
+	void     (*receive)      (uint8_t source, uint8_t* data, uint16_t len);
+	uint32_t (*millis)       (void);
+
+	// bulk transfer functions (optional, see radio_set_cb_bulk())
+	uint16_t (*bulk_read)    (uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len);
+	void     (*bulk_receive) (uint8_t source, uint8_t transfer_id, uint32_t offset, uint32_t total, uint8_t* data, uint16_t len);
+	void     (*bulk_done)    (uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset);
+
+	// downlink status (optional, see radio_set_cb_tx_status()), also called from inside radio_transmit() (replaced,
+	// merged or evicted commands): queue the report if the data of radio_transmit() is a buffer tx_status() reuses
+	void     (*tx_status)    (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+} radio_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void radio_init(radio_t* obj, uint8_t address, const radio_geometry_t* geometry);
+#if !RADIO_RFM_STATIC
+void radio_set_cb_rfm(radio_t* obj, void* transmit, void* receive, void* sendACK, void* ACKReceived, void* ACKRequested, void* receiveDone);
+void radio_set_cb_rfm_link(radio_t* obj, void* setLink);
+#endif
+void radio_set_cb_func(radio_t* obj, void* receive, void* delay, void* error_handler, void* millis);
+void radio_set_cb_bulk(radio_t* obj, void* read, void* receive, void* done);
+void radio_set_cb_tx_status(radio_t* obj, void* tx_status);
+// ACK timeouts and retries of this instance (e.g. a slow long range link), false = invalid policy (not changed)
+bool radio_set_retry_policy(radio_t* obj, const radio_retry_t* policy);
+// does not block while waiting for an ACK (needs millis()), several instances can be looped in turn
+void radio_loop(radio_t* obj);
+
+bool radio_buffer_empty_rx(radio_t* obj);
+bool radio_buffer_empty_tx(radio_t* obj);
+// commands to sleeping nodes are held in the node mailbox until the next uplink
+// commands not sent yet are coalesced with newer ones to the same node (see RADIO_COALESCE)
+// returns ACCEPTED, HELD or REJECTED_x, handle (optional) identifies the message in all later tx_status() calls
+radio_tx_status_t radio_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint16_t* handle);
+
+// admission control: fragments radio_transmit() accepts now, fragments needed for len bytes (without compression)
+uint8_t  radio_tx_free     (radio_t* obj);
+uint16_t radio_tx_fragments(radio_t* obj, uint16_t len);
+
+// bulk transfer: data > 255 parts, read from bulk_read() in chunks and streamed into bulk_receive()
+// a paused transfer (bulk_done() with radio_bulk_PAUSED) continues at the last ACKed offset
+// relayed: ACKed up to the last confirmation of the target (RADIO_BULK_CONFIRM), the target only takes frames in order,
+// a missing confirmation sends the frames again from the last confirmed offset (paused after RADIO_BULK_REWINDS)
+bool radio_bulk_send  (radio_t* obj, uint8_t dest, uint8_t transfer_id, uint32_t total, uint32_t offset);
+bool radio_bulk_resume(radio_t* obj);
+
+// remove orphaned buffers (e.g. every second): incomplete splitted messages, TX messages and held commands of
+// nodes that did not come back for RADIO_MAILBOX_TIMEOUT, RX frames without message, returns the number removed
+uint16_t radio_sweep(radio_t* obj);
+
+// group message to all nodes of a class (address & 0xF0): one broadcast frame, optional group ACKs from the
+// members and unicast repair for known members without group ACK, false = not queued (or longer than one frame)
+bool radio_group_transmit(radio_t* obj, uint8_t group, uint8_t* data, uint16_t len, bool collect_acks);
+
+// multi-hop: frames to a node with a path (learned from its relayed uplinks or set by radio_relay_set_path()) carry
+// a relay header and go to the first repeater, every hop is ACKed, the target confirms the complete message
+// (tx_status() FORWARDED, then DELIVERED or FAILED), a repeater forwards frames along their path
+void radio_set_relay(radio_t* obj, bool repeater);
+// static path to dest (e.g. node behind a repeater: path to the base station), hops = 0: direct
+bool radio_relay_set_path(radio_t* obj, uint8_t dest, const uint8_t* path, uint8_t hops);
+
+// beacon mode (base): superframes with a beacon, a slot per node (from the report intervals) and a contention period,
+// nodes that receive the beacons follow them automatically (see RADIO_BEACON_x)
+void radio_beacon_enable(radio_t* obj, bool enable);
+
+// link adaptation (base): bitrate step and TX power per node (see RADIO_LINK_x), nodes follow the control frames of the
+// base automatically, the transceiver is switched by radio_rfm_setLink()
+void radio_link_enable(radio_t* obj, bool enable);
+
+// node table / link statistics
+radio_node_t* radio_node_find(radio_t* obj, uint8_t address);
+void radio_node_set_rssi(radio_t* obj, uint8_t address, int16_t rssi);
+
+// CRC-8 of the frames (poly 0x31, init 0xFF), crc = 0xFF or the CRC of the preceding bytes, also used for the
+// records of the journal and the capture
+uint8_t radio_crc8(uint8_t crc, const uint8_t* data, uint16_t len);
+
+#if RADIO_RFM_STATIC
+// transceiver functions, implemented by the application
+// radio_rfm_receive(): data is a free frame of the RX frame pool (RADIO_FRAME_SIZE_MAX bytes), fill it directly
+uint8_t radio_rfm_transmit    (radio_t* obj, uint8_t dest, uint8_t* data, uint8_t  len);
+uint8_t radio_rfm_receive     (radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len);
+uint8_t radio_rfm_sendACK     (radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len); // len = 0: empty ACK
+uint8_t radio_rfm_ACKReceived (radio_t* obj, uint8_t dest);
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src);
+uint8_t radio_rfm_receiveDone (radio_t* obj);
+// rate = bitrate step (RADIO_LINK_BITRATES), power = TX power (dBm), only called on changes,
+// 0 = not switched now (e.g. frame received but not read yet), called again later
+uint8_t radio_rfm_setLink     (radio_t* obj, uint8_t rate, int8_t power);
+#endif
+
+
+#ifdef __cplusplus
+}
 #endif
\ No newline at end of file
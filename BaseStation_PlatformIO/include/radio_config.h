@@ -1,20 +1,144 @@
-/////////////////////////////////////////////////////
-// FILENAME:    radio_config.h                     //
-// DESCRIPTION: config file for radio.c / .h       //
-// AUTHOR:      Moritz Kimmig                      //
-// DATE:        see header                         //
-// VERSION:     see header                         //
-/////////////////////////////////////////////////////
-
-// internal message buffer size
-#define RADIO_BUFFER_RX_SIZE      50
-#define RADIO_BUFFER_TX_SIZE      50
-
-// time before ACK timeout (milliseconds)
-#define RADIO_RFM_MAX_ACK_TIMEOUT 200
-
-// number of transmission retries before discard sending process
-#define RADIO_RFM_MAX_RETRIES     3
-
-// do a delay before sending ACK
-#define RADIO_RFM_DELAY_BEFORE_ACK true
+/////////////////////////////////////////////////////
+// FILENAME:    radio_config.h                     //
+// DESCRIPTION: config file for radio.c / .h       //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+
+// memory allocation of the radio lib (heap monitor: counters per call site, see heap.h)
+#include "heap.h"
+#define RADIO_MALLOC(size)        HEAP_MALLOC(size)
+#define RADIO_FREE(ptr)           HEAP_FREE(ptr)
+
+// default message buffer size (see RADIO_DEFINE_GEOMETRY)
+#define RADIO_BUFFER_RX_SIZE      50
+#define RADIO_BUFFER_TX_SIZE      50
+
+// call the transceiver directly instead of using the function pointers of radio_set_cb_rfm()
+// the application has to implement radio_rfm_transmit(), ... (see radio.h), inlined with -flto (platformio.ini)
+#define RADIO_RFM_STATIC          true
+
+// number of nodes tracked in the node table (link statistics)
+#define RADIO_NODE_TABLE_SIZE     32
+
+// number of sequence numbers per node remembered for duplicate detection
+#define RADIO_DEDUP_WINDOW        8
+
+// time after which the duplicate detection of a node is reset (milliseconds)
+// (retransmissions arrive within RADIO_RFM_MAX_RETRIES * RADIO_RFM_MAX_ACK_TIMEOUT + backoff)
+#define RADIO_DEDUP_TIMEOUT       10000
+
+// time before incomplete splitted messages are discarded (milliseconds)
+#define RADIO_REASSEMBLY_TIMEOUT  2000
+
+// bulk transfer: max number of queued frames, parallel transfers received and RX timeout (milliseconds)
+// relayed transfer: the target confirms the frames crossing a multiple of RADIO_BULK_CONFIRM bytes and the last one,
+// paused after RADIO_BULK_REWINDS confirmations missing in a row
+#define RADIO_BULK_TX_WINDOW      4
+#define RADIO_BULK_RX_CONTEXTS    2
+#define RADIO_BULK_TIMEOUT        30000
+#define RADIO_BULK_CONFIRM        512
+#define RADIO_BULK_REWINDS        3
+
+// compress splitted downlink messages (radio_lz), only used if it saves at least one fragment
+#define RADIO_COMPRESSION         true
+
+// mailbox for sleeping nodes: the last command is held until the next uplink, then sent within the
+// listen window of the node (milliseconds after its uplink), discarded after the timeout (milliseconds)
+#define RADIO_LISTEN_WINDOW       300
+#define RADIO_MAILBOX_TIMEOUT     3600000
+
+// downlink frame in an ACK: confirmed by the node (sequence number of the frame at the start of its next uplinks), sent
+// as a normal frame if the next new uplink does not confirm it or the node does not come back within
+// RADIO_ACK_DATA_INTERVALS report intervals (RADIO_ACK_DATA_TIMEOUT milliseconds while unknown)
+#define RADIO_ACK_DATA_INTERVALS  3
+#define RADIO_ACK_DATA_TIMEOUT    60000
+
+// coalescing of radio_transmit() commands (flat JSON objects, single frame) with the last queued command
+// to the same node that was not sent yet: same keys are replaced (latest wins), other keys packed into one frame
+// only for nodes whose commands are set-points (state, not events: a replaced {"pulse":1} is lost), otherwise
+// every command is sent, a command held for a sleeping node is replaced by the next one
+#define RADIO_COALESCE            false
+#define RADIO_COALESCE_MAX_KEYS   8
+
+// airtime estimate for the statistics: RFM69 bitrate (bit/s) and bytes per frame besides the payload
+// (preamble, sync word, length, addresses, control byte, CRC)
+#define RADIO_BITRATE             55555
+#define RADIO_AIR_OVERHEAD        11
+
+// admission control of radio_transmit(): new messages are rejected above the high watermark until the
+// TX buffer is below the low watermark again (percent of the TX buffer), max fragments queued per node
+// (a single longer message is admitted when nothing else is queued for the node)
+#define RADIO_TX_HIGH_WATERMARK   80
+#define RADIO_TX_LOW_WATERMARK    50
+#define RADIO_TX_NODE_LIMIT       16
+
+// group messages: members answer in slots of RADIO_GROUP_ACK_SLOT ms (slot = address & 0x0F),
+// members without group ACK after RADIO_GROUP_ACK_WINDOW ms get the message as unicast
+#define RADIO_GROUP_ACK_SLOT      20
+#define RADIO_GROUP_ACK_WINDOW    (16 * RADIO_GROUP_ACK_SLOT + 100)
+
+// multi-hop: nodes out of range are reached over repeater nodes (max RADIO_RELAY_MAX_HOPS per path), the path is
+// learned from their uplinks, the target confirms a relayed message end-to-end within (RADIO_RELAY_MAX_HOPS + 1)
+// retry time budgets, max relayed messages waiting for the confirmation (all / per target, further messages wait in
+// the TX buffer)
+#define RADIO_RELAY_MAX_HOPS      3
+#define RADIO_RELAY_PENDING       8
+#define RADIO_RELAY_WINDOW        2
+
+// beacon mode (optional, see radio_beacon_enable()): the base broadcasts a beacon with its time and the slot map at
+// the start of every superframe, scheduled nodes send their uplinks in their slot only, other nodes and the downlinks
+// of the base use the contention period after the slots (the base also free slots)
+// slot length and guard time around the beacon / at the start of a slot (milliseconds)
+#define RADIO_BEACON_SLOT         30
+#define RADIO_BEACON_GUARD        10
+// superframe = shortest report interval of the nodes, rounded down to the step and limited (milliseconds),
+// contention period at least RADIO_BEACON_CAP_MIN (the slot map is recomputed once all its pages were sent),
+// a node falls back to random access after RADIO_BEACON_SYNC_FRAMES superframes without beacon,
+// report interval of a node = mean over RADIO_BEACON_REPORTS new uplink messages
+#define RADIO_BEACON_PERIOD_MIN   2000
+#define RADIO_BEACON_PERIOD_MAX   60000
+#define RADIO_BEACON_PERIOD_STEP  1000
+#define RADIO_BEACON_CAP_MIN      500
+#define RADIO_BEACON_SYNC_FRAMES  3
+#define RADIO_BEACON_REPORTS      4
+
+// link adaptation (optional, see radio_link_enable()): the base picks a bitrate step and a TX power per node from the
+// smoothed RSSI and the losses of its uplinks, the profile is sent in a control frame and used in both directions,
+// the faster bitrates only in the beacon slot of the node (one receiver: beacon, contention period and downlinks stay at
+// step 0), a node falls back to step 0 / full power after RADIO_LINK_FAILSAFE failed messages or without beacons
+// bitrate (bit/s) and RFM69 sensitivity (dBm) per step, TX power range (dBm)
+#define RADIO_LINK_BITRATES       { RADIO_BITRATE, 100000, 200000 }
+#define RADIO_LINK_SENSITIVITY    { -101, -97, -93 }
+#define RADIO_LINK_STEPS          3
+#define RADIO_LINK_POWER_MIN      -2
+#define RADIO_LINK_POWER_MAX      20
+// RSSI margin above the sensitivity and hysteresis of the steps / power reductions (dB),
+// new uplink messages between two decisions, failed messages before the fallback
+#define RADIO_LINK_MARGIN         12
+#define RADIO_LINK_HYSTERESIS     4
+#define RADIO_LINK_SAMPLES        4
+#define RADIO_LINK_FAILSAFE       2
+
+// time before ACK timeout (milliseconds)
+// estimated per node from the round trip time (srtt + 4 * rttvar), limited to min / max
+// defaults of the retry policy, per instance see radio_set_retry_policy()
+#define RADIO_RFM_INIT_ACK_TIMEOUT 200
+#define RADIO_RFM_MIN_ACK_TIMEOUT  20
+#define RADIO_RFM_MAX_ACK_TIMEOUT  400
+
+// number of transmission retries before discard sending process
+// per node as many retries as their (doubling) ACK timeouts fit into the time budget, limited to min / max
+#define RADIO_RFM_RETRY_TIME_BUDGET 600
+#define RADIO_RFM_MIN_RETRIES     2
+#define RADIO_RFM_MAX_RETRIES     6
+
+// random delay before a retry: 0 .. (RADIO_RFM_BACKOFF_TIME << retries) milliseconds (defaults of the retry policy)
+#define RADIO_RFM_BACKOFF_TIME    8
+#define RADIO_RFM_BACKOFF_MAX     200
+
+// do a delay before sending ACK
+#define RADIO_RFM_DELAY_BEFORE_ACK true
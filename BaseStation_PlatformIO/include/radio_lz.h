@@ -0,0 +1,38 @@
+/////////////////////////////////////////////////////
+// FILENAME:    radio_lz.h                         //
+// DESCRIPTION: LZ compression for radio messages  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Format (small enough to be decompressed on the nodes):
+// [length LSB][length MSB] + tokens
+//   0x00..0x7F: literal run, (token + 1) bytes follow
+//   0x80..0xFF: match, (token & 0x7F) + 3 bytes, next byte = distance - 1 (1..256)
+// A match can reach back into the preset dictionary (RADIO_LZ_DICTIONARY) in front of the data.
+
+#define RADIO_LZ_MAX_INPUT   512    // longer messages are not compressed (compression time)
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+// return the length of the compressed / decompressed data, 0 = does not fit into out_size or error
+uint16_t radio_lz_compress  (const uint8_t* in, uint16_t in_len, uint8_t* out, uint16_t out_size);
+uint16_t radio_lz_decompress(const uint8_t* in, uint16_t in_len, uint8_t* out, uint16_t out_size);
+
+// length of the decompressed data
+uint16_t radio_lz_get_length(const uint8_t* in, uint16_t in_len);
+
+
+#ifdef __cplusplus
+}
+#endif
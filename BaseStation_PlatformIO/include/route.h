@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////
+// FILENAME:    route.h                            //
+// DESCRIPTION: routing between several radios     //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Several transceivers (radio_t instances with their own TX buffer, e.g. a second RFM69 on another CS pin or band):
+// - every node is routed to the radio with the best RSSI of its uplinks (smoothed, with hysteresis), radios that
+//   did not hear the node for ROUTE_RSSI_TIMEOUT are not used, unknown nodes go to the first radio
+// - downlink messages are queued on the radio of the node, radio_loop() does not block while waiting for an ACK,
+//   so the radios transmit in parallel (queued messages stay on their radio if the route changes)
+// - an uplink heard by several radios is ACKed by the radio of the node only and passed on once (same sequence
+//   number, see route_deliver())
+// Radio specific calls are made through the radio_t of the instance, e.g. radio_rfm_transmit(obj, ...).
+
+#define ROUTE_MAX_RADIOS      2
+#define ROUTE_TABLE_SIZE      RADIO_NODE_TABLE_SIZE
+#define ROUTE_HYSTERESIS      4         // dB, another radio has to be better by more than this to take a node over
+#define ROUTE_RSSI_TIMEOUT    600000    // ms, RSSI of a radio that did not hear the node for this time is ignored
+#define ROUTE_DEDUP_TIMEOUT   RADIO_DEDUP_TIMEOUT
+
+// members ordered by size (no padding)
+typedef struct {
+	uint32_t time_rx[ROUTE_MAX_RADIOS];     // last uplink per radio
+	uint32_t time_delivered;                // last uplink passed on (duplicate detection)
+	int16_t  rssi[ROUTE_MAX_RADIOS];        // smoothed RSSI per radio (dBm * 4), 0 = not heard
+	uint16_t switches;                      // route changes
+	bool     valid;
+	uint8_t  address;
+	uint8_t  radio;                         // radio of the node (downlink, ACK)
+	uint8_t  seq_delivered;                 // sequence number of the last uplink passed on
+	uint8_t  radio_delivered;               // radio that passed it on
+} route_node_t;
+
+typedef struct {
+	radio_t* radios;                        // radio_count instances, initialized by radio_init()
+	uint8_t  radio_count;
+	uint8_t  radio_current;                 // instance in radio_loop() (receive() of the radio lib)
+	uint16_t tx_handle;                     // handles of all radios (unique per command)
+	uint8_t  msg_id_broadcast;              // message id of group messages on all radios
+	route_node_t nodes[ROUTE_TABLE_SIZE];
+
+	// statistics
+	uint32_t switches;
+	uint32_t duplicates;                    // uplinks heard by more than one radio, passed on once
+	uint32_t rx[ROUTE_MAX_RADIOS];          // uplink frames per radio
+} route_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void route_init(route_t* obj, radio_t* radios, uint8_t count);
+
+// radio_loop() of all radios
+void route_loop(route_t* obj);
+
+// uplink frame of a node (radio_rfm_receive()): learn the route
+void route_rx(route_t* obj, radio_t* radio, uint8_t address, int16_t rssi, uint32_t time);
+
+// receive() of the radio lib: false = already passed on by another radio
+bool route_deliver(route_t* obj, uint8_t source, uint32_t time);
+
+// radio_rfm_ACKRequested(): false = the node is routed to another radio (no colliding ACKs)
+bool route_ack(route_t* obj, radio_t* radio, uint8_t source);
+
+// radio of a node (relayed node: radio with its path), index of a radio
+radio_t* route_radio(route_t* obj, uint8_t address);
+uint8_t  route_index(route_t* obj, radio_t* radio);
+route_node_t* route_node_find(route_t* obj, uint8_t address);
+
+// radio_transmit() / radio_group_transmit() on the radio of the node / on all radios (members of the group per radio)
+radio_tx_status_t route_transmit(route_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint16_t* handle);
+bool route_group_transmit(route_t* obj, uint8_t group, uint8_t* data, uint16_t len, bool collect_acks);
+
+// all radios
+bool     route_buffer_empty_tx(route_t* obj);
+uint16_t route_sweep(route_t* obj);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////
+// FILENAME:    sched.h                            //
+// DESCRIPTION: cooperative timer wheel scheduler  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Periodic and one-shot jobs on a hashed timer wheel, called from sched_loop() (no preemption).
+// Time base: 64 bit microseconds, extended from a 32 bit micros() function (no overflow, monotonic).
+// sched_sleep() waits for the next job or an event (e.g. RFM interrupt, see sched_event()).
+
+#define SCHED_TICK_MS          10      // wheel resolution
+#define SCHED_WHEEL_SLOTS      32      // one revolution = 320 ms, longer delays wait for more revolutions
+#define SCHED_MAX_JOBS         16
+#define SCHED_IDLE_MAX_MS      10      // max sleep time (Ethernet / MQTT have no interrupt and are polled)
+
+typedef void (*sched_func_t)(void* arg);
+
+typedef struct {
+	bool     valid;
+	bool     active;              // on the wheel
+	sched_func_t func;
+	void*    arg;
+	uint32_t period;              // ms, 0 = one-shot
+	uint64_t due;                 // us
+	uint8_t  pass;                // sched_loop() pass it was scheduled in (not run in the same pass)
+	uint8_t  slot;
+	int8_t   next;                // next job in the same slot (-1 = end)
+} sched_job_t;
+
+typedef struct {
+	uint32_t runs;
+	uint32_t wakeups;             // sched_event() calls
+	uint32_t jitter;              // us, average delay of the jobs against their due time (1/8 filter)
+	uint32_t jitter_max;          // us
+	uint64_t time_idle;           // us spent in sched_sleep()
+} sched_stats_t;
+
+typedef struct {
+	sched_job_t jobs[SCHED_MAX_JOBS];
+	int8_t   wheel[SCHED_WHEEL_SLOTS];  // first job per slot (-1 = empty)
+	uint64_t tick;                // next wheel tick to process
+	uint8_t  pass;
+	volatile bool event;          // set from ISR
+	sched_stats_t stats;
+
+	// 64 bit time base
+	uint32_t time_last;
+	uint32_t time_high;
+
+	// callback functions
+	uint32_t (*micros)(void);
+	void     (*wait)  (uint32_t time_ms);  // block for max time_ms or until woken up (optional, otherwise busy loop)
+} sched_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void sched_init(sched_t* obj, void* micros, void* wait);
+
+// run all due jobs
+void sched_loop(sched_t* obj);
+
+// sleep until the next job, max. max_ms (returns immediately after sched_event())
+void sched_sleep(sched_t* obj, uint32_t max_ms);
+
+// ISR safe: wake up sched_sleep() (the wait callback has to be woken up as well, e.g. task notification)
+void sched_event(sched_t* obj);
+
+// add a job (first run after delay ms, period 0 = one-shot), returns the job id (-1 = no free job)
+int8_t sched_add  (sched_t* obj, sched_func_t func, void* arg, uint32_t delay, uint32_t period);
+
+// (re)start a job in delay ms, e.g. retrigger a one-shot timeout
+void   sched_start(sched_t* obj, int8_t id, uint32_t delay);
+void   sched_stop (sched_t* obj, int8_t id);
+
+// monotonic time since boot
+uint64_t sched_time  (sched_t* obj);   // us
+uint64_t sched_millis(sched_t* obj);   // ms
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////
+// FILENAME:    stats.h                            //
+// DESCRIPTION: base station statistics for MQTT   //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio.h"
+#include "route.h"
+#include "sched.h"
+#include "edge.h"
+#include "heap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_PUBLISH_INTERVAL_MS  60000
+#define STATS_MAX_PAYLOAD_SIZE     512
+
+// boot phases, see stats_boot()
+typedef enum {
+	stats_boot_RADIO,                       // RFM69 initialized, receiving
+	stats_boot_STORAGE,                     // LittleFS mounted, journal ready
+	stats_boot_ETHERNET,                    // W5500 up
+	stats_boot_MQTT,                        // first MQTT connection
+	stats_boot_FIRST_RX,                    // first radio message received
+	stats_boot_FIRST_PUB,                   // first radio message published (live or journal replay)
+	stats_boot_COUNT
+} stats_boot_t;
+
+typedef struct {
+	uint32_t uptime_seconds;
+	uint32_t uptime_ms;                     // remainder < 1000 ms
+	uint32_t time_last;                     // millis() of the last stats_update() call
+	uint32_t packets_rx;                    // messages published to MQTT
+	uint32_t packets_tx;                    // messages received from MQTT
+	uint32_t tx_status_dropped;             // command status reports dropped (bridge queue full)
+	uint32_t error_cnt[radio_error_COUNT];  // filled by the radio error_handler()
+	uint32_t boot_time[stats_boot_COUNT];   // ms since reset (0 = not reached yet)
+} stats_t;
+
+
+/* Public function prototypes -------------------------------------------------------------------*/
+
+void stats_init  (stats_t* obj, uint32_t time);
+void stats_update(stats_t* obj, uint32_t time);
+
+void stats_add_rx   (stats_t* obj);
+void stats_add_tx   (stats_t* obj);
+void stats_add_tx_dropped(stats_t* obj);
+void stats_add_error(stats_t* obj, radio_error_code_t error);
+
+// record the time of a boot phase (only the first call per phase), true = recorded now
+bool stats_boot(stats_t* obj, stats_boot_t phase, uint32_t time);
+
+// compact JSON payloads, return the string length (0 = buffer too small)
+uint16_t stats_format_base(stats_t* obj, route_t* route, sched_t* sched, char* buffer, uint16_t size);
+uint16_t stats_format_node(stats_t* obj, radio_node_t* node, char* buffer, uint16_t size);
+uint16_t stats_format_boot(stats_t* obj, char* buffer, uint16_t size);
+uint16_t stats_format_edge(edge_t* edge, char* buffer, uint16_t size);
+uint16_t stats_format_heap(heap_t* heap, route_t* route, char* buffer, uint16_t size);
+uint16_t stats_format_route(route_t* route, char* buffer, uint16_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,301 @@
+/////////////////////////////////////////////////////
+// FILENAME:    bridge.c                           //
+// DESCRIPTION: radio <-> MQTT message handling    //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "bridge.h"
+#include "heap.h"
+#include "main.h"
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+bool bridge_publish_node     (bridge_t* obj, const char* type, uint8_t node, char* payload, uint16_t len, bool retain);
+void bridge_publish_tx_status(bridge_t* obj);
+void bridge_publish_snapshot (bridge_t* obj, uint32_t time);
+void bridge_bulk_start       (bridge_t* obj, uint8_t dest, uint8_t* payload, uint16_t len);
+void bridge_capture_control  (bridge_t* obj, uint8_t* payload, uint16_t len, uint32_t time);
+bool bridge_online           (bridge_t* obj);
+void bridge_log              (bridge_t* obj, const char* text);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void bridge_init(bridge_t* obj, uint8_t address, route_t* route, stats_t* stats, cache_t* cache, edge_t* edge,
+                 journal_t* journal, capture_t* capture) {
+	obj->route = route;
+	obj->stats = stats;
+	obj->cache = cache;
+	obj->edge = edge;
+	obj->journal = journal;
+	obj->capture = capture;
+	obj->address = address;
+	obj->snapshot_pending = false;
+	obj->raw_enabled = false;
+	obj->raw_time = 0;
+	obj->bulk_blob = NULL;
+	obj->bulk_blob_len = 0;
+	obj->bulk_transfer_id = 0;
+	obj->bulk_resume_cnt = 0;
+	obj->bulk_radio = &route->radios[0];
+	obj->tx_report_head = 0;
+	obj->tx_report_count = 0;
+	obj->publish = NULL;
+	obj->connected = NULL;
+	obj->rx = NULL;
+	obj->tx = NULL;
+	obj->first_publish = NULL;
+	obj->log = NULL;
+}
+
+void bridge_set_cb_mqtt(bridge_t* obj, void* publish, void* connected) {
+	obj->publish = (bridge_publish_t)publish;
+	obj->connected = (bridge_connected_t)connected;
+}
+
+void bridge_set_cb_notify(bridge_t* obj, void* rx, void* tx, void* first_publish, void* log) {
+	obj->rx = (bridge_rx_t)rx;
+	obj->tx = (bridge_tx_t)tx;
+	obj->first_publish = (bridge_event_t)first_publish;
+	obj->log = (bridge_log_t)log;
+}
+
+void bridge_receive(bridge_t* obj, uint8_t source, uint8_t* data, uint16_t len, uint32_t time) {
+
+	// heard by several radios: passed on once
+	if (!route_deliver(obj->route, source, time)) { return; }
+	stats_boot(obj->stats, stats_boot_FIRST_RX, time);
+
+	// last value (for snapshots)
+	cache_put(obj->cache, source, data, len, time);
+
+	// full rate on demand (not journaled)
+	if (obj->raw_enabled && bridge_online(obj)) {
+		bridge_publish_node(obj, "_raw", source, (char*)data, len, false);
+	}
+
+	// publish to MQTT, store in the journal while offline
+	// (also while the journal is replayed, keeps the order), unchanged values are not published
+	if (!EDGE_FILTER || edge_process(obj->edge, source, data, len, time)) {
+		bool journal_pending = (obj->journal != NULL && !journal_empty(obj->journal));
+		if (!bridge_online(obj) || journal_pending || !bridge_publish_rx(obj, source, (char*)data, len, time)) {
+			if (obj->journal != NULL) { journal_add(obj->journal, source, data, len, time); }
+		}
+	}
+	stats_add_rx(obj->stats);
+	if (obj->rx != NULL) { obj->rx(source, data, len); }
+}
+
+bool bridge_mqtt_in(bridge_t* obj, const char* topic, uint8_t* payload, uint16_t len, uint32_t time) {
+	if (obj->capture != NULL) { capture_mqtt_in(obj->capture, topic, payload, len, time); }
+	uint8_t topic_len = strlen(topic);
+
+	// snapshot request "base_0x01_ctl/snapshot" (published from bridge_loop())
+	if (topic_len == 22 && strncmp(topic + 9, "_ctl/snapshot", 13) == 0) {
+		obj->snapshot_pending = true;
+		return true;
+	}
+
+	// raw topic "base_0x01_ctl/raw" = on / off
+	if (topic_len == 17 && strncmp(topic + 9, "_ctl/raw", 8) == 0) {
+		obj->raw_enabled = (len == 2 && strncmp((char*)payload, "on", 2) == 0);
+		obj->raw_time = time;
+		return true;
+	}
+
+	// traffic capture "base_0x01_ctl/capture" = file / serial / off / dump
+	if (topic_len == 21 && strncmp(topic + 9, "_ctl/capture", 12) == 0) {
+		bridge_capture_control(obj, payload, len, time);
+		return true;
+	}
+
+	// group message "base_0x01_tx/nodes_0x10"
+	if (topic_len == 23 && strncmp(topic + 13, "nodes_0x", 8) == 0) {
+		uint8_t group = (uint8_t)strtol((topic + 19), NULL, 0);
+		if (group != 0x00 && route_group_transmit(obj->route, group, payload, len, GROUP_COLLECT_ACKS)) {
+			stats_add_tx(obj->stats);
+			if (obj->tx != NULL) { obj->tx(group, 0, radio_tx_ACCEPTED, payload, len); }
+		}
+		return true;
+	}
+
+	// bulk transfer "base_0x01_bulk/node_0x11"
+	if (topic_len == 24 && strncmp(topic + 9, "_bulk/", 6) == 0) {
+		uint8_t dest = (uint8_t)strtol((topic + 20), NULL, 0);
+		if (dest != 0x00) { bridge_bulk_start(obj, dest, payload, len); }
+		return true;
+	}
+
+	// "base_0x01_tx/node_0x11"
+	uint8_t dest = 0x00;
+	if (topic_len == 22) {
+		dest = (uint8_t)strtol((topic + 18), NULL, 0);
+	}
+	if (dest == 0x00) { return false; }
+
+	// transmit (accepted / rejected is published on "base_0x01_tx_status/node_0x11")
+	uint16_t handle = 0;
+	radio_tx_status_t status = route_transmit(obj->route, dest, payload, len, &handle);
+	stats_add_tx(obj->stats);
+	if (obj->tx != NULL) { obj->tx(dest, handle, status, payload, len); }
+	return true;
+}
+
+void bridge_loop(bridge_t* obj, uint32_t time) {
+	bridge_publish_tx_status(obj);
+
+	// snapshot of all last values (after the journal replay, otherwise older values would follow)
+	if (obj->snapshot_pending && bridge_online(obj) && (obj->journal == NULL || journal_empty(obj->journal))) {
+		bridge_publish_snapshot(obj, time);
+		obj->snapshot_pending = false;
+	}
+
+	if (obj->raw_enabled && time - obj->raw_time > RAW_TIMEOUT_MS) { obj->raw_enabled = false; }
+}
+
+bool bridge_publish_rx(bridge_t* obj, uint8_t node, char* payload, uint16_t len, uint32_t time) {
+	bool published = bridge_publish_node(obj, "_rx", node, payload, len, MQTT_RETAIN);
+	if (published && stats_boot(obj->stats, stats_boot_FIRST_PUB, time) && obj->first_publish != NULL) {
+		obj->first_publish();
+	}
+	return published;
+}
+
+// "base_0x01_agg/nodes_0x10/node_0x11" (dropped while offline)
+void bridge_publish_aggregate(bridge_t* obj, uint8_t node, char* payload, uint16_t len) {
+	if (!bridge_online(obj)) { return; }
+	bridge_publish_node(obj, "_agg", node, payload, len, false);
+}
+
+// queue the status of a command (see bridge_publish_tx_status()), oldest report dropped if full (counted)
+void bridge_tx_status(bridge_t* obj, uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	if (obj->tx_report_count == BRIDGE_TX_STATUS_SIZE) {
+		obj->tx_report_head = (obj->tx_report_head + 1) % BRIDGE_TX_STATUS_SIZE;
+		obj->tx_report_count--;
+		stats_add_tx_dropped(obj->stats);
+	}
+	bridge_tx_report_t* report = &obj->tx_reports[(obj->tx_report_head + obj->tx_report_count) % BRIDGE_TX_STATUS_SIZE];
+	report->dest = dest;
+	report->handle = handle;
+	report->status = (uint8_t)status;
+	obj->tx_report_count++;
+}
+
+uint16_t bridge_bulk_read(bridge_t* obj, uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len) {
+	if (obj->bulk_blob == NULL || transfer_id != obj->bulk_transfer_id || offset + len > obj->bulk_blob_len) { return 0; }
+	memcpy(data, obj->bulk_blob + offset, len);
+	return len;
+}
+
+// paused: kept for bridge_bulk_resume()
+void bridge_bulk_done(bridge_t* obj, uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset) {
+	if (status != radio_bulk_DONE) { return; }
+	HEAP_FREE(obj->bulk_blob);
+	obj->bulk_blob = NULL;
+}
+
+void bridge_bulk_resume(bridge_t* obj) {
+	if (obj->bulk_radio->bulk_tx.state != radio_bulk_PAUSED) { return; }
+	if (obj->bulk_resume_cnt < BULK_MAX_RESUMES) {
+		obj->bulk_resume_cnt++;
+		radio_bulk_resume(obj->bulk_radio);
+	} else {
+		obj->bulk_radio->bulk_tx.state = radio_bulk_IDLE;
+		HEAP_FREE(obj->bulk_blob);
+		obj->bulk_blob = NULL;
+	}
+}
+
+bool bridge_bulk_running(bridge_t* obj) {
+	return obj->bulk_radio->bulk_tx.state == radio_bulk_RUNNING;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// "base_0x01<type>/nodes_0x10/node_0x11"
+bool bridge_publish_node(bridge_t* obj, const char* type, uint8_t node, char* payload, uint16_t len, bool retain) {
+	if (obj->publish == NULL) { return false; }
+	char topic[BRIDGE_TOPIC_SIZE];
+	snprintf(topic, sizeof(topic), "base_0x%02x%s/nodes_0x%02x/node_0x%02x", obj->address, type, node & 0xF0, node);
+	return obj->publish(topic, (const uint8_t*)payload, len, retain);
+}
+
+// publish the queued command status on "base_0x01_tx_status/node_0x11" (dropped while offline)
+void bridge_publish_tx_status(bridge_t* obj) {
+	static const char* status_names[radio_tx_COUNT] = {
+		"accepted", "held", "delivered", "failed", "replaced", "merged", "rejected_full", "rejected_limit", "rejected", "forwarded"
+	};
+	while (obj->tx_report_count) {
+		bridge_tx_report_t* report = &obj->tx_reports[obj->tx_report_head];
+		obj->tx_report_head = (obj->tx_report_head + 1) % BRIDGE_TX_STATUS_SIZE;
+		obj->tx_report_count--;
+		if (!bridge_online(obj) || obj->publish == NULL || report->status >= radio_tx_COUNT) { continue; }
+
+		char topic[40];
+		char payload[48];
+		sprintf(topic, "base_0x%02x_tx_status/node_0x%02x", obj->address, report->dest);
+		uint16_t len = sprintf(payload, "{\"id\":%u,\"status\":\"%s\"}", report->handle, status_names[report->status]);
+		obj->publish(topic, (const uint8_t*)payload, len, false);
+	}
+}
+
+void bridge_publish_snapshot(bridge_t* obj, uint32_t time) {
+	for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+		cache_entry_t* entry = &obj->cache->entries[i];
+		if (!entry->valid) { continue; }
+		bridge_publish_rx(obj, entry->node, (char*)cache_data(obj->cache, entry), entry->length, time);
+	}
+}
+
+void bridge_bulk_start(bridge_t* obj, uint8_t dest, uint8_t* payload, uint16_t len) {
+	if (obj->bulk_blob != NULL || len == 0) {
+		bridge_log(obj, "bulk transfer rejected (busy)");
+		return;
+	}
+
+	// keep a copy, the radio lib reads it in chunks with bridge_bulk_read()
+	obj->bulk_blob = (uint8_t*)HEAP_MALLOC(len);
+	if (obj->bulk_blob == NULL) {
+		stats_add_error(obj->stats, radio_error_RAM_FULL);
+		bridge_log(obj, "bulk transfer rejected (no memory)");
+		return;
+	}
+	memcpy(obj->bulk_blob, payload, len);
+	obj->bulk_blob_len = len;
+	obj->bulk_transfer_id++;
+	obj->bulk_resume_cnt = 0;
+	obj->bulk_radio = route_radio(obj->route, dest);
+	if (!radio_bulk_send(obj->bulk_radio, dest, obj->bulk_transfer_id, obj->bulk_blob_len, 0)) {
+		HEAP_FREE(obj->bulk_blob);
+		obj->bulk_blob = NULL;
+	}
+}
+
+// "base_0x01_ctl/capture": file = new trace, serial = stream, dump = file over serial, off
+void bridge_capture_control(bridge_t* obj, uint8_t* payload, uint16_t len, uint32_t time) {
+	if (obj->capture == NULL) { return; }
+	if (len == 4 && strncmp((char*)payload, "file", 4) == 0) {
+		capture_start(obj->capture, capture_FILE, obj->address, obj->route->radio_count, time);
+	} else if (len == 6 && strncmp((char*)payload, "serial", 6) == 0) {
+		capture_start(obj->capture, capture_SERIAL, obj->address, obj->route->radio_count, time);
+	} else if (len == 4 && strncmp((char*)payload, "dump", 4) == 0) {
+		capture_dump(obj->capture);
+	} else {
+		capture_stop(obj->capture);
+	}
+}
+
+bool bridge_online(bridge_t* obj) {
+	return obj->connected == NULL || obj->connected();
+}
+
+void bridge_log(bridge_t* obj, const char* text) {
+	if (obj->log != NULL) { obj->log(text); }
+}
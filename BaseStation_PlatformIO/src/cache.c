@@ -0,0 +1,119 @@
+/////////////////////////////////////////////////////
+// FILENAME:    cache.c                            //
+// DESCRIPTION: last value cache of the nodes      //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <string.h>
+#include "cache.h"
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void cache_remove (cache_t* obj, cache_entry_t* entry);
+void cache_compact(cache_t* obj);
+void cache_evict_oldest(cache_t* obj);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void cache_init(cache_t* obj) {
+	obj->arena_end = 0;
+	obj->arena_used = 0;
+	obj->evictions = 0;
+	for (int i = 0; i < CACHE_MAX_ENTRIES; i++) { obj->entries[i].valid = false; }
+}
+
+bool cache_put(cache_t* obj, uint8_t node, uint8_t* data, uint16_t len, uint32_t time) {
+	if (data == NULL || len > CACHE_MAX_VALUE_SIZE) { return false; }
+
+	// same length: overwrite in place
+	cache_entry_t* entry = cache_get(obj, node);
+	if (entry != NULL && entry->length == len) {
+		memcpy(obj->arena + entry->offset, data, len);
+		entry->time = time;
+		return true;
+	}
+	if (entry != NULL) { cache_remove(obj, entry); }
+
+	// free table entry
+	entry = NULL;
+	for (int i = 0; i < CACHE_MAX_ENTRIES && entry == NULL; i++) {
+		if (!obj->entries[i].valid) { entry = &obj->entries[i]; }
+	}
+	if (entry == NULL) {
+		cache_evict_oldest(obj);
+		return cache_put(obj, node, data, len, time);
+	}
+
+	// space at the end of the arena
+	if (obj->arena_end + len > CACHE_ARENA_SIZE) { cache_compact(obj); }
+	while (obj->arena_end + len > CACHE_ARENA_SIZE) {
+		cache_evict_oldest(obj);
+		cache_compact(obj);
+	}
+
+	entry->valid = true;
+	entry->node = node;
+	entry->offset = obj->arena_end;
+	entry->length = len;
+	entry->time = time;
+	memcpy(obj->arena + entry->offset, data, len);
+	obj->arena_end = obj->arena_end + len;
+	obj->arena_used = obj->arena_used + len;
+	return true;
+}
+
+cache_entry_t* cache_get(cache_t* obj, uint8_t node) {
+	for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+		if (obj->entries[i].valid && obj->entries[i].node == node) {
+			return &obj->entries[i];
+		}
+	}
+	return NULL;
+}
+
+uint8_t* cache_data(cache_t* obj, cache_entry_t* entry) {
+	return obj->arena + entry->offset;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+void cache_remove(cache_t* obj, cache_entry_t* entry) {
+	entry->valid = false;
+	obj->arena_used = obj->arena_used - entry->length;
+	if (entry->offset + entry->length == obj->arena_end) { obj->arena_end = entry->offset; }
+}
+
+// move all values to the beginning of the arena (in order of their offset)
+void cache_compact(cache_t* obj) {
+	uint16_t end = 0;
+	for (;;) {
+		cache_entry_t* next = NULL;
+		for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+			cache_entry_t* e = &obj->entries[i];
+			if (e->valid && e->offset >= end && (next == NULL || e->offset < next->offset)) { next = e; }
+		}
+		if (next == NULL) { break; }
+		if (next->offset != end) {
+			memmove(obj->arena + end, obj->arena + next->offset, next->length);
+			next->offset = end;
+		}
+		end = end + next->length;
+	}
+	obj->arena_end = end;
+}
+
+void cache_evict_oldest(cache_t* obj) {
+	cache_entry_t* oldest = NULL;
+	for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+		cache_entry_t* e = &obj->entries[i];
+		if (e->valid && (oldest == NULL || (int32_t)(e->time - oldest->time) < 0)) { oldest = e; }
+	}
+	if (oldest == NULL) { return; }
+	cache_remove(obj, oldest);
+	obj->evictions++;
+}
@@ -0,0 +1,396 @@
+/////////////////////////////////////////////////////
+// FILENAME:    capture.c                          //
+// DESCRIPTION: radio / MQTT traffic capture       //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "capture.h"
+#include "heap.h"
+#include "radio.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define CAPTURE_MAGIC         0xA6
+#define CAPTURE_HEADER_SIZE   7     // magic + length + time
+#define CAPTURE_VARINT_MAX    5     // 32 bit time delta
+#define CAPTURE_HEAD_MAX      (4 + 255 + 2)   // fixed fields of a record (MQTT: topic length + topic + length)
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void     capture_add        (capture_t* obj, capture_type_t type, uint32_t time, uint8_t* head, uint16_t head_len, uint8_t* data, uint16_t data_len);
+void     capture_close_block(capture_t* obj, uint8_t* block, uint16_t len, uint32_t time);
+bool     capture_output     (capture_t* obj, uint8_t* data, uint16_t len);
+uint8_t  capture_varint     (uint8_t* buffer, uint32_t value);
+bool     capture_read_block (capture_reader_t* obj);
+bool     capture_parse      (capture_reader_t* obj, capture_record_t* record);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void capture_init(capture_t* obj, const char* path, capture_write_t write) {
+	strncpy(obj->path, path, CAPTURE_PATH_SIZE - 1);
+	obj->path[CAPTURE_PATH_SIZE - 1] = '\0';
+	obj->block_len = 0;
+	obj->block_records = 0;
+	obj->time_block = 0;
+	obj->time_last = 0;
+	obj->size = 0;
+	obj->mode = capture_OFF;
+	obj->write = write;
+	obj->records = 0;
+	obj->records_dropped = 0;
+	obj->bytes = 0;
+}
+
+bool capture_start(capture_t* obj, capture_mode_t mode, uint8_t address, uint8_t radios, uint32_t time) {
+	capture_stop(obj);
+	if (mode == capture_SERIAL && obj->write == NULL) { return false; }
+	if (mode == capture_FILE) {
+		FILE* file = fopen(obj->path, "wb");
+		if (file == NULL) { return false; }
+		fclose(file);
+		obj->size = 0;
+	}
+	obj->mode = mode;
+	uint8_t head[3] = { CAPTURE_VERSION, address, radios };
+	capture_add(obj, capture_START, time, head, sizeof(head), NULL, 0);
+	return (mode != capture_OFF);
+}
+
+void capture_stop(capture_t* obj) {
+	capture_flush(obj);
+	obj->mode = capture_OFF;
+}
+
+void capture_rx(capture_t* obj, uint8_t radio, uint8_t source, int16_t rssi, uint8_t flags, uint8_t* frame, uint8_t len, uint32_t time) {
+	if (rssi < -128) { rssi = -128; }
+	if (rssi > 127) { rssi = 127; }
+	uint8_t head[5] = { radio, source, (uint8_t)(int8_t)rssi, flags, len };
+	capture_add(obj, capture_RX, time, head, sizeof(head), frame, len);
+}
+
+void capture_tx(capture_t* obj, uint8_t radio, uint8_t dest, uint8_t flags, uint8_t* frame, uint8_t len, uint32_t time) {
+	uint8_t head[4] = { radio, dest, flags, len };
+	capture_add(obj, capture_TX, time, head, sizeof(head), frame, len);
+}
+
+void capture_ack(capture_t* obj, uint8_t radio, uint8_t source, uint32_t time) {
+	uint8_t head[2] = { radio, source };
+	capture_add(obj, capture_ACK, time, head, sizeof(head), NULL, 0);
+}
+
+void capture_mqtt_in(capture_t* obj, const char* topic, uint8_t* payload, uint16_t len, uint32_t time) {
+	if (obj->mode == capture_OFF) { return; }
+	uint8_t head[CAPTURE_HEAD_MAX];
+	size_t topic_len = strlen(topic);
+	if (topic_len > 255) { topic_len = 255; }
+	head[0] = (uint8_t)topic_len;
+	memcpy(head + 1, topic, topic_len);
+	head[topic_len + 1] = (uint8_t)(len);
+	head[topic_len + 2] = (uint8_t)(len >> 8);
+	capture_add(obj, capture_MQTT_IN, time, head, (uint16_t)(topic_len + 3), payload, len);
+}
+
+void capture_mqtt_out(capture_t* obj, const char* topic, uint16_t len, uint32_t time) {
+	if (obj->mode == capture_OFF) { return; }
+	uint8_t head[CAPTURE_HEAD_MAX];
+	size_t topic_len = strlen(topic);
+	if (topic_len > 255) { topic_len = 255; }
+	head[0] = (uint8_t)topic_len;
+	memcpy(head + 1, topic, topic_len);
+	head[topic_len + 1] = (uint8_t)(len);
+	head[topic_len + 2] = (uint8_t)(len >> 8);
+	capture_add(obj, capture_MQTT_OUT, time, head, (uint16_t)(topic_len + 3), NULL, 0);
+}
+
+void capture_loop(capture_t* obj, uint32_t time) {
+	if (obj->block_len && (time - obj->time_block) > CAPTURE_FLUSH_INTERVAL_MS) {
+		capture_flush(obj);
+	}
+}
+
+void capture_flush(capture_t* obj) {
+	if (obj->block_len == 0) { return; }
+	capture_close_block(obj, obj->block, obj->block_len, obj->time_block);
+	if (!capture_output(obj, obj->block, (uint16_t)(obj->block_len + 1))) {
+		obj->records_dropped = obj->records_dropped + obj->block_records;
+	}
+	obj->block_len = 0;
+	obj->block_records = 0;
+}
+
+bool capture_dump(capture_t* obj) {
+	if (obj->write == NULL) { return false; }
+	if (obj->mode == capture_FILE) { capture_flush(obj); }
+	FILE* file = fopen(obj->path, "rb");
+	if (file == NULL) { return false; }
+	uint8_t buffer[64];
+	size_t n;
+	bool written = true;
+	while (written && (n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		written = obj->write(buffer, (uint16_t)n);
+	}
+	fclose(file);
+	return written;
+}
+
+bool capture_read_open(capture_reader_t* obj, const char* path) {
+	obj->file = fopen(path, "rb");
+	obj->block = NULL;
+	obj->len = 0;
+	obj->pos = 0;
+	obj->time = 0;
+	obj->blocks = 0;
+	obj->blocks_damaged = 0;
+	obj->bytes_skipped = 0;
+	return (obj->file != NULL);
+}
+
+bool capture_read(capture_reader_t* obj, capture_record_t* record) {
+	while (true) {
+		if (obj->block == NULL || obj->pos >= obj->len) {
+			if (!capture_read_block(obj)) { return false; }
+			continue;
+		}
+		if (capture_parse(obj, record)) { return true; }
+		obj->blocks_damaged++;  // rest of the block is skipped
+		obj->pos = obj->len;
+	}
+}
+
+void capture_read_close(capture_reader_t* obj) {
+	if (obj->block != NULL) { HEAP_FREE(obj->block); }
+	if (obj->file != NULL) { fclose(obj->file); }
+	obj->block = NULL;
+	obj->file = NULL;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// append a record to the block, records larger than the block buffer are written as a block of their own
+void capture_add(capture_t* obj, capture_type_t type, uint32_t time, uint8_t* head, uint16_t head_len, uint8_t* data, uint16_t data_len) {
+	if (obj->mode == capture_OFF) { return; }
+	if (obj->block_len == 0) {
+		obj->block_len = CAPTURE_HEADER_SIZE;
+		obj->time_block = time;
+		obj->time_last = time;
+	}
+	uint8_t varint[CAPTURE_VARINT_MAX];
+	uint8_t varint_len = capture_varint(varint, time - obj->time_last);
+	uint32_t record_size = 1 + varint_len + (uint32_t)head_len + data_len;
+	if (obj->block_len + record_size + 1 > CAPTURE_BLOCK_SIZE && obj->block_len > CAPTURE_HEADER_SIZE) {
+		capture_flush(obj);
+		if (obj->mode == capture_OFF) {
+			obj->records_dropped++; // file full
+			return;
+		}
+		obj->block_len = CAPTURE_HEADER_SIZE;
+		obj->time_block = time;
+		obj->time_last = time;
+		varint_len = capture_varint(varint, 0);
+		record_size = 1 + varint_len + (uint32_t)head_len + data_len;
+	}
+
+	// generate record
+	uint8_t* block = obj->block;
+	uint16_t pos = obj->block_len;
+	bool direct = (CAPTURE_HEADER_SIZE + record_size + 1 > CAPTURE_BLOCK_SIZE);
+	if (direct) {
+		if (CAPTURE_HEADER_SIZE + record_size > 0xFFFF) {
+			obj->records_dropped++;
+			return;
+		}
+		block = HEAP_MALLOC(CAPTURE_HEADER_SIZE + record_size + 1);
+		if (block == NULL) {
+			obj->records_dropped++;
+			return;
+		}
+		pos = CAPTURE_HEADER_SIZE;
+	}
+	block[pos++] = (uint8_t)type;
+	memcpy(block + pos, varint, varint_len);
+	pos = pos + varint_len;
+	memcpy(block + pos, head, head_len);
+	pos = pos + head_len;
+	if (data_len) { memcpy(block + pos, data, data_len); }
+	pos = pos + data_len;
+	obj->time_last = time;
+	obj->records++;
+
+	if (direct) {
+		capture_close_block(obj, block, pos, time);
+		if (!capture_output(obj, block, (uint16_t)(pos + 1))) {
+			obj->records_dropped++;
+		}
+		HEAP_FREE(block);
+		obj->block_len = 0;
+	} else {
+		obj->block_len = pos;
+		obj->block_records++;
+	}
+}
+
+// block header and CRC (block has space for the CRC behind len)
+void capture_close_block(capture_t* obj, uint8_t* block, uint16_t len, uint32_t time) {
+	uint16_t records_len = (uint16_t)(len - CAPTURE_HEADER_SIZE);
+	block[0] = CAPTURE_MAGIC;
+	block[1] = (uint8_t)(records_len);
+	block[2] = (uint8_t)(records_len >> 8);
+	block[3] = (uint8_t)(time);
+	block[4] = (uint8_t)(time >> 8);
+	block[5] = (uint8_t)(time >> 16);
+	block[6] = (uint8_t)(time >> 24);
+	block[len] = radio_crc8(0xFF, block, len);
+}
+
+bool capture_output(capture_t* obj, uint8_t* data, uint16_t len) {
+	if (obj->mode == capture_SERIAL) {
+		if (!obj->write(data, len)) { return false; }
+		obj->bytes = obj->bytes + len;
+		return true;
+	}
+	if (obj->mode != capture_FILE) { return false; }
+
+	// file full: capture stops (the trace stays complete up to here)
+	if (obj->size + len > CAPTURE_MAX_SIZE) {
+		obj->mode = capture_OFF;
+		return false;
+	}
+	FILE* file = fopen(obj->path, "ab");
+	if (file == NULL) { return false; }
+	size_t written = fwrite(data, 1, len, file);
+	fclose(file);
+	obj->size = obj->size + written;
+	obj->bytes = obj->bytes + written;
+	return (written == len);
+}
+
+// LEB128, returns the number of bytes
+uint8_t capture_varint(uint8_t* buffer, uint32_t value) {
+	uint8_t len = 0;
+	do {
+		buffer[len] = (uint8_t)(value & 0x7F);
+		value >>= 7;
+		if (value) { buffer[len] |= 0x80; }
+		len++;
+	} while (value);
+	return len;
+}
+
+// next valid block, bytes in front of it are skipped
+bool capture_read_block(capture_reader_t* obj) {
+	if (obj->block != NULL) {
+		HEAP_FREE(obj->block);
+		obj->block = NULL;
+	}
+	if (obj->file == NULL) { return false; }
+	int c;
+	while ((c = fgetc(obj->file)) != EOF) {
+		if (c != CAPTURE_MAGIC) {
+			obj->bytes_skipped++;
+			continue;
+		}
+		long start = ftell(obj->file);
+		uint8_t header[CAPTURE_HEADER_SIZE];
+		header[0] = CAPTURE_MAGIC;
+		if (fread(header + 1, 1, CAPTURE_HEADER_SIZE - 1, obj->file) != CAPTURE_HEADER_SIZE - 1) { break; }
+		uint16_t len = (uint16_t)(header[1] | (header[2] << 8));
+		uint8_t* block = HEAP_MALLOC((size_t)len + 1);
+		if (block == NULL) { return false; }
+		if (fread(block, 1, (size_t)len + 1, obj->file) == (size_t)len + 1 &&
+		    radio_crc8(radio_crc8(0xFF, header, CAPTURE_HEADER_SIZE), block, len) == block[len]) {
+			obj->block = block;
+			obj->len = len;
+			obj->pos = 0;
+			obj->time = (uint32_t)header[3] | ((uint32_t)header[4] << 8) | ((uint32_t)header[5] << 16) | ((uint32_t)header[6] << 24);
+			obj->blocks++;
+			return true;
+		}
+
+		// no block (e.g. 0xA6 in the debug output): continue behind the magic byte
+		HEAP_FREE(block);
+		obj->blocks_damaged++;
+		obj->bytes_skipped++;
+		fseek(obj->file, start, SEEK_SET);
+	}
+	return false;
+}
+
+// next record of the block, false = malformed
+bool capture_parse(capture_reader_t* obj, capture_record_t* record) {
+	uint8_t* p = obj->block + obj->pos;
+	uint8_t* end = obj->block + obj->len;
+	memset(record, 0, sizeof(*record));
+	record->type = (capture_type_t)*p++;
+
+	// time delta
+	uint32_t delta = 0;
+	for (uint8_t shift = 0; ; shift = shift + 7) {
+		if (p >= end || shift > 28) { return false; }
+		delta |= (uint32_t)(*p & 0x7F) << shift;
+		if (!(*p++ & 0x80)) { break; }
+	}
+	obj->time = obj->time + delta;
+	record->time = obj->time;
+
+	switch (record->type) {
+		case capture_START:
+			if (end - p < 3) { return false; }
+			record->flags = p[0];
+			record->address = p[1];
+			record->radio = p[2];
+			p = p + 3;
+			break;
+		case capture_RX:
+			if (end - p < 5 || end - p - 5 < p[4]) { return false; }
+			record->radio = p[0];
+			record->address = p[1];
+			record->rssi = (int8_t)p[2];
+			record->flags = p[3];
+			record->len = p[4];
+			record->data = p + 5;
+			p = p + 5 + record->len;
+			break;
+		case capture_TX:
+			if (end - p < 4 || end - p - 4 < p[3]) { return false; }
+			record->radio = p[0];
+			record->address = p[1];
+			record->flags = p[2];
+			record->len = p[3];
+			record->data = p + 4;
+			p = p + 4 + record->len;
+			break;
+		case capture_ACK:
+			if (end - p < 2) { return false; }
+			record->radio = p[0];
+			record->address = p[1];
+			p = p + 2;
+			break;
+		case capture_MQTT_IN:
+		case capture_MQTT_OUT:
+			if (end - p < 3 || end - p - 3 < p[0]) { return false; }
+			record->topic_len = p[0];
+			record->topic = (const char*)(p + 1);
+			p = p + 1 + record->topic_len;
+			record->len = (uint16_t)(p[0] | (p[1] << 8));
+			p = p + 2;
+			if (record->type == capture_MQTT_IN) {
+				if (end - p < record->len) { return false; }
+				record->data = p;
+				p = p + record->len;
+			}
+			break;
+		default:
+			return false;
+	}
+	obj->pos = (uint16_t)(p - obj->block);
+	return true;
+}
@@ -12,7 +12,7 @@
 
 /* Private function prototypes ------------------------------------------------------------------*/
 
-uint32_t disp_time_func(uint32_t time_diff);
+uint32_t disp_elapsed(disp_t* obj, uint64_t time);
 void     disp_sort_slave_list(disp_t* obj);
 bool     disp_get_voltage_from_json_string(float *voltage, char *string);
 void 	 disp_print_item(disp_t* obj, uint8_t item_num);
@@ -25,16 +25,17 @@ void disp_write_page_4_to_x(disp_t* obj); // slave list
 
 /* Public functions -----------------------------------------------------------------------------*/
 
-void disp_init(disp_t* obj, Adafruit_SSD1306 *display, const char* ip_base, const char* ip_mqtt) {
+void disp_init(disp_t* obj, Adafruit_SSD1306 *display, sched_t* sched, const char* ip_base, const char* ip_mqtt) {
 	if (obj != NULL) {
+		obj->sched = sched;
 
 		// init variables
 		obj->current_page = 0;
 		obj->last_page = 0;
 		obj->sort_type = disp_sort_type__by_TIME;
 		obj->uptime_hours = 0;
-		obj->uptime_seconds = disp_time_func(0);
-		obj->time_display = disp_time_func(0);
+		obj->uptime_seconds = sched_millis(obj->sched);
+		obj->time_display = sched_millis(obj->sched);
 		for (int i = 0; i < DISP_MAX_IP_SIZE; i++) { obj->addr_ip[i] = 0; }
 		for (int i = 0; i < DISP_MAX_IP_SIZE; i++) { obj->addr_mqtt[i] = 0; }
 		obj->rx_cnt = 0;
@@ -60,25 +61,25 @@ void disp_refresh_display(disp_t* obj) {
 	if (obj != NULL) {
 
 		// check uptime value.
-		if ((disp_time_func(obj->uptime_seconds) / 1000) >= 3600) { // 3600 seconds = 1 hour
+		if ((disp_elapsed(obj, obj->uptime_seconds) / 1000) >= 3600) { // 3600 seconds = 1 hour
 			obj->uptime_hours++;
-			obj->uptime_seconds = disp_time_func(disp_time_func(obj->uptime_seconds) % (3600 * 1000));
+			obj->uptime_seconds = sched_millis(obj->sched) - (disp_elapsed(obj, obj->uptime_seconds) % (3600 * 1000));
 		}
 
 		// check time of every slave in slave_list
 		for (int i=0; i<DISP_SLAVE_LIST_SIZE; i++) {
-			if ((disp_time_func(obj->slave_list[i].time) / 1000) >= 9999) { // 9999 seconds = 2.7 hours
+			if ((disp_elapsed(obj, obj->slave_list[i].time) / 1000) >= 9999) { // 9999 seconds = 2.7 hours
 				obj->slave_list[i].time_valid = false;
 			}
 		}
 
 		// check time of last msg RX + TX
-		if ((disp_time_func(obj->last_msg_rx_time) / 1000) >= 86400) { // 86400 seconds = 24 hours
+		if ((disp_elapsed(obj, obj->last_msg_rx_time) / 1000) >= 86400) { // 86400 seconds = 24 hours
 			obj->last_msg_rx_valid = false;
 		}
 
 		// enable screensaver
-		if (((disp_time_func(obj->time_display) / 1000) >= DISP_SCREENSAVER_TIME) && obj->current_page != DISP_SCREENSAVER) {
+		if (((disp_elapsed(obj, obj->time_display) / 1000) >= DISP_SCREENSAVER_TIME) && obj->current_page != DISP_SCREENSAVER) {
 			obj->last_page = obj->current_page;
 			obj->current_page = DISP_SCREENSAVER;
 		}
@@ -109,7 +110,7 @@ void disp_add_rx(disp_t* obj, uint8_t addr, char* data, uint16_t data_length) {
 		// set last msg rx
 		obj->last_msg_rx_valid = true;
 		obj->last_msg_rx_addr = addr;
-		obj->last_msg_rx_time = disp_time_func(0);
+		obj->last_msg_rx_time = sched_millis(obj->sched);
 		for (int i = 0; i < data_length && i < DISP_MAX_MSG_SIZE - 1; i++) {
 			if (data[i] >= 32 && data[i] <= 126) {
 				obj->last_msg_rx[i] = data[i];
@@ -149,8 +150,10 @@ void disp_add_rx(disp_t* obj, uint8_t addr, char* data, uint16_t data_length) {
 		// 3. write values
 		obj->slave_list[position].valid = true;
 		obj->slave_list[position].addr = addr;
-		obj->slave_list[position].voltage_valid = disp_get_voltage_from_json_string(&obj->slave_list[position].voltage, obj->last_msg_rx);
-		obj->slave_list[position].time = disp_time_func(0);
+		float voltage = 0.0;
+		obj->slave_list[position].voltage_valid = disp_get_voltage_from_json_string(&voltage, obj->last_msg_rx);
+		obj->slave_list[position].voltage_mv = (voltage > 0.0 && voltage < 65.0) ? (uint16_t)(voltage * 1000.0 + 0.5) : 0;
+		obj->slave_list[position].time = (uint32_t)sched_millis(obj->sched);
 		obj->slave_list[position].time_valid = true;
 	}
 }
@@ -164,7 +167,7 @@ void disp_add_tx(disp_t* obj, uint8_t addr, char* data, uint16_t data_length) {
 		// set last msg tx
 		obj->last_msg_tx_valid = true;
 		obj->last_msg_tx_addr = addr;
-		obj->last_msg_tx_time = disp_time_func(0);
+		obj->last_msg_tx_time = sched_millis(obj->sched);
 		for (int i = 0; i < data_length && i < DISP_MAX_MSG_SIZE - 1; i++) {
 			if (data[i] >= 32 && data[i] <= 126) {
 				obj->last_msg_tx[i] = data[i];
@@ -183,7 +186,7 @@ void disp_set_frist_page(disp_t* obj) {
 }
 
 void disp_set_next_page(disp_t* obj) {
-	obj->time_display = disp_time_func(0);
+	obj->time_display = sched_millis(obj->sched);
 	if (obj->current_page == DISP_SCREENSAVER) {
 		obj->current_page = obj->last_page;
 	} else {
@@ -198,13 +201,9 @@ void disp_set_next_page(disp_t* obj) {
 
 /* Private functions ----------------------------------------------------------------------------*/
 
-uint32_t disp_time_func(uint32_t time_diff) {
-	uint32_t time = millis();
-	time = (0x7FFFFFFF & time) - (0x7FFFFFFF & time_diff);
-	if ( time & 0x80000000) {
-		time = time + 0x80000000;
-	}
-	return time;
+// ms since time (sched_millis() time stamp)
+uint32_t disp_elapsed(disp_t* obj, uint64_t time) {
+	return (uint32_t)(sched_millis(obj->sched) - time);
 }
 
 void disp_sort_slave_list(disp_t* obj) {
@@ -246,8 +245,8 @@ void disp_write_page_1(disp_t* obj) {
 	obj->display->println("-- Smart Home Base --");
 	obj->display->print("uptime: ");
 	obj->display->print(obj->uptime_hours); 								obj->display->print("h ");
-	obj->display->print((disp_time_func(obj->uptime_seconds)/ 1000)/ 60); 	obj->display->print("m ");
-	obj->display->print((disp_time_func(obj->uptime_seconds)/ 1000)% 60); 	obj->display->println("s");
+	obj->display->print((disp_elapsed(obj, obj->uptime_seconds)/ 1000)/ 60); 	obj->display->print("m ");
+	obj->display->print((disp_elapsed(obj, obj->uptime_seconds)/ 1000)% 60); 	obj->display->println("s");
 	
 	obj->display->print("ip:   "); obj->display->println(obj->addr_ip);
 	obj->display->print("mqtt: "); obj->display->println(obj->addr_mqtt);
@@ -264,8 +263,8 @@ void disp_write_page_2(disp_t* obj) {
 	char addr_hex[3]; sprintf(addr_hex, "%x", obj->last_msg_rx_addr);
 	obj->display->println(addr_hex);
 	obj->display->print("Time:   ");
-	obj->display->print((disp_time_func(obj->last_msg_rx_time)/ 1000)/ 60); 	obj->display->print("m ");
-	obj->display->print((disp_time_func(obj->last_msg_rx_time)/ 1000)% 60); 	obj->display->println("s");
+	obj->display->print((disp_elapsed(obj, obj->last_msg_rx_time)/ 1000)/ 60); 	obj->display->print("m ");
+	obj->display->print((disp_elapsed(obj, obj->last_msg_rx_time)/ 1000)% 60); 	obj->display->println("s");
 	obj->display->println(" ");
 	obj->display->println(obj->last_msg_rx);
 	return;
@@ -280,8 +279,8 @@ void disp_write_page_3(disp_t* obj) {
 	char addr_hex[3]; sprintf(addr_hex, "%.2x", obj->last_msg_tx_addr);
 	obj->display->println(addr_hex);
 	obj->display->print("Time: ");
-	obj->display->print((disp_time_func(obj->last_msg_tx_time)/ 1000)/ 60); 	obj->display->print("m ");
-	obj->display->print((disp_time_func(obj->last_msg_tx_time)/ 1000)% 60); 	obj->display->println("s");
+	obj->display->print((disp_elapsed(obj, obj->last_msg_tx_time)/ 1000)/ 60); 	obj->display->print("m ");
+	obj->display->print((disp_elapsed(obj, obj->last_msg_tx_time)/ 1000)% 60); 	obj->display->println("s");
 	obj->display->println(" ");
 	obj->display->println(obj->last_msg_tx);
 	return;
@@ -315,7 +314,7 @@ void disp_print_item(disp_t* obj, uint8_t item_num) {
 	// Voltage
 	obj->display->print("  ");
 	if (obj->slave_list[item_num].voltage_valid) {
-		char voltage[10]; sprintf(voltage, "%.2f", obj->slave_list[item_num].voltage);
+		char voltage[10]; sprintf(voltage, "%.2f", obj->slave_list[item_num].voltage_mv / 1000.0);
 		obj->display->print(voltage);
 		obj->display->print(" V");
 	} else {
@@ -325,8 +324,8 @@ void disp_print_item(disp_t* obj, uint8_t item_num) {
 	// Time
 	if (obj->slave_list[item_num].time_valid) {
 		obj->display->print("    ");
-		obj->display->print((disp_time_func(obj->slave_list[item_num].time)/ 1000)); obj->display->println("s");
+		obj->display->print((disp_elapsed(obj, obj->slave_list[item_num].time)/ 1000)); obj->display->println("s");
 	} else {
 		obj->display->println("   >9999s");
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,223 @@
+/////////////////////////////////////////////////////
+// FILENAME:    edge.c                             //
+// DESCRIPTION: uplink report-by-exception         //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "edge.h"
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t       edge_parse      (char* buffer, uint16_t len, char keys[][EDGE_KEY_SIZE], float* values);
+edge_node_t*  edge_node_get   (edge_t* obj, uint8_t address, uint32_t time);
+edge_value_t* edge_value_get  (edge_t* obj, uint8_t node, char* key, bool* created);
+void          edge_node_clear (edge_t* obj, edge_node_t* node);
+void          edge_window_publish(edge_t* obj, edge_node_t* node, uint32_t time);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void edge_init(edge_t* obj, edge_publish_t publish) {
+	for (int i = 0; i < EDGE_MAX_NODES; i++) { obj->nodes[i].valid = false; }
+	for (int i = 0; i < EDGE_MAX_VALUES; i++) { obj->values[i].valid = false; }
+	obj->publish = publish;
+	obj->messages_in = 0;
+	obj->messages_published = 0;
+	obj->messages_suppressed = 0;
+	obj->aggregates = 0;
+}
+
+bool edge_process(edge_t* obj, uint8_t node_address, uint8_t* data, uint16_t len, uint32_t time) {
+	obj->messages_in++;
+
+	// flat JSON object with numeric values, otherwise pass through
+	char buffer[EDGE_MAX_PAYLOAD];
+	char keys[EDGE_MAX_MSG_VALUES][EDGE_KEY_SIZE];
+	float values[EDGE_MAX_MSG_VALUES];
+	uint8_t count = 0;
+	if (len < EDGE_MAX_PAYLOAD) {
+		memcpy(buffer, data, len);
+		buffer[len] = '\0';
+		count = edge_parse(buffer, len, keys, values);
+	}
+	if (count == 0) {
+		obj->messages_published++;
+		return true;
+	}
+
+	// change detection + window
+	edge_node_t* node = edge_node_get(obj, node_address, time);
+	bool changed = (time - node->time_published >= EDGE_HEARTBEAT_MS) || node->time_published == 0;
+	edge_value_t* value[EDGE_MAX_MSG_VALUES];
+	for (int i = 0; i < count; i++) {
+		bool created = false;
+		value[i] = edge_value_get(obj, node_address, keys[i], &created);
+		if (value[i] == NULL) {
+			changed = true; // no free value, no state
+			continue;
+		}
+		if (created) {
+			changed = true;
+		} else {
+			float diff = fabsf(values[i] - value[i]->published);
+			if (diff > EDGE_DEADBAND_ABS && diff > fabsf(value[i]->published) * EDGE_DEADBAND_PCT / 100.0f) { changed = true; }
+		}
+		if (value[i]->count == 0 || values[i] < value[i]->min) { value[i]->min = values[i]; }
+		if (value[i]->count == 0 || values[i] > value[i]->max) { value[i]->max = values[i]; }
+		value[i]->sum += values[i];
+		value[i]->count++;
+	}
+	node->window_messages++;
+
+	if (!changed) {
+		obj->messages_suppressed++;
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		if (value[i] != NULL) { value[i]->published = values[i]; }
+	}
+	node->time_published = (time == 0) ? 1 : time;
+	obj->messages_published++;
+	return true;
+}
+
+void edge_loop(edge_t* obj, uint32_t time) {
+	for (int i = 0; i < EDGE_MAX_NODES; i++) {
+		edge_node_t* node = &obj->nodes[i];
+		if (node->valid && node->window_messages && time - node->time_window >= EDGE_WINDOW_MS) {
+			edge_window_publish(obj, node, time);
+		}
+	}
+}
+
+uint8_t edge_reduction(edge_t* obj) {
+	if (obj->messages_in == 0) { return 0; }
+	uint32_t out = obj->messages_published + obj->aggregates;
+	if (out >= obj->messages_in) { return 0; }
+	return (uint8_t)((uint64_t)(obj->messages_in - out) * 100 / obj->messages_in);
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// {"t":21.5,"h":48} -> keys + values, returns the number of values (0 = not a flat numeric object)
+uint8_t edge_parse(char* buffer, uint16_t len, char keys[][EDGE_KEY_SIZE], float* values) {
+	if (len < 2 || buffer[0] != '{' || buffer[len - 1] != '}') { return 0; }
+	uint8_t count = 0;
+	char* pnt = buffer + 1;
+	char* end = buffer + len - 1;
+	while (pnt < end) {
+
+		// key
+		while (pnt < end && *pnt == ' ') { pnt++; }
+		if (pnt >= end || *pnt != '"' || count == EDGE_MAX_MSG_VALUES) { return 0; }
+		char* key = ++pnt;
+		while (pnt < end && *pnt != '"') { pnt++; }
+		if (pnt >= end || pnt - key >= EDGE_KEY_SIZE || pnt == key) { return 0; }
+		memcpy(keys[count], key, pnt - key);
+		keys[count][pnt - key] = '\0';
+		pnt++;
+		while (pnt < end && *pnt == ' ') { pnt++; }
+		if (pnt >= end || *pnt != ':') { return 0; }
+		pnt++;
+
+		// numeric value
+		char* value_end = NULL;
+		values[count] = strtof(pnt, &value_end);
+		if (value_end == pnt || value_end > end || !isfinite(values[count])) { return 0; }
+		pnt = value_end;
+		while (pnt < end && *pnt == ' ') { pnt++; }
+		if (pnt < end && *pnt != ',') { return 0; }
+		pnt++;
+		count++;
+	}
+	return count;
+}
+
+edge_node_t* edge_node_get(edge_t* obj, uint8_t address, uint32_t time) {
+	edge_node_t* node = NULL;
+	for (int i = 0; i < EDGE_MAX_NODES; i++) {
+		if (obj->nodes[i].valid && obj->nodes[i].address == address) {
+			node = &obj->nodes[i];
+			break;
+		}
+	}
+
+	// new node: free entry or least recently heard one
+	if (node == NULL) {
+		node = &obj->nodes[0];
+		for (int i = 0; i < EDGE_MAX_NODES; i++) {
+			if (!obj->nodes[i].valid) {
+				node = &obj->nodes[i];
+				break;
+			}
+			if (time - obj->nodes[i].time_last > time - node->time_last) { node = &obj->nodes[i]; }
+		}
+		if (node->valid) { edge_node_clear(obj, node); }
+		node->valid = true;
+		node->address = address;
+		node->time_published = 0;
+		node->time_window = time;
+		node->window_messages = 0;
+	}
+	node->time_last = time;
+	return node;
+}
+
+edge_value_t* edge_value_get(edge_t* obj, uint8_t node, char* key, bool* created) {
+	edge_value_t* free_value = NULL;
+	for (int i = 0; i < EDGE_MAX_VALUES; i++) {
+		edge_value_t* value = &obj->values[i];
+		if (value->valid && value->node == node && strcmp(value->key, key) == 0) { return value; }
+		if (!value->valid && free_value == NULL) { free_value = value; }
+	}
+	if (free_value != NULL) {
+		free_value->valid = true;
+		free_value->node = node;
+		strcpy(free_value->key, key);
+		free_value->published = 0.0f;
+		free_value->sum = 0.0f;
+		free_value->count = 0;
+		*created = true;
+	}
+	return free_value;
+}
+
+void edge_node_clear(edge_t* obj, edge_node_t* node) {
+	for (int i = 0; i < EDGE_MAX_VALUES; i++) {
+		if (obj->values[i].valid && obj->values[i].node == node->address) { obj->values[i].valid = false; }
+	}
+	node->valid = false;
+}
+
+// {"t":{"min":21.1,"max":21.6,"avg":21.3},"h":{...},"n":12}
+void edge_window_publish(edge_t* obj, edge_node_t* node, uint32_t time) {
+	char buffer[EDGE_AGG_MAX_PAYLOAD];
+	int len = snprintf(buffer, sizeof(buffer), "{");
+	for (int i = 0; i < EDGE_MAX_VALUES; i++) {
+		edge_value_t* value = &obj->values[i];
+		if (!value->valid || value->node != node->address || value->count == 0) { continue; }
+		if (len > 0 && len < (int)sizeof(buffer)) {
+			len += snprintf(buffer + len, sizeof(buffer) - len, "\"%s\":{\"min\":%g,\"max\":%g,\"avg\":%g},",
+				value->key, value->min, value->max, value->sum / value->count);
+		}
+		value->sum = 0.0f;
+		value->count = 0;
+	}
+	if (len > 0 && len < (int)sizeof(buffer)) {
+		len += snprintf(buffer + len, sizeof(buffer) - len, "\"n\":%u}", node->window_messages);
+	}
+	node->window_messages = 0;
+	node->time_window = time;
+	if (len > 0 && len < (int)sizeof(buffer) && obj->publish != NULL) {
+		obj->publish(node->address, buffer, (uint16_t)len);
+		obj->aggregates++;
+	}
+}
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////
+// FILENAME:    heap.c                             //
+// DESCRIPTION: heap allocation monitor            //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <string.h>
+#include "heap.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define HEAP_MAGIC 0xA5
+
+typedef struct {
+	uint32_t size;
+	uint8_t  site;
+	uint8_t  magic;
+	uint16_t reserved;
+} heap_header_t;
+
+_Static_assert(sizeof(heap_header_t) == HEAP_HEADER_SIZE, "heap: header size");
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+// one heap per system: module instance instead of an obj pointer (used by the HEAP_MALLOC() macro)
+static heap_t heap;
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t heap_site_get(const char* file, uint16_t line);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void heap_init(void* get_free, void* get_largest) {
+	heap.get_free = get_free;
+	heap.get_largest = get_largest;
+	heap.free_min = UINT32_MAX;
+	heap_sample();
+}
+
+void* heap_malloc(size_t size, const char* file, uint16_t line) {
+	uint8_t site = heap_site_get(file, line);
+	heap_site_t* s = &heap.sites[site];
+	heap_header_t* header = malloc(HEAP_HEADER_SIZE + size);
+	if (header == NULL) {
+		s->fails++;
+		heap.fails++;
+		return NULL;
+	}
+	header->size = (uint32_t)size;
+	header->site = site;
+	header->magic = HEAP_MAGIC;
+
+	s->allocs++;
+	s->blocks++;
+	s->bytes += (uint32_t)size;
+	if (s->bytes > s->bytes_max) { s->bytes_max = s->bytes; }
+	heap.allocs++;
+	heap.blocks++;
+	heap.bytes += (uint32_t)size;
+	if (heap.bytes > heap.bytes_max) { heap.bytes_max = heap.bytes; }
+	return (uint8_t*)header + HEAP_HEADER_SIZE;
+}
+
+void heap_free(void* ptr) {
+	if (ptr == NULL) { return; }
+	heap_header_t* header = (heap_header_t*)((uint8_t*)ptr - HEAP_HEADER_SIZE);
+	if (header->magic != HEAP_MAGIC || header->site > HEAP_MAX_SITES) {
+		heap.invalid_frees++;
+		return; // not ours, leaking is safer than corrupting the heap
+	}
+	header->magic = 0;
+
+	heap_site_t* s = &heap.sites[header->site];
+	s->blocks--;
+	s->bytes -= header->size;
+	heap.frees++;
+	heap.blocks--;
+	heap.bytes -= header->size;
+	free(header);
+}
+
+void heap_sample(void) {
+	if (heap.get_free == NULL) { return; }
+	heap.free_size = heap.get_free();
+	if (heap.free_size < heap.free_min) { heap.free_min = heap.free_size; }
+	if (heap.get_largest == NULL || heap.free_size == 0) { return; }
+	heap.largest_block = heap.get_largest();
+	heap.fragmentation = (heap.largest_block >= heap.free_size) ? 0 : (uint8_t)(100 - (uint64_t)heap.largest_block * 100 / heap.free_size);
+	if (heap.fragmentation > heap.fragmentation_max) { heap.fragmentation_max = heap.fragmentation; }
+}
+
+heap_t* heap_get(void) {
+	return &heap;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// index of the call site, HEAP_MAX_SITES = other sites (table full)
+uint8_t heap_site_get(const char* file, uint16_t line) {
+	for (uint8_t i = 0; i < heap.site_count; i++) {
+		if (heap.sites[i].line == line && (heap.sites[i].file == file || strcmp(heap.sites[i].file, file) == 0)) { return i; }
+	}
+	if (heap.site_count == HEAP_MAX_SITES) { return HEAP_MAX_SITES; }
+	heap.sites[heap.site_count].file = file;
+	heap.sites[heap.site_count].line = line;
+	return heap.site_count++;
+}
@@ -0,0 +1,259 @@
+/////////////////////////////////////////////////////
+// FILENAME:    journal.c                          //
+// DESCRIPTION: offline uplink journal (flash)     //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "journal.h"
+#include "heap.h"
+#include "radio.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define JOURNAL_MAGIC         0xA5
+#define JOURNAL_HEADER_SIZE   8     // magic + node + length + time
+#define JOURNAL_RECORD_SIZE(len) (JOURNAL_HEADER_SIZE + (uint32_t)(len) + 1)
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+bool     journal_write       (journal_t* obj, uint8_t* data, uint16_t len);
+uint32_t journal_read_record (journal_t* obj, FILE* file, uint32_t offset, uint8_t* header, uint8_t** payload);
+void     journal_recover     (journal_t* obj);
+bool     journal_repair      (journal_t* obj);
+void     journal_clear       (journal_t* obj);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void journal_init(journal_t* obj, const char* path, journal_publish_t publish) {
+	strncpy(obj->path, path, JOURNAL_PATH_SIZE - 1);
+	obj->path[JOURNAL_PATH_SIZE - 1] = '\0';
+	obj->batch_len = 0;
+	obj->time_batch = 0;
+	obj->time_replay = 0;
+	obj->size = 0;
+	obj->replay_offset = 0;
+	obj->damaged = false;
+	obj->publish = publish;
+	obj->records_stored = 0;
+	obj->records_replayed = 0;
+	obj->records_dropped = 0;
+	obj->bytes_recovered = 0;
+	journal_recover(obj);
+}
+
+bool journal_add(journal_t* obj, uint8_t node, uint8_t* data, uint16_t len, uint32_t time) {
+	uint32_t record_size = JOURNAL_RECORD_SIZE(len);
+	if (obj->size + obj->batch_len + record_size > JOURNAL_MAX_SIZE) {
+		obj->records_dropped++;
+		return false;
+	}
+
+	// generate record
+	uint8_t* record = obj->batch + obj->batch_len;
+	bool direct = (record_size > JOURNAL_BATCH_SIZE);
+	if (!direct && obj->batch_len + record_size > JOURNAL_BATCH_SIZE) {
+		journal_flush(obj);
+		record = obj->batch + obj->batch_len;
+	}
+	if (direct) {
+		record = HEAP_MALLOC(record_size);
+		if (record == NULL) {
+			obj->records_dropped++;
+			return false;
+		}
+	}
+	record[0] = JOURNAL_MAGIC;
+	record[1] = node;
+	record[2] = (uint8_t)(len);
+	record[3] = (uint8_t)(len >> 8);
+	record[4] = (uint8_t)(time);
+	record[5] = (uint8_t)(time >> 8);
+	record[6] = (uint8_t)(time >> 16);
+	record[7] = (uint8_t)(time >> 24);
+	memcpy(record + JOURNAL_HEADER_SIZE, data, len);
+	record[record_size - 1] = radio_crc8(0xFF, record, (uint16_t)(record_size - 1));
+
+	// records larger than the batch buffer are written directly
+	if (direct) {
+		journal_flush(obj);
+		bool written = journal_write(obj, record, (uint16_t)record_size);
+		HEAP_FREE(record);
+		if (!written) {
+			obj->records_dropped++;
+			return false;
+		}
+	} else {
+		if (obj->batch_len == 0) { obj->time_batch = time; }
+		obj->batch_len = obj->batch_len + record_size;
+	}
+	obj->records_stored++;
+	return true;
+}
+
+void journal_loop(journal_t* obj, uint32_t time, bool online) {
+
+	// flush batch
+	if (obj->batch_len && (time - obj->time_batch) > JOURNAL_FLUSH_INTERVAL_MS) {
+		journal_flush(obj);
+	}
+	if (!online || obj->publish == NULL || (time - obj->time_replay) < JOURNAL_REPLAY_INTERVAL_MS) { return; }
+
+	// replay: records still in RAM are written first, so the file contains everything in order
+	if (obj->replay_offset >= obj->size) {
+		if (obj->batch_len == 0) { return; }
+		journal_flush(obj);
+	}
+	obj->time_replay = time;
+
+	FILE* file = fopen(obj->path, "rb");
+	if (file == NULL) {
+		journal_clear(obj);
+		return;
+	}
+	uint8_t header[JOURNAL_HEADER_SIZE];
+	uint8_t* payload = NULL;
+	uint32_t record_size = journal_read_record(obj, file, obj->replay_offset, header, &payload);
+	fclose(file);
+	if (record_size == 0) {
+		journal_clear(obj); // damaged after the recovery, nothing left to replay
+		return;
+	}
+	uint16_t len = (uint16_t)(header[2] | (header[3] << 8));
+	uint32_t record_time = (uint32_t)header[4] | ((uint32_t)header[5] << 8) | ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 24);
+	bool published = obj->publish(header[1], payload, len, record_time);
+	HEAP_FREE(payload);
+	if (!published) { return; }
+	obj->records_replayed++;
+	obj->replay_offset = obj->replay_offset + record_size;
+
+	// everything replayed
+	if (obj->replay_offset >= obj->size && obj->batch_len == 0) {
+		journal_clear(obj);
+	}
+}
+
+void journal_flush(journal_t* obj) {
+	if (obj->batch_len == 0) { return; }
+	if (!journal_write(obj, obj->batch, obj->batch_len)) {
+		obj->records_dropped++;
+	}
+	obj->batch_len = 0;
+}
+
+bool journal_empty(journal_t* obj) {
+	return (obj->batch_len == 0 && obj->replay_offset >= obj->size);
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+bool journal_write(journal_t* obj, uint8_t* data, uint16_t len) {
+
+	// damaged tail still in the file: appended records would follow it and never be replayed
+	if (obj->damaged && !journal_repair(obj)) { return false; }
+
+	FILE* file = fopen(obj->path, "ab");
+	if (file == NULL) { return false; }
+	size_t written = fwrite(data, 1, len, file);
+	fclose(file);
+	obj->size = obj->size + written;
+	if (written != len) {
+		journal_repair(obj); // cut off the incomplete record
+		return false;
+	}
+	return true;
+}
+
+// journal_recover() without losing the replay position, false = damaged tail still in the file
+bool journal_repair(journal_t* obj) {
+	uint32_t replay_offset = obj->replay_offset;
+	journal_recover(obj);
+	obj->replay_offset = (replay_offset < obj->size) ? replay_offset : obj->size;
+	return !obj->damaged;
+}
+
+// return the record size (0 = invalid or incomplete record), payload is allocated with HEAP_MALLOC()
+uint32_t journal_read_record(journal_t* obj, FILE* file, uint32_t offset, uint8_t* header, uint8_t** payload) {
+	if (fseek(file, (long)offset, SEEK_SET) != 0) { return 0; }
+	if (fread(header, 1, JOURNAL_HEADER_SIZE, file) != JOURNAL_HEADER_SIZE || header[0] != JOURNAL_MAGIC) { return 0; }
+	uint16_t len = (uint16_t)(header[2] | (header[3] << 8));
+	uint8_t* data = HEAP_MALLOC(len + 1);
+	if (data == NULL) { return 0; }
+	if (fread(data, 1, len + 1, file) != (size_t)(len + 1) ||
+	    radio_crc8(radio_crc8(0xFF, header, JOURNAL_HEADER_SIZE), data, len) != data[len]) {
+		HEAP_FREE(data);
+		return 0;
+	}
+	if (payload != NULL) {
+		*payload = data;
+	} else {
+		HEAP_FREE(data);
+	}
+	return JOURNAL_RECORD_SIZE(len);
+}
+
+// find the end of the last complete record, copy the valid part if something is behind it
+// (copy failed, e.g. flash full: the original is kept, replay stops at the last valid record, no appends)
+void journal_recover(journal_t* obj) {
+	FILE* file = fopen(obj->path, "rb");
+	obj->size = 0;
+	obj->replay_offset = 0;
+	obj->damaged = false;
+	if (file == NULL) { return; }
+
+	uint8_t header[JOURNAL_HEADER_SIZE];
+	uint32_t valid = 0;
+	uint32_t record_size;
+	while ((record_size = journal_read_record(obj, file, valid, header, NULL)) != 0) {
+		valid = valid + record_size;
+	}
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	if (file_size < 0 || (uint32_t)file_size == valid) {
+		fclose(file);
+		obj->size = valid;
+		return;
+	}
+
+	// no truncate() on all file systems: copy the valid records to a new file
+	char path_tmp[JOURNAL_PATH_SIZE + 4];
+	snprintf(path_tmp, sizeof(path_tmp), "%s.tmp", obj->path);
+	FILE* file_tmp = fopen(path_tmp, "wb");
+	bool copied = (file_tmp != NULL);
+	uint8_t buffer[64];
+	fseek(file, 0, SEEK_SET);
+	for (uint32_t pos = 0; copied && pos < valid; ) {
+		size_t n = (valid - pos > sizeof(buffer)) ? sizeof(buffer) : (size_t)(valid - pos);
+		copied = (fread(buffer, 1, n, file) == n && fwrite(buffer, 1, n, file_tmp) == n);
+		pos = pos + n;
+	}
+	fclose(file);
+	if (file_tmp != NULL && fclose(file_tmp) != 0) { copied = false; }
+	obj->size = valid;
+	if (!copied) {
+		remove(path_tmp);
+		obj->damaged = true;
+		return;
+	}
+	obj->bytes_recovered = obj->bytes_recovered + ((uint32_t)file_size - valid);
+	remove(obj->path);
+	if (valid == 0 || rename(path_tmp, obj->path) != 0) {
+		remove(path_tmp);
+		obj->size = 0;
+	}
+}
+
+void journal_clear(journal_t* obj) {
+	remove(obj->path);
+	obj->size = 0;
+	obj->replay_offset = 0;
+	obj->damaged = false;
+}
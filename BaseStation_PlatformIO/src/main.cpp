@@ -4,19 +4,47 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <RFM69.h>
+#include <RFM69registers.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <PubSubClient.h>
+#include <LittleFS.h>
 #include "disp.h"
 #include "main.h"
 #include "radio.h"
+#include "route.h"
+#include "stats.h"
+#include "journal.h"
+#include "cache.h"
+#include "sched.h"
+#include "edge.h"
+#include "heap.h"
+#include "capture.h"
+#include "bridge.h"
 
 // Debug Konsole:
 // sudo minicom -D /dev/ttyUSB0 -b 115200
 // (to exit: Strg+A -> Q -> Enter)
 
 
-radio_t radio_drv;
+// radio lib instance per RFM69, nodes are routed to one of them (route.h)
+#define RADIO_RX_SLOTS  (RADIO_BUFFER_RX_SIZE / RADIO_COUNT)
+#define RADIO_TX_SLOTS  (RADIO_BUFFER_TX_SIZE / RADIO_COUNT)
+static_assert(RADIO_COUNT >= 1 && RADIO_COUNT <= 2 && RADIO_COUNT <= ROUTE_MAX_RADIOS, "RADIO_COUNT: 1 or 2 RFM69");
+radio_t radio_drv[RADIO_COUNT];
+route_t route;
+RADIO_DEFINE_GEOMETRY(radio_geometry, RADIO_RX_SLOTS, RADIO_TX_SLOTS, RF69_MAX_DATA_LEN);
+#if RADIO_COUNT > 1
+RADIO_DEFINE_GEOMETRY(radio_geometry_2, RADIO_RX_SLOTS, RADIO_TX_SLOTS, RF69_MAX_DATA_LEN);
+#endif
+stats_t stats;
+journal_t journal;
+capture_t capture;
+cache_t cache;
+sched_t sched;
+edge_t edge;
+bridge_t bridge;
+TaskHandle_t loop_task = NULL;
 IPAddress ipAddress;
 PubSubClient mqttClient;
 EthernetClient ethClient;
@@ -32,37 +60,163 @@ PCF8574 LEDs_PCF8574(0x39);
 Adafruit_SSD1306 display(OLED_WIDTH, OLED_HEIGHT);
 disp_t disp;
 
+// static RAM per subsystem, the budget (main.h) is checked for the target only (other pointer sizes on a host)
+#define MEM_USED_RADIO  (sizeof(radio_t) + RADIO_GEOMETRY_BYTES(RADIO_RX_SLOTS, RADIO_TX_SLOTS))
+#define MEM_USED_TOTAL  (RADIO_COUNT * MEM_USED_RADIO + sizeof(route_t) + sizeof(disp_t) + sizeof(sched_t) + sizeof(stats_t) + sizeof(cache_t) + \
+                         sizeof(edge_t) + sizeof(journal_t) + sizeof(heap_t) + sizeof(capture_t) + sizeof(bridge_t))
+#if defined(ESP32)
+static_assert(MEM_USED_RADIO     <= MEM_BUDGET_RADIO,   "RAM budget: radio");
+static_assert(sizeof(route_t)    <= MEM_BUDGET_ROUTE,   "RAM budget: route");
+static_assert(sizeof(disp_t)     <= MEM_BUDGET_DISP,    "RAM budget: disp");
+static_assert(sizeof(sched_t)    <= MEM_BUDGET_SCHED,   "RAM budget: sched");
+static_assert(sizeof(stats_t)    <= MEM_BUDGET_STATS,   "RAM budget: stats");
+static_assert(sizeof(cache_t)    <= MEM_BUDGET_CACHE,   "RAM budget: cache");
+static_assert(sizeof(edge_t)     <= MEM_BUDGET_EDGE,    "RAM budget: edge");
+static_assert(sizeof(journal_t)  <= MEM_BUDGET_JOURNAL, "RAM budget: journal");
+static_assert(sizeof(heap_t)     <= MEM_BUDGET_HEAP,    "RAM budget: heap");
+static_assert(sizeof(capture_t)  <= MEM_BUDGET_CAPTURE, "RAM budget: capture");
+static_assert(sizeof(bridge_t)   <= MEM_BUDGET_BRIDGE,  "RAM budget: bridge");
+static_assert(MEM_USED_TOTAL     <= MEM_BUDGET_TOTAL,   "RAM budget: total");
+#endif
+
 // RFM69
 SPIClass * vspi = NULL;
-RFM69 radio(PIN_CS_RFM, PIN_INT_RFM, true, vspi);
+// RFM69 interrupt also wakes up the loop (see sched_sleep())
+// the receive state of the RFM69 lib (_haveData, DATA, ...) is shared by all instances: the own interrupt pin
+// (payload ready) is checked before reading, the data is copied right after receiveDone() (see radio_loop())
+class RFM69_sched : public RFM69 {
+  public:
+    RFM69_sched(uint8_t pin_cs, uint8_t pin_int, bool high_power, SPIClass* spi) : RFM69(pin_cs, pin_int, high_power, spi), pin_int(pin_int) {}
+    static void IRAM_ATTR isr() {
+      isr0();
+      sched_event(&sched);
+      BaseType_t woken = pdFALSE;
+      if (loop_task != NULL) { vTaskNotifyGiveFromISR(loop_task, &woken); }
+      if (woken) { portYIELD_FROM_ISR(); }
+    }
+    bool receive_done() {
+      if (digitalRead(pin_int)) { _haveData = true; }
+      return receiveDone();
+    }
+    bool ack_received(uint16_t node) {
+      if (digitalRead(pin_int)) { _haveData = true; }
+      return ACKReceived(node);
+    }
+    // bitrate, frequency deviation and RX bandwidth (standby, then receiving again), false = frame not read yet
+    bool set_bitrate(uint16_t bitrate, uint16_t fdev, uint8_t rxbw) {
+      if (_haveData || digitalRead(pin_int)) { return false; }
+      setMode(RF69_MODE_STANDBY);
+      writeReg(REG_BITRATEMSB, bitrate >> 8);
+      writeReg(REG_BITRATELSB, bitrate & 0xFF);
+      writeReg(REG_FDEVMSB, fdev >> 8);
+      writeReg(REG_FDEVLSB, fdev & 0xFF);
+      writeReg(REG_RXBW, rxbw);
+      receiveBegin();
+      return true;
+    }
+    uint8_t pin_int;
+    uint8_t link_rate = 0;
+};
+RFM69_sched radio(PIN_CS_RFM, PIN_INT_RFM, true, vspi);
+#if RADIO_COUNT > 1
+RFM69_sched radio_2(PIN_CS_RFM_2, PIN_INT_RFM_2, true, vspi);
+RFM69_sched* rfm[RADIO_COUNT] = { &radio, &radio_2 };
+const radio_geometry_t* rfm_geometry[RADIO_COUNT] = { &radio_geometry, &radio_geometry_2 };
+const uint8_t rfm_frequency[RADIO_COUNT] = { FREQUENCY, FREQUENCY_2 };
+#else
+RFM69_sched* rfm[RADIO_COUNT] = { &radio };
+const radio_geometry_t* rfm_geometry[RADIO_COUNT] = { &radio_geometry };
+const uint8_t rfm_frequency[RADIO_COUNT] = { FREQUENCY };
+#endif
 
 // prototypes
 void macCharArrayToBytes(const char* str, byte* bytes);
-void ethernetWizReset(const uint8_t resetPin);
-void connectEthernet();
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 void mqttReconnect();
-void publish_mqtt(uint8_t nodeID, char* payload, uint8_t payload_lenght);
-uint32_t time_func(uint32_t time_diff);
-
-// prototypes rfm + receive function
-uint8_t rfm_transmit(uint8_t dest, uint8_t* data, uint8_t len);
-uint8_t rfm_receive(uint8_t* src, uint8_t* data, uint8_t* len);
-uint8_t rfm_sendACK(uint8_t dest);
-uint8_t rfm_ACKReceived(uint8_t dest);
-uint8_t rfm_ACKRequested(uint8_t src);
-uint8_t rfm_receiveDone(void);
+bool mqtt_publish(const char* topic, const uint8_t* payload, uint16_t length, bool retain);
+bool mqtt_publish(const char* topic, const char* payload, bool retain = false);
+bool publish_bridge(const char* topic, const uint8_t* payload, uint16_t length, bool retain);
+bool mqtt_connected();
+void publish_aggregate(uint8_t nodeID, char* payload, uint16_t payload_lenght);
+bool publish_journal(uint8_t nodeID, uint8_t* payload, uint16_t payload_lenght, uint32_t time);
+void publish_stats();
+void publish_boot();
+bool capture_serial_write(uint8_t* data, uint16_t len);
+void sched_wait(uint32_t time_ms);
+void print_memory_budget();
+uint32_t heap_free_size();
+uint32_t heap_largest_block();
+
+// prototypes scheduler jobs
+void job_ethernet(void* arg);
+void job_boot(void* arg);
+void job_status(void* arg);
+void job_mqtt_reconnect(void* arg);
+void job_status_led(void* arg);
+void job_rx_led(void* arg);
+void job_tx_led(void* arg);
+void job_bulk_resume(void* arg);
+void job_button(void* arg);
+void job_display(void* arg);
+void job_stats(void* arg);
+void job_edge(void* arg);
+void job_heap(void* arg);
+
+// prototypes receive function (rfm functions: see radio.h)
 void receive(uint8_t source, uint8_t* data, uint16_t len);
-
-// variables
-static uint32_t time_rxLED = time_func(0);
+void error_handler(radio_error_code_t error);
+void show_rx(uint8_t source, uint8_t* data, uint16_t len);
+void show_tx(uint8_t dest, uint16_t handle, radio_tx_status_t status, uint8_t* data, uint16_t len);
+void start_boot();
+void print_line(const char* text);
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status);
+uint16_t bulk_read(uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len);
+void bulk_done(uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset);
+
+// scheduler jobs (one-shot LED timeouts, retriggered by RX / TX)
+int8_t job_id_rx_led = -1;
+int8_t job_id_tx_led = -1;
+int8_t job_id_button = -1;
+int8_t job_id_ethernet = -1;
+int8_t job_id_mqtt = -1;
+int8_t job_id_boot = -1;
+
+// Ethernet bring-up (job_ethernet())
+typedef enum { eth_RESET, eth_RESET_LOW, eth_RESET_HIGH, eth_BEGIN, eth_LINK, eth_UP } eth_state_t;
+eth_state_t eth_state = eth_RESET;
 
 void setup() {
   Serial.begin(115200);   // init UART
+  print_memory_budget();
+  heap_init((void*)heap_free_size, (void*)heap_largest_block);
   LEDs_PCF8574.begin();   // init PCF8574
   LEDs_PCF8574.write(LED_status_LAN_red,   0);
   LEDs_PCF8574.write(LED_status_error_red, 0);
 
+  // scheduler (time base for the display as well)
+  loop_task = xTaskGetCurrentTaskHandle();
+  sched_init(&sched, (void*)micros, (void*)sched_wait);
+  stats_init(&stats, millis());
+
+  // RFM69 init first: messages are received (and journaled) while Ethernet / MQTT come up
+  vspi = new SPIClass(VSPI);
+  for (uint8_t i = 0; i < RADIO_COUNT; i++) {
+    rfm[i]->initialize(rfm_frequency[i],NODEID,NETWORKID);
+    rfm[i]->setHighPower();
+    rfm[i]->encrypt(ENCRYPTKEY);
+    attachInterrupt(digitalPinToInterrupt(rfm[i]->pin_int), RFM69_sched::isr, RISING);
+
+    // radio lib init
+    radio_init(&radio_drv[i], NODEID, rfm_geometry[i]);
+    radio_set_cb_func(&radio_drv[i], (void*)receive, (void*)delay, (void*)error_handler, (void*)millis);
+    radio_set_cb_bulk(&radio_drv[i], (void*)bulk_read, (void*)NULL, (void*)bulk_done);
+    radio_set_cb_tx_status(&radio_drv[i], (void*)tx_status);
+    radio_beacon_enable(&radio_drv[i], BEACON_MODE);
+    radio_link_enable(&radio_drv[i], LINK_ADAPTATION);
+  }
+  route_init(&route, radio_drv, RADIO_COUNT);
+  stats_boot(&stats, stats_boot_RADIO, millis());
+
   // Outputs
   pinMode(PIN_BUTTON, INPUT_PULLUP);
 
@@ -74,121 +228,242 @@ void setup() {
   display.setTextColor(SSD1306_WHITE);
 
   // Display Lib init
-  disp_init(&disp, &display, ETHERNET_IP, MQTT_HOSTNAME);
+  disp_init(&disp, &display, &sched, ETHERNET_IP, MQTT_HOSTNAME);
+
+  // last value cache, report by exception
+  cache_init(&cache);
+  edge_init(&edge, publish_aggregate);
+
+  // offline journal (LittleFS is formatted on the first start)
+  if (!LittleFS.begin(true)) {
+    Serial.println("LittleFS mount failed, journal disabled");
+  }
+  journal_init(&journal, JOURNAL_FILE, publish_journal);
+  if (journal.bytes_recovered) {
+    Serial.print("journal: incomplete record removed (");
+    Serial.print(journal.bytes_recovered);
+    Serial.println(" bytes)");
+  }
+  stats_boot(&stats, stats_boot_STORAGE, millis());
 
-  // MQTT / Ethernet
-  connectEthernet();
+  // traffic capture (file on LittleFS or serial stream, "base_0x01_ctl/capture")
+  capture_init(&capture, CAPTURE_FILE, capture_serial_write);
+  if (CAPTURE_MODE != capture_OFF) {
+    capture_start(&capture, CAPTURE_MODE, NODEID, RADIO_COUNT, millis());
+  }
+
+  // uplink / downlink handling (shared with the host replay tools/replay.c)
+  bridge_init(&bridge, NODEID, &route, &stats, &cache, &edge, &journal, &capture);
+  bridge_set_cb_mqtt(&bridge, (void*)publish_bridge, (void*)mqtt_connected);
+  bridge_set_cb_notify(&bridge, (void*)show_rx, (void*)show_tx, (void*)start_boot, (void*)print_line);
+
+  // MQTT / Ethernet (connected by job_ethernet() and job_mqtt_reconnect())
   ethClient.setConnectionTimeout(1000);
   mqttClient.setClient(ethClient);
   mqttClient.setServer(MQTT_HOSTNAME, MQTT_PORT);
-  mqttReconnect();
-
-  // RFM69 init
-  vspi = new SPIClass(VSPI);
-  radio.initialize(FREQUENCY,NODEID,NETWORKID);
-  radio.setHighPower();
-  radio.encrypt(ENCRYPTKEY);
-
-  // radio lib init
-  radio_init(&radio_drv, NODEID);
-  radio_set_cb_rfm (&radio_drv, (void*)rfm_transmit, (void*)rfm_receive, (void*)rfm_sendACK, (void*)rfm_ACKReceived, (void*)rfm_ACKRequested, (void*)rfm_receiveDone);
-  radio_set_cb_func(&radio_drv, (void*)receive, (void*)delay, (void*)NULL);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+
+  // scheduler jobs
+  job_id_ethernet = sched_add(&sched, job_ethernet, NULL, ETHERNET_POWER_UP_MS, 0);
+  job_id_mqtt = sched_add(&sched, job_mqtt_reconnect, NULL, MQTT_RECONNECT_INTERVAL_MS, MQTT_RECONNECT_INTERVAL_MS);
+  job_id_boot = sched_add(&sched, job_boot, NULL, 0, 0);
+  sched_stop(&sched, job_id_boot);    // started on demand
+  sched_add(&sched, job_status,         NULL, 0,   STATUS_INTERVAL_MS);
+  sched_add(&sched, job_status_led,     NULL, 800, 800);
+  sched_add(&sched, job_bulk_resume,    NULL, BULK_RESUME_INTERVAL_MS, BULK_RESUME_INTERVAL_MS);
+  sched_add(&sched, job_display,        NULL, 100, 100);
+  sched_add(&sched, job_stats,          NULL, STATS_PUBLISH_INTERVAL_MS, STATS_PUBLISH_INTERVAL_MS);
+  sched_add(&sched, job_edge,           NULL, 1000, 1000);
+  sched_add(&sched, job_heap,           NULL, HEAP_SAMPLE_INTERVAL_MS, HEAP_SAMPLE_INTERVAL_MS);
+  job_id_button = sched_add(&sched, job_button, NULL, 0, BUTTON_POLL_INTERVAL_MS);
+  job_id_rx_led = sched_add(&sched, job_rx_led, NULL, 0, 0);
+  job_id_tx_led = sched_add(&sched, job_tx_led, NULL, 0, 0);
 }
 
 void loop() {
 
-  // MQTT / Ethernet connecting functions
-  if (!ethClient.connected()) {
-    LEDs_PCF8574.write(LED_status_LAN_red, 0);
-  } else {
-    LEDs_PCF8574.write(LED_status_LAN_red, 1);
-  }
-  if (!mqttClient.connected()) {
-    LEDs_PCF8574.write(LED_status_error_red, 0);
-    mqttReconnect();
-  } else {
-    LEDs_PCF8574.write(LED_status_error_red, 1);
-  }
+  // timed jobs (LEDs, MQTT reconnect, display, statistics, ...)
+  sched_loop(&sched);
   mqttClient.loop();
 
-  // LED status
-  static uint32_t time_StatusLED = time_func(0);
-  if (time_func(time_StatusLED) > 800) {
-    LEDs_PCF8574.toggle(LED_status_ESP_active);
-    time_StatusLED = time_func(0);
-  }
-
-  // LEDs tx + rx
-  static uint32_t time_txLED = time_func(0);
-  if (!radio_buffer_empty_tx(&radio_drv)) {
+  // LED tx: on while a TX buffer is not empty, off 200 ms later
+  if (!route_buffer_empty_tx(&route)) {
     LEDs_PCF8574.write(LED_status_data_TX, 0);
-    time_txLED = time_func(0);
-  }
-  if (time_func(time_rxLED) > 200) {
-    LEDs_PCF8574.write(LED_status_data_RX, 1);
+    sched_start(&sched, job_id_tx_led, 200);
   }
-  if (time_func(time_txLED) > 200) {
-    LEDs_PCF8574.write(LED_status_data_TX, 1);
+
+  // radios (do not block while waiting for an ACK, they transmit in parallel)
+  route_loop(&route);
+
+  // offline journal: write batch, replay after reconnect
+  journal_loop(&journal, millis(), mqttClient.connected());
+  capture_loop(&capture, millis());
+
+  // command status, snapshot (after the journal replay), raw topic timeout
+  bridge_loop(&bridge, millis());
+
+  // sleep until the next job or RFM interrupt (not while the radio has something to send)
+  if (route_buffer_empty_tx(&route) && !bridge_bulk_running(&bridge)) {
+    sched_sleep(&sched, SCHED_IDLE_MAX_MS);
   }
+}
 
-  // radio
-  radio_loop(&radio_drv);
+// MQTT / Ethernet state LEDs
+void job_status(void* arg) {
+  LEDs_PCF8574.write(LED_status_LAN_red,   ethClient.connected()  ? 1 : 0);
+  LEDs_PCF8574.write(LED_status_error_red, mqttClient.connected() ? 1 : 0);
+}
 
-  // button
-  static uint32_t time_Button01 = time_func(0);
-  if (!digitalRead(PIN_BUTTON) && time_func(time_Button01) > 200) {
+void job_mqtt_reconnect(void* arg) {
+  if (eth_state == eth_UP && !mqttClient.connected()) { mqttReconnect(); }
+}
+
+// boot phase times "base_0x01_stats/boot" (after the MQTT connection and the first published message)
+void job_boot(void* arg) {
+  publish_boot();
+}
+
+void job_status_led(void* arg) {
+  LEDs_PCF8574.toggle(LED_status_ESP_active);
+}
+
+void job_rx_led(void* arg) {
+  LEDs_PCF8574.write(LED_status_data_RX, 1);
+}
+
+void job_tx_led(void* arg) {
+  LEDs_PCF8574.write(LED_status_data_TX, 1);
+}
+
+// bulk transfer: resume after a pause (e.g. sleeping node), give up after BULK_MAX_RESUMES
+void job_bulk_resume(void* arg) {
+  bridge_bulk_resume(&bridge);
+}
+
+// button: next page, next poll after 200 ms (debounce)
+void job_button(void* arg) {
+  if (!digitalRead(PIN_BUTTON)) {
     disp_set_next_page(&disp);
-    time_Button01 = time_func(0);
+    sched_start(&sched, job_id_button, 200);
   }
+}
 
-  // display refresh
-  static uint32_t time_DisplayRefresh = time_func(0);
-  if (time_func(time_DisplayRefresh) > 100) {
-    disp_refresh_display(&disp);
-    time_DisplayRefresh = time_func(0);
-  }
+void job_display(void* arg) {
+  disp_refresh_display(&disp);
 }
 
-void publish_mqtt(uint8_t nodeID, char* payload, uint8_t payload_lenght) {
+void job_stats(void* arg) {
+  publish_stats();
+}
 
-  // generate address strings
-  char node_id[3];
-  char type_id[3];
-  char base_id[3];
-  uint8_t base_id_int = NODEID;
-  sprintf(node_id, "%02x", nodeID);
-  sprintf(type_id, "%02x", nodeID & 0xF0);
-  sprintf(base_id, "%02x", base_id_int);
-    
-  // generate topic string
-  char topic[50];
-  strcpy(topic, "base_0x");
-  strcat(topic, base_id);
-  strcat(topic, "_rx/nodes_0x");
-  strcat(topic, type_id);
-  strcat(topic, "/node_0x");
-  strcat(topic, node_id);
-
-  // publish + workaround to avoid additional invalid characters
-  // looks like something in the mqtt lib is ignoring the lenght and just looking for a \0 in the string
-  uint8_t* pnt = (uint8_t*)malloc(payload_lenght + 1);
-  memcpy(pnt, payload, payload_lenght);
-  pnt[payload_lenght] = '\0';
-  mqttClient.publish(topic, pnt, payload_lenght);
-  free(pnt);
+// aggregation windows
+void job_edge(void* arg) {
+  edge_loop(&edge, millis());
+}
+
+// heap low watermark / fragmentation, orphaned radio buffers
+void job_heap(void* arg) {
+  heap_sample();
+  route_sweep(&route);
+}
+
+// aggregates of edge.h "base_0x01_agg/nodes_0x10/node_0x11"
+void publish_aggregate(uint8_t nodeID, char* payload, uint16_t payload_lenght) {
+  bridge_publish_aggregate(&bridge, nodeID, payload, payload_lenght);
+}
+
+bool publish_journal(uint8_t nodeID, uint8_t* payload, uint16_t payload_lenght, uint32_t time) {
+  if (!mqttClient.connected()) { return false; }
+  Serial.print("journal replay, age ");
+  Serial.print((millis() - time) / 1000);
+  Serial.print(" s ");
+  return bridge_publish_rx(&bridge, nodeID, (char*)payload, payload_lenght, millis());
+}
+
+// messages of the bridge ("base_0x01_rx/...", "base_0x01_tx_status/...", ...)
+bool publish_bridge(const char* topic, const uint8_t* payload, uint16_t length, bool retain) {
+  bool published = mqtt_publish(topic, payload, length, retain);
 
   // Debug Output
   Serial.print("<- ");
   Serial.print(topic);
   Serial.print(" = ");
-  for (byte i = 0; i < payload_lenght; i++) {
+  for (uint16_t i = 0; i < length; i++) {
       if (payload[i] >= 32 && payload[i] <= 126) {
-        Serial.print(payload[i]);
+        Serial.print((char)payload[i]);
       } else {
         Serial.print(".");
       }
   }
   Serial.print("\n\r");
+  return published;
+}
+
+bool mqtt_connected() {
+  return mqttClient.connected();
+}
+
+void publish_stats() {
+  stats_update(&stats, millis());
+  if (!mqttClient.connected()) { return; }
+
+  // topic prefix "base_0x01_stats/"
+  char topic[50];
+  char base_id[3];
+  uint8_t base_id_int = NODEID;
+  sprintf(base_id, "%02x", base_id_int);
+  strcpy(topic, "base_0x");
+  strcat(topic, base_id);
+  strcat(topic, "_stats/");
+  uint8_t topic_prefix_len = strlen(topic);
+  char payload[STATS_MAX_PAYLOAD_SIZE];
+
+  // base
+  strcpy(topic + topic_prefix_len, "base");
+  if (stats_format_base(&stats, &route, &sched, payload, sizeof(payload))) {
+    mqtt_publish(topic, payload);
+  }
+
+  // report by exception
+  strcpy(topic + topic_prefix_len, "edge");
+  if (stats_format_edge(&edge, payload, sizeof(payload))) {
+    mqtt_publish(topic, payload);
+  }
+
+  // heap monitor
+  strcpy(topic + topic_prefix_len, "heap");
+  if (stats_format_heap(heap_get(), &route, payload, sizeof(payload))) {
+    mqtt_publish(topic, payload);
+  }
+
+  // routing (several radios)
+  strcpy(topic + topic_prefix_len, "route");
+  if (route.radio_count > 1 && stats_format_route(&route, payload, sizeof(payload))) {
+    mqtt_publish(topic, payload);
+  }
+
+  // nodes (link statistics of the radio the node is routed to)
+  for (int r = 0; r < RADIO_COUNT; r++) {
+    for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+      radio_node_t* node = &radio_drv[r].nodes[i];
+      if (!node->valid || route_radio(&route, node->address) != &radio_drv[r]) { continue; }
+      sprintf(topic + topic_prefix_len, "node_0x%02x", node->address);
+      if (stats_format_node(&stats, node, payload, sizeof(payload))) {
+        mqtt_publish(topic, payload);
+      }
+    }
+  }
+}
+
+
+void publish_boot() {
+  if (!mqttClient.connected()) { return; }
+  char topic[30];
+  char payload[STATS_MAX_PAYLOAD_SIZE];
+  sprintf(topic, "base_0x%02x_stats/boot", NODEID);
+  if (stats_format_boot(&stats, payload, sizeof(payload))) {
+    mqtt_publish(topic, payload, MQTT_RETAIN);
+  }
 }
 
 
@@ -208,51 +483,66 @@ void macCharArrayToBytes(const char* str, byte* bytes) {
     }
 }
 
-void ethernetWizReset(const uint8_t resetPin) {
-    pinMode(resetPin, OUTPUT);
-    digitalWrite(resetPin, HIGH);
-    delay(250);
-    digitalWrite(resetPin, LOW);
-    delay(50);
-    digitalWrite(resetPin, HIGH);
-    delay(350);
-}
-
-void connectEthernet() {
-    delay(500);
-    byte* mac = new byte[6];
-    macCharArrayToBytes(ETHERNET_MAC, mac);
-    ipAddress.fromString(ETHERNET_IP);
-
-    Ethernet.init(ETHERNET_CS_PIN);
-    ethernetWizReset(ETHERNET_RESET_PIN);
-
-    Serial.println("Starting ETHERNET connection...");
-    Ethernet.begin(mac, ipAddress);
-    delay(200);
-
-    Serial.print("Ethernet IP is: ");
-    Serial.println(Ethernet.localIP());
+// W5500 reset + Ethernet.begin() as state machine, the delays are scheduler timeouts (radio keeps receiving)
+void job_ethernet(void* arg) {
+    static byte mac[6];
+    switch (eth_state) {
+        case eth_RESET:
+            Ethernet.init(ETHERNET_CS_PIN);
+            pinMode(ETHERNET_RESET_PIN, OUTPUT);
+            digitalWrite(ETHERNET_RESET_PIN, HIGH);
+            eth_state = eth_RESET_LOW;
+            sched_start(&sched, job_id_ethernet, 250);
+            break;
+        case eth_RESET_LOW:
+            digitalWrite(ETHERNET_RESET_PIN, LOW);
+            eth_state = eth_RESET_HIGH;
+            sched_start(&sched, job_id_ethernet, 50);
+            break;
+        case eth_RESET_HIGH:
+            digitalWrite(ETHERNET_RESET_PIN, HIGH);
+            eth_state = eth_BEGIN;
+            sched_start(&sched, job_id_ethernet, 350);
+            break;
+        case eth_BEGIN:
+            macCharArrayToBytes(ETHERNET_MAC, mac);
+            ipAddress.fromString(ETHERNET_IP);
+            Serial.println("Starting ETHERNET connection...");
+            Ethernet.begin(mac, ipAddress);
+            eth_state = eth_LINK;
+            sched_start(&sched, job_id_ethernet, 200);
+            break;
+        case eth_LINK:
+            Serial.print("Ethernet IP is: ");
+            Serial.println(Ethernet.localIP());
+            stats_boot(&stats, stats_boot_ETHERNET, millis());
+            eth_state = eth_UP;
+            sched_start(&sched, job_id_mqtt, 0); // first attempt now
+            break;
+        case eth_UP:
+            break;
+    }
 }
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-
-  // get destination & len
-  uint8_t topic_len = strlen(topic);
-  uint8_t destination = 0x00;
-  if (topic_len == 22) {
-    destination = (uint8_t)strtol((topic + 18), NULL, 0);
+  if (!bridge_mqtt_in(&bridge, topic, (uint8_t*)payload, length, millis())) {
+    LEDs_PCF8574.write(LED_status_data_TX, 1);   // no destination
   }
-  if (destination == 0x00) {
-    LEDs_PCF8574.write(LED_status_data_TX, 1);
-    return;
+}
+
+// publish, the payload is streamed from the caller's buffer (no copy, no \0 needed)
+bool mqtt_publish(const char* topic, const uint8_t* payload, uint16_t length, bool retain) {
+  capture_mqtt_out(&capture, topic, length, millis());
+  bool published = mqttClient.beginPublish(topic, length, retain);
+  if (published) {
+    published = mqttClient.write(payload, length) == length;
+    published = mqttClient.endPublish() && published;
   }
+  return published;
+}
 
-  // transmit
-  radio_transmit(&radio_drv, destination, (uint8_t*)payload, length);
-  
-  // store msg to display lib
-  disp_add_tx(&disp, destination, (char*)payload, length);
+bool mqtt_publish(const char* topic, const char* payload, bool retain) {
+  return mqtt_publish(topic, (const uint8_t*)payload, strlen(payload), retain);
 }
 
 void mqttReconnect() {
@@ -265,10 +555,15 @@ void mqttReconnect() {
   sprintf(base_id, "%02x", base_id_int);
   strcpy(deviceName, "base_0x");
   strcat(deviceName, base_id);
-  while(!mqttClient.connect(deviceName)) {
+  // single attempt, retried by job_mqtt_reconnect() (the radio keeps receiving into the journal meanwhile)
+  if (!mqttClient.connect(deviceName)) {
     Serial.print("Connecting to MQTT as ");
-    Serial.println(deviceName);
-    delay(1000);
+    Serial.print(deviceName);
+    Serial.println(" failed");
+    return;
+  }
+  if (stats_boot(&stats, stats_boot_MQTT, millis())) {
+    sched_start(&sched, job_id_boot, 0);
   }
   Serial.print("Connected to MQTT as ");
   Serial.print(deviceName);
@@ -276,13 +571,31 @@ void mqttReconnect() {
   Serial.print(Ethernet.localIP());
   Serial.println(")");
 
-  // subscribe "base_0x01_tx"
-  strcat(deviceName, "_tx/+");
+  // subscribe "base_0x01_tx" + "base_0x01_bulk" + "base_0x01_ctl"
+  char topic[30];
   mqttClient.setCallback(mqttCallback);
-  mqttClient.subscribe(deviceName);
+  strcpy(topic, deviceName);
+  strcat(topic, "_tx/+");
+  mqttClient.subscribe(topic);
   Serial.print("Subscribed topic \"");
-  Serial.print(deviceName);
+  Serial.print(topic);
   Serial.println("\"");
+  strcpy(topic, deviceName);
+  strcat(topic, "_bulk/+");
+  mqttClient.subscribe(topic);
+  Serial.print("Subscribed topic \"");
+  Serial.print(topic);
+  Serial.println("\"");
+  strcpy(topic, deviceName);
+  strcat(topic, "_ctl/+");
+  mqttClient.subscribe(topic);
+  Serial.print("Subscribed topic \"");
+  Serial.print(topic);
+  Serial.println("\"");
+}
+
+bool capture_serial_write(uint8_t* data, uint16_t len) {
+  return Serial.write(data, len) == len;
 }
 
 
@@ -290,48 +603,112 @@ void mqttReconnect() {
 // RFM + radio lib functions
 /////////////////////////////////////////////////////////////////////////////
 
-uint8_t rfm_transmit(uint8_t dest, uint8_t* data, uint8_t len) {
-  radio.send(dest, data, len, true);
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+  uint8_t index = route_index(&route, obj);
+  capture_tx(&capture, index, dest, 0, data, len, millis());
+  rfm[index]->send(dest, data, len, true);
   return 0;
 }
 
-uint8_t rfm_receive(uint8_t* src, uint8_t* data, uint8_t* len) {
-  *len = radio.DATALEN;
-  *src = radio.SENDERID;
-  for (int i=0; i<*len && i<RF69_MAX_DATA_LEN; i++) {
-    data[i] = radio.DATA[i];
-  }
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+  uint8_t index = route_index(&route, obj);
+  RFM69_sched* rfm_obj = rfm[index];
+  *len = rfm_obj->DATALEN;
+  *src = rfm_obj->SENDERID;
+  radio_node_set_rssi(obj, rfm_obj->SENDERID, rfm_obj->RSSI);
+  route_rx(&route, obj, rfm_obj->SENDERID, rfm_obj->RSSI, millis());
+  if (*len > RF69_MAX_DATA_LEN) { *len = RF69_MAX_DATA_LEN; }
+  memcpy(data, (const void*)rfm_obj->DATA, *len);   // data = frame of the radio lib RX pool
+  capture_rx(&capture, index, *src, rfm_obj->RSSI,
+             (rfm_obj->ACK_REQUESTED ? CAPTURE_FLAG_ACK_REQUESTED : 0) | (rfm_obj->TARGETID == RF69_BROADCAST_ADDR ? CAPTURE_FLAG_BROADCAST : 0),
+             data, *len, millis());
   return 0;
 }
 
-uint8_t rfm_sendACK(uint8_t dest) {
-  radio.sendACK();
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+  uint8_t index = route_index(&route, obj);
+  capture_tx(&capture, index, dest, CAPTURE_FLAG_ACK, data, len, millis());
+  rfm[index]->sendACK(data, len);
   return 0;
 }
 
-uint8_t rfm_ACKReceived(uint8_t dest) {
-  return radio.ACKReceived(dest);
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+  uint8_t index = route_index(&route, obj);
+  if (!rfm[index]->ack_received(dest)) { return 0; }
+  capture_ack(&capture, index, dest, millis());
+  return 1;
 }
 
-uint8_t rfm_ACKRequested(uint8_t src) {
-  return radio.ACKRequested();
+// an uplink heard by several radios is ACKed by the radio of the node only
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+  return rfm[route_index(&route, obj)]->ACKRequested() && route_ack(&route, obj, src);
 }
 
-uint8_t rfm_receiveDone(void) {
-  return radio.receiveDone();
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+  return rfm[route_index(&route, obj)]->receive_done();
+}
+
+// link profile (see RADIO_LINK_x): registers per bitrate step (55.5 / 100 / 200 kbit/s, deviation 50 / 100 / 100 kHz,
+// RX bandwidth 125 / 250 / 250 kHz), TX power in dBm to the power level 0..31 of the RFM69HW (-2..+20 dBm, linear)
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+  static const uint16_t bitrate_reg[RADIO_LINK_STEPS] = { 0x0240, 0x0140, 0x00A0 };
+  static const uint16_t fdev_reg[RADIO_LINK_STEPS] = { 0x0333, 0x0666, 0x0666 };
+  static const uint8_t rxbw_reg[RADIO_LINK_STEPS] = { 0x42, 0x41, 0x41 };
+  RFM69_sched* rfm_obj = rfm[route_index(&route, obj)];
+  if (rate != rfm_obj->link_rate) {
+    if (!rfm_obj->set_bitrate(bitrate_reg[rate], fdev_reg[rate], rxbw_reg[rate])) { return 0; }
+    rfm_obj->link_rate = rate;
+  }
+  rfm_obj->setPowerLevel((uint8_t)((power - RADIO_LINK_POWER_MIN) * 31 / (RADIO_LINK_POWER_MAX - RADIO_LINK_POWER_MIN)));
+  return 1;
 }
 
 void receive(uint8_t source, uint8_t* data, uint16_t len) {
+  bridge_receive(&bridge, source, data, len, millis());
+}
 
-  // publish to MQTT
-  publish_mqtt(source, (char*)data, len);
+uint16_t bulk_read(uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len) {
+  return bridge_bulk_read(&bridge, dest, transfer_id, offset, data, len);
+}
 
-  // store msg to display lib
-  disp_add_rx(&disp, source, (char*)data, len);
+void bulk_done(uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset) {
+  Serial.print("bulk transfer 0x");
+  Serial.print(address, HEX);
+  Serial.print(status == radio_bulk_DONE ? " done " : " paused at ");
+  Serial.println(offset);
+  bridge_bulk_done(&bridge, address, transfer_id, status, offset);
+}
 
-  // RX LED
+// queued, published by bridge_loop()
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+  bridge_tx_status(&bridge, dest, handle, status);
+}
+
+// uplink passed on: display, RX LED
+void show_rx(uint8_t source, uint8_t* data, uint16_t len) {
+  disp_add_rx(&disp, source, (char*)data, len);
   LEDs_PCF8574.write(LED_status_data_RX, 0);
-  time_rxLED = time_func(0);
+  sched_start(&sched, job_id_rx_led, 200);
+}
+
+// downlink passed to the radio (group message: handle 0)
+void show_tx(uint8_t dest, uint16_t handle, radio_tx_status_t status, uint8_t* data, uint16_t len) {
+  disp_add_tx(&disp, dest, (char*)data, len);
+}
+
+// first uplink published: boot phase times
+void start_boot() {
+  sched_start(&sched, job_id_boot, 0);
+}
+
+void print_line(const char* text) {
+  Serial.println(text);
+}
+
+void error_handler(radio_error_code_t error) {
+  stats_add_error(&stats, error);
+  Serial.print("radio error ");
+  Serial.println((int)error);
 }
 
 
@@ -339,11 +716,42 @@ void receive(uint8_t source, uint8_t* data, uint16_t len) {
 // various functions
 /////////////////////////////////////////////////////////////////////////////
 
-uint32_t time_func(uint32_t time_diff) {
-	uint32_t time = millis();
-	time = (0x7FFFFFFF & time) - (0x7FFFFFFF & time_diff);
-	if (time & 0x80000000) {
-		time = time + 0x80000000;
-	}
-	return time;
+// sched_sleep(): block the loop task until timeout or RFM interrupt (task notification)
+void sched_wait(uint32_t time_ms) {
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(time_ms));
+}
+
+// platform functions of the heap monitor
+uint32_t heap_free_size() {
+  return ESP.getFreeHeap();
+}
+
+uint32_t heap_largest_block() {
+  return ESP.getMaxAllocHeap();
+}
+
+// "RAM radio: 9782 / 10240" ...
+void print_memory_budget() {
+  const struct { const char* name; uint32_t used; uint32_t budget; } mem[] = {
+    { "radio",   MEM_USED_RADIO,     MEM_BUDGET_RADIO },
+    { "route",   sizeof(route_t),    MEM_BUDGET_ROUTE },
+    { "disp",    sizeof(disp_t),     MEM_BUDGET_DISP },
+    { "sched",   sizeof(sched_t),    MEM_BUDGET_SCHED },
+    { "stats",   sizeof(stats_t),    MEM_BUDGET_STATS },
+    { "cache",   sizeof(cache_t),    MEM_BUDGET_CACHE },
+    { "edge",    sizeof(edge_t),     MEM_BUDGET_EDGE },
+    { "journal", sizeof(journal_t),  MEM_BUDGET_JOURNAL },
+    { "heap",    sizeof(heap_t),     MEM_BUDGET_HEAP },
+    { "capture", sizeof(capture_t),  MEM_BUDGET_CAPTURE },
+    { "bridge",  sizeof(bridge_t),   MEM_BUDGET_BRIDGE },
+    { "total",   MEM_USED_TOTAL,     MEM_BUDGET_TOTAL },
+  };
+  for (uint8_t i = 0; i < sizeof(mem) / sizeof(mem[0]); i++) {
+    Serial.print("RAM ");
+    Serial.print(mem[i].name);
+    Serial.print(": ");
+    Serial.print(mem[i].used);
+    Serial.print(" / ");
+    Serial.println(mem[i].budget);
+  }
 }
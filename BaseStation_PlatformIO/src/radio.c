@@ -1,528 +1,2527 @@
-/////////////////////////////////////////////////////
-// FILENAME:    radio.c                            //
-// DESCRIPTION: function handler for RFM69 modules //
-// AUTHOR:      Moritz Kimmig                      //
-// DATE:        see header                         //
-// VERSION:     see header                         //
-/////////////////////////////////////////////////////
-
-#include <string.h>
-#include <stdlib.h>
-#include "radio.h"
-
-typedef struct{
-	uint8_t part;
-	uint8_t parts_total;
-	uint8_t reserved;
-	uint8_t crc8;
-} radio_header_t;
-
-typedef enum {
-	radio_BUFFER_TX,
-	radio_BUFFER_RX
-} radio_buffer_t;
-
-#define RADIO_MSG_MAX_LENGTH_RFM  61
-#define RADIO_MSG_HEADER_SIZE    (uint8_t) sizeof(radio_header_t)
-#define RADIO_MSG_MAX_DATA_SIZE  (uint8_t)(RADIO_MSG_MAX_LENGTH_RFM - RADIO_MSG_HEADER_SIZE)
-#define RADIO_RFM_DELAY_BEFORE_ACK_TIME 5 // ms
-
-
-/* Private function prototypes ------------------------------------------------------------------*/
-
-void     radio_throw_error     (radio_t* obj, radio_error_code_t error);
-uint8_t  radio_cal_CRC         (radio_t* obj, uint8_t* data, uint16_t len);
-uint8_t* radio_generate_tx_data(radio_t* obj, radio_message_t* msg);
-
-// buffer functions
-void radio_buffer_rx_add             (radio_t* obj, uint8_t src,  uint8_t* data, uint8_t len);
-void radio_buffer_tx_add             (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len);
-void radio_buffer_rx_merge_single_msg(radio_t* obj);
-uint8_t radio_buffer_tx_get          (radio_t* obj, radio_message_t* msg);
-void radio_buffer_rx_get             (radio_t* obj, radio_message_t* msg);
-void radio_buffer_sort               (radio_t* obj, radio_buffer_t buffer);
-
-// header functions
-void    radio_generate_header       (radio_t* obj, radio_header_t* header, radio_message_t* msg);
-uint8_t radio_header_get_PART       (radio_t* obj, radio_header_t* header);
-uint8_t radio_header_get_PARTS_TOTAL(radio_t* obj, radio_header_t* header);
-uint8_t radio_header_get_CRC        (radio_t* obj, radio_header_t* header);
-uint8_t radio_header_del_CRC        (radio_t* obj, radio_header_t* header);
-uint8_t radio_header_cal_CRC        (radio_t* obj, radio_message_t* msg);
-
-
-/* Public functions -----------------------------------------------------------------------------*/
-
-void radio_init (radio_t* obj, uint8_t address) {
-	obj->address = address;
-	obj->error_cnt = 0;
-	for (int i=0; i<RADIO_BUFFER_RX_SIZE; i++) { obj->buffer_rx[i].valid = false; }
-	for (int i=0; i<RADIO_BUFFER_TX_SIZE; i++) { obj->buffer_tx[i].valid = false; }
-	obj->rfm_transmit = NULL;
-	obj->rfm_receive = NULL;
-	obj->rfm_sendACK = NULL;
-	obj->rfm_ACKReceived = NULL;
-	obj->rfm_ACKRequested = NULL;
-	obj->rfm_receiveDone = NULL;
-	obj->receive = NULL;
-	obj->delay = NULL;
-	obj->error_handler = NULL;
-}
-
-void radio_set_cb_rfm(radio_t* obj, void* transmit, void* receive, void* sendACK, void* ACKReceived, void* ACKRequested, void* receiveDone) {
-	if (transmit != NULL)		{ obj->rfm_transmit =		transmit; }
-	if (receive != NULL)		{ obj->rfm_receive =		receive; }
-	if (sendACK != NULL)		{ obj->rfm_sendACK =		sendACK; }
-	if (ACKReceived != NULL)    { obj->rfm_ACKReceived =    ACKReceived; }
-	if (ACKRequested != NULL)	{ obj->rfm_ACKRequested =	ACKRequested; }
-	if (receiveDone != NULL)	{ obj->rfm_receiveDone =	receiveDone; }
-}
-
-void radio_set_cb_func(radio_t* obj, void* receive, void* delay, void* error_handler) {
-	if (receive != NULL)	   { obj->receive =       receive; }
-	if (delay != NULL)		   { obj->delay =         delay; }
-	if (error_handler != NULL) { obj->error_handler = error_handler; }
-}
-
-void radio_loop (radio_t* obj) {
-	
-	// RX: check for new data
-	if(obj->rfm_receiveDone()) {
-		
-		// receive
-		uint8_t buffer[RADIO_MSG_MAX_LENGTH_RFM];
-		uint8_t source = 0x00;
-		uint8_t len = 0;
-		obj->rfm_receive(&source, buffer, &len);
-		
-		// add to RX buffer
-		if (len > RADIO_MSG_HEADER_SIZE)
-			radio_buffer_rx_add(obj, source, buffer, len);
-
-		// send ACK
-		if (obj->rfm_ACKRequested(source)) {
-			if (RADIO_RFM_DELAY_BEFORE_ACK) {
-				obj->delay(RADIO_RFM_DELAY_BEFORE_ACK_TIME);
-			}
-			obj->rfm_sendACK(source);
-		}
-	}
-	
-	// Process RX data
-	if (!radio_buffer_empty_rx(obj)) {
-		
-		// merge splitted messages
-		radio_buffer_rx_merge_single_msg(obj);
-		
-		// get next msg (a not splited one)
-		radio_message_t msg;
-		radio_buffer_rx_get(obj, &msg);
-		if (msg.valid == true) {
-			
-			// call external receive function
-			if (obj->receive != NULL)
-				obj->receive(msg.source, msg.data, msg.data_length);
-			free(msg.data);
-		}
-
-		// sort buffer
-		radio_buffer_sort(obj, radio_BUFFER_RX);
-	}
-	
-	// TX: send next message from TX buffer
-	if (!radio_buffer_empty_tx(obj)) {
-		
-		// get next msg
-		radio_message_t msg;
-		uint8_t tx_buffer_pos = radio_buffer_tx_get(obj, &msg);
-		uint8_t* data = radio_generate_tx_data(obj, &msg);
-
-		// send
-		if (msg.data_length && data != NULL) {
-
-			// transmit
-			obj->rfm_transmit(msg.destination, data, (uint8_t)msg.data_length + RADIO_MSG_HEADER_SIZE);
-
-			// TEST ###############################################################################################################
-			//radio_buffer_rx_add(obj, msg.destination, data, (uint8_t)msg.data_length + RADIO_MSG_HEADER_SIZE);
-
-			// handle ACK
-			bool ACKReceived = true;
-			uint16_t wait_time_ACK = 0;
-			while (!obj->rfm_ACKReceived(msg.destination)) {
-				if (wait_time_ACK > RADIO_RFM_MAX_ACK_TIMEOUT) {
-					ACKReceived = false;
-					break;
-				}
-				obj->delay(1);
-				wait_time_ACK++;
-			}
-			if (ACKReceived) {
-				free(msg.data);
-			} else {
-				obj->buffer_tx[tx_buffer_pos].retries++;
-				if (obj->buffer_tx[tx_buffer_pos].retries >= RADIO_RFM_MAX_RETRIES) {
-					obj->buffer_tx[tx_buffer_pos].valid = false; // remove from TX buffer
-					free(msg.data);
-					radio_throw_error(obj, radio_error_RFM_ACK_TIMEOUT);
-				} else {
-					obj->buffer_tx[tx_buffer_pos].valid = true; // keep valid for next transmission attempt
-				}
-			}
-		}
-
-		// free data
-		if (data != NULL) { free(data); }
-
-		// sort buffer
-		radio_buffer_sort(obj, radio_BUFFER_TX);
-	}
-}
-
-bool radio_buffer_empty_tx(radio_t* obj) {
-	for (int i = 0; i < RADIO_BUFFER_TX_SIZE; i++) {
-		if (obj->buffer_tx[i].valid == true) {
-			return false;
-		}
-	}
-	return true;
-}
-
-bool radio_buffer_empty_rx(radio_t* obj) {
-	for (int i = 0; i < RADIO_BUFFER_RX_SIZE; i++) {
-		if (obj->buffer_rx[i].valid == true) {
-			return false;
-		}
-	}
-	return true;
-}
-
-void radio_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
-	if (data == NULL || len == 0) { return; }
-	radio_buffer_tx_add(obj, dest, data, len);
-}
-
-
-/* Private functions ----------------------------------------------------------------------------*/
-
-void radio_generate_header(radio_t* obj, radio_header_t* header, radio_message_t* msg) {
-	header->reserved =    0;
-	header->part =        msg->part;
-	header->parts_total = msg->parts_total;
-	header->crc8 =        0x00;
-}
-
-uint8_t* radio_generate_tx_data(radio_t* obj, radio_message_t* msg) {
-	uint8_t* data = malloc(RADIO_MSG_HEADER_SIZE + msg->data_length);
-	if (data == NULL) {
-		radio_throw_error(obj, radio_error_RAM_FULL);
-		return NULL;
-	}
-
-	radio_header_t header;
-	radio_generate_header(obj, &header, msg);
-	memcpy(data, &header, RADIO_MSG_HEADER_SIZE);						// add header
-	memcpy(data + RADIO_MSG_HEADER_SIZE, msg->data, msg->data_length);  // add data
-	((radio_header_t*)data)->crc8 = radio_cal_CRC(obj, data, RADIO_MSG_HEADER_SIZE + msg->data_length);
-	return data;
-}
-
-void radio_buffer_rx_add (radio_t* obj, uint8_t src, uint8_t* data, uint8_t len) {
-	if (data == NULL || len == 0) { return; }
-
-	// check CRC
-	uint8_t crc_received = radio_header_get_CRC(obj, (radio_header_t*)data);
-	radio_header_del_CRC(obj, (radio_header_t*)data);
-	uint8_t crc_calulated = radio_cal_CRC(obj, data, len);
-	if (crc_received != crc_calulated) {
-		radio_throw_error(obj, radio_error_RX_CRC_WRONG);
-		return;
-	}
-
-	// get next free buffer slot
-	uint8_t pos = 0; bool pos_found = false;
-	for (int i = 0; i < RADIO_BUFFER_RX_SIZE; i++) {
-		if (obj->buffer_rx[i].valid == false) {
-			pos_found = true;
-			pos = i;
-			break;
-		}
-	}
-	if (!pos_found) {
-		radio_throw_error(obj, radio_error_RX_BUFFER_FULL);
-		return;
-	}
-
-	// allocate bytes for message
-	uint8_t data_length = len - RADIO_MSG_HEADER_SIZE;
-	obj->buffer_rx[pos].data = malloc(data_length);
-	if (obj->buffer_rx[pos].data == NULL) {
-		radio_throw_error(obj, radio_error_RAM_FULL);
-		return;
-	}
-
-	// copy data
-	obj->buffer_rx[pos].valid =			true;
-	obj->buffer_rx[pos].source =		src;
-	obj->buffer_rx[pos].destination =	obj->address;
-	obj->buffer_rx[pos].data_length =	data_length;
-	memcpy(obj->buffer_rx[pos].data, data + RADIO_MSG_HEADER_SIZE, data_length);
-	obj->buffer_rx[pos].part =			radio_header_get_PART       (obj, (radio_header_t*)data);
-	obj->buffer_rx[pos].parts_total =	radio_header_get_PARTS_TOTAL(obj, (radio_header_t*)data);
-	obj->buffer_rx[pos].retries =       0;
-}
-
-void radio_buffer_tx_add (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len) {
-	if (data == NULL || len == 0) { return; }
-
-	// get positions of all free buffer slots
-	uint8_t pos[RADIO_BUFFER_TX_SIZE]; uint8_t pos_count = 0;
-	for (int i = 0; i < RADIO_BUFFER_TX_SIZE; i++) {
-		if (obj->buffer_tx[i].valid == false) {
-			pos[pos_count] = i;
-			pos_count++;
-		}
-	}
-
-	// calculate number of single packets
-	uint8_t MSG_MAX_DATA_SIZE = RADIO_MSG_MAX_DATA_SIZE;
-	uint8_t single_packets = ((len - 1) / MSG_MAX_DATA_SIZE) + 1;
-	if (single_packets > pos_count) {
-		radio_throw_error(obj, radio_error_TX_BUFFER_FULL);
-		return;
-	}
-
-	for (int i = 0; i < single_packets; i++) {
-
-		// calculate parameters
-		uint8_t data_length = 0;
-		if (i + 1 == single_packets) {
-			data_length = len % MSG_MAX_DATA_SIZE;
-			if (!data_length) { data_length = MSG_MAX_DATA_SIZE; }
-		} else {
-			data_length = MSG_MAX_DATA_SIZE;
-		}
-		uint16_t pointer_offset = (uint16_t)(i * MSG_MAX_DATA_SIZE);
-
-		// allocate bytes for message
-		obj->buffer_tx[pos[i]].data = malloc(data_length);
-		if (obj->buffer_tx[pos[i]].data == NULL) {
-			radio_throw_error(obj, radio_error_RAM_FULL);
-			return;
-		}
-
-		// copy data
-		obj->buffer_tx[pos[i]].valid = true;
-		obj->buffer_tx[pos[i]].source = obj->address;
-		obj->buffer_tx[pos[i]].destination = dest;
-		obj->buffer_tx[pos[i]].data_length = data_length;
-		memcpy(obj->buffer_tx[pos[i]].data, data + pointer_offset, data_length);
-		obj->buffer_tx[pos[i]].part = i;
-		obj->buffer_tx[pos[i]].parts_total = single_packets;
-		obj->buffer_tx[pos[i]].retries = 0;
-	}
-}
-
-void radio_buffer_rx_merge_single_msg(radio_t* obj) {
-
-	typedef struct {
-		bool valid;
-		uint8_t buffer_pos;
-	} positions_t;
-
-	// check for splitted messages
-	for (int i = 0; i < RADIO_BUFFER_RX_SIZE; i++) {
-		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total > 1) {
-			uint8_t address = obj->buffer_rx[i].source;
-			uint8_t parts_total = obj->buffer_rx[i].parts_total;
-
-			// check if splitted message is complete + get positions
-			uint8_t msg_cnt = 0;
-			positions_t pos[RADIO_BUFFER_RX_SIZE];
-			for (int j = 0; j < RADIO_BUFFER_RX_SIZE; j++) { pos[j].valid = false; }
-			for (int j = 0; j < RADIO_BUFFER_RX_SIZE; j++) {
-				if (obj->buffer_rx[j].valid == true && obj->buffer_rx[j].parts_total == parts_total && obj->buffer_rx[j].source == address) {
-					pos[obj->buffer_rx[j].part % RADIO_BUFFER_RX_SIZE].valid = true;
-					pos[obj->buffer_rx[j].part % RADIO_BUFFER_RX_SIZE].buffer_pos = j;
-					msg_cnt++;
-				}
-			}
-			if (msg_cnt != parts_total) { return; } // parts are missing
-			for (int j = 0; j < parts_total; j++) {
-				if (pos[j].valid == false) { return; } // parts are missing (e.g. in case of the same part number twice)
-			}
-
-			// allocate bytes for full message
-			uint8_t data_length = 0;
-			for (int j = 0; j < parts_total; j++) {
-				data_length = data_length + obj->buffer_rx[pos[j].buffer_pos].data_length;
-			}
-			uint8_t* data = malloc(data_length);
-			if (data == NULL) {
-				radio_throw_error(obj, radio_error_RAM_FULL);
-				return;
-			}
-
-			// copy data
-			uint8_t pos_first = pos[0].buffer_pos;
-			obj->buffer_rx[pos_first].valid = true;
-			obj->buffer_rx[pos_first].source = address;
-			obj->buffer_rx[pos_first].destination = obj->address;
-			uint16_t pointer_offset = 0;
-			for (int j = 0; j < parts_total; j++) {
-				memcpy(data + pointer_offset, obj->buffer_rx[pos[j].buffer_pos].data, obj->buffer_rx[pos[j].buffer_pos].data_length);
-				pointer_offset = pointer_offset + obj->buffer_rx[pos[j].buffer_pos].data_length;
-			}
-			obj->buffer_rx[pos_first].data_length = data_length;
-			obj->buffer_rx[pos_first].part =		0;
-			obj->buffer_rx[pos_first].parts_total = 1;
-
-			// free + delete old splitted messages
-			for (int j = 0; j < parts_total; j++) {
-				free(obj->buffer_rx[pos[j].buffer_pos].data);
-				obj->buffer_rx[pos[j].buffer_pos].valid = false;
-			}
-			obj->buffer_rx[pos_first].valid = true;
-			obj->buffer_rx[pos_first].data  = data;
-		}
-	}
-}
-
-uint8_t radio_buffer_tx_get(radio_t* obj, radio_message_t* msg) {
-	
-	// get next msg
-	uint8_t pos = 0; bool pos_found = false;
-	for (int i=0; i<RADIO_BUFFER_TX_SIZE; i++) {
-		if (obj->buffer_tx[i].valid == true) {
-			pos_found = true;
-			pos = i;
-			break;
-		}
-	}
-	if (!pos_found) {
-		msg->valid = false;
-		return 0;
-	}
-
-	// copy data and return
-	memcpy(msg, &obj->buffer_tx[pos], sizeof(radio_message_t));
-	obj->buffer_tx[pos].valid = false;
-	return pos;
-}
-
-void radio_buffer_rx_get(radio_t* obj, radio_message_t* msg) {
-	
-	// get next (not splitted) msg
-	uint8_t pos = 0; bool pos_found = false;
-	for (int i = 0; i < RADIO_BUFFER_RX_SIZE; i++) {
-		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total == 1) {
-			pos_found = true;
-			pos = i;
-			break;
-		}
-	}
-	if (!pos_found) {
-		msg->valid = false;
-		return;
-	}
-
-	// copy data and return
-	memcpy(msg, &obj->buffer_rx[pos], sizeof(radio_message_t));
-	obj->buffer_rx[pos].valid = false;
-	return;
-}
-
-void radio_buffer_sort(radio_t* obj, radio_buffer_t buffer) {
-
-	// set parameter
-	uint16_t         BUFFER_SIZE = 0;
-	radio_message_t* BUFFER = NULL;
-	switch (buffer) {
-		case radio_BUFFER_TX: BUFFER_SIZE = RADIO_BUFFER_TX_SIZE; BUFFER = obj->buffer_tx; break;
-		case radio_BUFFER_RX: BUFFER_SIZE = RADIO_BUFFER_RX_SIZE; BUFFER = obj->buffer_rx; break;
-		default: return; break;
-	}
-
-	// find next gap
-	for (int pos_gap = 0; pos_gap < BUFFER_SIZE; pos_gap++) {
-		if (BUFFER[pos_gap].valid == false) {
-
-			// find next valid item
-			for (int pos = pos_gap + 1; pos < BUFFER_SIZE; pos++) {
-				if (BUFFER[pos].valid == true) {
-
-					// move item to gap position
-					BUFFER[pos_gap] = BUFFER[pos];
-					BUFFER[pos].valid = false;
-					break;
-				}
-			}
-		}
-	}
-}
-
-void radio_throw_error(radio_t* obj, radio_error_code_t error) {
-	obj->error_cnt++;
-	if (obj->error_handler != NULL) {
-		obj->error_handler(error);
-	}
-}
-
-uint8_t radio_header_get_PART(radio_t* obj, radio_header_t* header) {
-	return header->part;
-}
-
-uint8_t radio_header_get_PARTS_TOTAL(radio_t* obj, radio_header_t* header) {
-	return header->parts_total;
-}
-
-uint8_t radio_header_get_CRC(radio_t* obj, radio_header_t* header) {
-	return header->crc8;
-}
-
-uint8_t radio_header_del_CRC(radio_t* obj, radio_header_t* header) {
-	header->crc8 = 0x00;
-	return 0;
-}
-
-uint8_t radio_header_cal_CRC(radio_t* obj, radio_message_t* msg) {
-
-	// create header + data
-	uint16_t len = RADIO_MSG_HEADER_SIZE + msg->data_length;
-	uint8_t* data = radio_generate_tx_data(obj, msg);
-	if (data == NULL) {
-		radio_throw_error(obj, radio_error_RAM_FULL);
-		return 0x00;
-	}
-
-	// crc
-	uint8_t crc = 0xff;
-	size_t i, j;
-	for (i = 0; i < len; i++) {
-		crc ^= data[i];
-		for (j = 0; j < 8; j++) {
-			if ((crc & 0x80) != 0)
-				crc = (uint8_t)((crc << 1) ^ 0x31);
-			else
-				crc <<= 1;
-		}
-	}
-	free(data);
-	return crc;
-}
-
-uint8_t radio_cal_CRC(radio_t* obj, uint8_t* data, uint16_t len) {
-	if (data == NULL) { return 0x00; }
-	uint8_t crc = 0xff;
-	size_t i, j;
-	for (i = 0; i < len; i++) {
-		crc ^= data[i];
-		for (j = 0; j < 8; j++) {
-			if ((crc & 0x80) != 0)
-				crc = (uint8_t)((crc << 1) ^ 0x31);
-			else
-				crc <<= 1;
-		}
-	}
-	return crc;
+/////////////////////////////////////////////////////
+// FILENAME:    radio.c                            //
+// DESCRIPTION: function handler for RFM69 modules //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <string.h>
+#include <stdlib.h>
+#include "radio.h"
+#include "radio_lz.h"
+
+typedef struct{
+	uint8_t part;
+	uint8_t parts_total;
+	uint8_t seq;         // per source sequence number for duplicate detection (0 = none)
+	uint8_t msg_id;      // per source message id, all parts of a splitted message share it
+	uint8_t flags;       // see RADIO_FLAG_x
+	uint8_t crc8;
+} radio_header_t;
+
+// header flags
+#define RADIO_FLAG_BULK   0x01  // bulk transfer frame, data starts with radio_bulk_header_t
+#define RADIO_FLAG_LZ     0x02  // message data is compressed (radio_lz), set on all parts
+#define RADIO_FLAG_SLEEPY 0x04  // uplink: node sleeps and listens for RADIO_LISTEN_WINDOW after this frame
+#define RADIO_FLAG_ACK_DATA 0x08 // uplink: node accepts a downlink frame in the ACK payload, data starts with [seq] (see radio_ack_data_rx())
+#define RADIO_FLAG_GROUP  0x10  // broadcast: data starts with the group (address & 0xF0)
+#define RADIO_FLAG_GROUP_ACK 0x20 // broadcast: members answer with a group ACK, unicast (without GROUP): group ACK [group][msg_id]
+#define RADIO_FLAG_RELAY  0x40  // data starts with the relay header, see radio_relay_rx()
+#define RADIO_FLAG_CONTROL 0x80 // data starts with the control type (RADIO_CONTROL_x), see radio_control_rx()
+
+// control frames: [type] + data
+#define RADIO_CONTROL_BEACON 0x01 // broadcast: beacon of the base station, see radio_beacon_send()
+#define RADIO_CONTROL_LINK   0x02 // link profile of the base station: [bitrate step][TX power (dBm)], see radio_link_rx()
+#define RADIO_CONTROL_FALLBACK 0x03 // node: fell back to the default link profile, see radio_link_fallback()
+
+// relay header (packed into the frame data): origin (1) + target (1) + hops (1) + path (hops, origin -> target)
+#define RADIO_RELAY_HEADER_SIZE(hops) (3 + (hops))
+#define RADIO_RELAY_CONFIRM  0x80 // hops byte: end-to-end confirmation of the target, data = [msg_id]
+#define RADIO_RELAY_FLAGS    (RADIO_FLAG_BULK | RADIO_FLAG_LZ | RADIO_FLAG_RELAY) // flags kept by a repeater
+
+// beacon (control frame data after the type, little endian): time of the base (4) + superframe length (2) + slot length (1)
+// + slots (1) + superframe counter (1) + slot map version (1) + page / pages (4 bit each), followed by slot map entries
+#define RADIO_BEACON_HEADER_SIZE 11
+#define RADIO_BEACON_ENTRY_SIZE  (uint8_t) sizeof(radio_beacon_slot_t)
+
+// bulk transfer frame header (little endian, packed into the frame data)
+#define RADIO_BULK_HEADER_SIZE 9 // transfer_id (1) + offset (4) + total length (4)
+
+typedef enum {
+	radio_BUFFER_TX,
+	radio_BUFFER_RX
+} radio_buffer_t;
+
+#define RADIO_MSG_HEADER_SIZE        (uint8_t) sizeof(radio_header_t)
+#define RADIO_MSG_MAX_DATA_SIZE(obj) (uint8_t)((obj)->frame_size - RADIO_MSG_HEADER_SIZE)
+#define RADIO_RFM_DELAY_BEFORE_ACK_TIME 5 // ms
+
+RADIO_STATIC_ASSERT(sizeof(radio_header_t) == RADIO_HEADER_SIZE, "RADIO_HEADER_SIZE does not match radio_header_t");
+RADIO_STATIC_ASSERT(RADIO_RFM_MIN_ACK_TIMEOUT <= RADIO_RFM_INIT_ACK_TIMEOUT && RADIO_RFM_INIT_ACK_TIMEOUT <= RADIO_RFM_MAX_ACK_TIMEOUT, "invalid ACK timeouts");
+RADIO_STATIC_ASSERT(RADIO_RFM_MIN_ACK_TIMEOUT > 0 && RADIO_RFM_MAX_ACK_TIMEOUT < 0x8000, "invalid ACK timeouts");
+RADIO_STATIC_ASSERT(RADIO_RFM_MIN_RETRIES > 0 && RADIO_RFM_MIN_RETRIES <= RADIO_RFM_MAX_RETRIES, "invalid number of retries");
+RADIO_STATIC_ASSERT(RADIO_NODE_TABLE_SIZE > 0 && RADIO_DEDUP_WINDOW > 0, "invalid node table");
+RADIO_STATIC_ASSERT(sizeof(radio_beacon_slot_t) == 3, "radio_beacon_slot_t is sent as is");
+RADIO_STATIC_ASSERT(RADIO_BEACON_PERIOD_MIN >= 2 * RADIO_BEACON_GUARD + RADIO_BEACON_CAP_MIN && RADIO_BEACON_PERIOD_MAX <= 0xFFFF, "invalid beacon period");
+RADIO_STATIC_ASSERT(RADIO_BEACON_SLOT > RADIO_BEACON_GUARD && RADIO_BEACON_SLOT <= 0xFF, "invalid beacon slot");
+RADIO_STATIC_ASSERT(RADIO_LINK_STEPS > 0 && RADIO_LINK_POWER_MIN <= RADIO_LINK_POWER_MAX && RADIO_LINK_POWER_MIN >= -128 && RADIO_LINK_POWER_MAX <= 127, "invalid link profiles");
+RADIO_STATIC_ASSERT(RADIO_LINK_SAMPLES > 0 && RADIO_LINK_FAILSAFE > 0, "invalid link adaptation");
+
+// transceiver functions: direct calls (see RADIO_RFM_STATIC) or function pointers
+#if RADIO_RFM_STATIC
+#define RADIO_RFM_TRANSMIT(obj, dest, data, len)  radio_rfm_transmit    (obj, dest, data, len)
+#define RADIO_RFM_RECEIVE(obj, src, data, len)    radio_rfm_receive     (obj, src, data, len)
+#define RADIO_RFM_SEND_ACK(obj, dest, data, len)  radio_rfm_sendACK     (obj, dest, data, len)
+#define RADIO_RFM_ACK_RECEIVED(obj, dest)         radio_rfm_ACKReceived (obj, dest)
+#define RADIO_RFM_ACK_REQUESTED(obj, src)         radio_rfm_ACKRequested(obj, src)
+#define RADIO_RFM_RECEIVE_DONE(obj)               radio_rfm_receiveDone (obj)
+#define RADIO_RFM_SET_LINK(obj, rate, power)      radio_rfm_setLink     (obj, rate, power)
+#else
+#define RADIO_RFM_TRANSMIT(obj, dest, data, len)  (obj)->rfm_transmit    (dest, data, len)
+#define RADIO_RFM_RECEIVE(obj, src, data, len)    (obj)->rfm_receive     (src, data, len)
+#define RADIO_RFM_SEND_ACK(obj, dest, data, len)  (obj)->rfm_sendACK     (dest, data, len)
+#define RADIO_RFM_ACK_RECEIVED(obj, dest)         (obj)->rfm_ACKReceived (dest)
+#define RADIO_RFM_ACK_REQUESTED(obj, src)         (obj)->rfm_ACKRequested(src)
+#define RADIO_RFM_RECEIVE_DONE(obj)               (obj)->rfm_receiveDone ()
+#define RADIO_RFM_SET_LINK(obj, rate, power)      ((obj)->rfm_setLink == NULL ? 1 : (obj)->rfm_setLink(rate, power))
+#endif
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void     radio_throw_error     (radio_t* obj, radio_error_code_t error);
+uint32_t radio_time            (radio_t* obj);
+uint32_t radio_random          (radio_t* obj);
+uint8_t  radio_cal_CRC         (radio_t* obj, uint8_t* data, uint16_t len);
+uint8_t  radio_generate_tx_data(radio_t* obj, radio_message_t* msg, uint8_t* frame);
+void     radio_tx_ack          (radio_t* obj);
+void     radio_tx_done         (radio_t* obj, radio_node_t* node, radio_message_t* msg);
+void     radio_tx_report       (radio_t* obj, uint8_t dest, uint16_t handle, radio_tx_status_t status);
+uint8_t  radio_ack_data        (radio_t* obj, uint8_t dest, uint8_t* data);
+uint8_t  radio_ack_data_rx     (radio_t* obj, radio_node_t* node, uint8_t* frame, bool duplicate);
+void     radio_ack_data_failed (radio_t* obj, radio_node_t* node);
+void     radio_tx_delivered    (radio_t* obj, uint8_t dest, uint16_t handle, uint8_t msg_id, uint32_t time);
+uint8_t  radio_max_data        (radio_t* obj, uint8_t dest);
+
+// buffer functions
+bool radio_buffer_rx_add             (radio_t* obj, uint8_t src,  uint8_t* data, uint8_t len, uint8_t frame);
+uint8_t radio_rx_frame_reserve       (radio_t* obj);
+void radio_rx_release                (radio_t* obj, radio_message_t* msg);
+bool radio_buffer_tx_add             (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle);
+bool radio_buffer_tx_add_split       (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle);
+void radio_buffer_tx_remove_msg      (radio_t* obj, uint8_t dest, uint8_t msg_id);
+uint8_t radio_buffer_tx_count_dest   (radio_t* obj, uint8_t dest);
+bool radio_decompress                (radio_t* obj, radio_message_t* msg);
+void radio_buffer_rx_merge_single_msg(radio_t* obj);
+uint8_t radio_buffer_tx_get          (radio_t* obj, radio_message_t* msg);
+void radio_buffer_rx_get             (radio_t* obj, radio_message_t* msg);
+void radio_buffer_sort               (radio_t* obj, radio_buffer_t buffer);
+uint8_t radio_buffer_count           (radio_t* obj, radio_buffer_t buffer);
+void radio_buffer_rx_remove_expired  (radio_t* obj);
+void radio_buffer_rx_remove_msg      (radio_t* obj, uint8_t src, uint8_t msg_id);
+
+// node table functions
+radio_node_t* radio_node_get         (radio_t* obj, uint8_t address);
+bool    radio_node_is_duplicate      (radio_t* obj, radio_node_t* node, uint8_t seq);
+uint8_t radio_node_next_seq          (radio_t* obj, radio_node_t* node);
+uint8_t radio_node_next_msg_id       (radio_t* obj, radio_node_t* node);
+void    radio_node_add_rtt           (radio_t* obj, radio_node_t* node, uint16_t rtt);
+void    radio_node_ack_timeout       (radio_t* obj, radio_node_t* node);
+uint8_t radio_node_max_retries       (radio_t* obj, radio_node_t* node);
+uint8_t radio_node_tx_state          (radio_t* obj, uint8_t address);
+void    radio_node_wakeup            (radio_t* obj, radio_node_t* node);
+bool    radio_mailbox_put            (radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle);
+void    radio_mailbox_clear          (radio_t* obj, radio_node_t* node);
+
+// coalescing functions
+bool     radio_coalesce              (radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len, uint16_t handle);
+uint8_t* radio_coalesce_data         (radio_t* obj, uint8_t* old, uint16_t old_len, uint8_t* data, uint16_t len, uint16_t* merged_len);
+uint8_t  radio_json_keys             (uint8_t* data, uint16_t len, uint16_t* pos, uint8_t* key_len);
+uint32_t radio_airtime               (uint16_t len);
+
+// group message functions
+void radio_group_loop                (radio_t* obj);
+void radio_group_repair              (radio_t* obj);
+void radio_group_sent                (radio_t* obj, radio_message_t* msg);
+void radio_group_ack_rx              (radio_t* obj, uint8_t src, uint8_t* data, uint16_t len);
+void radio_group_ack_send            (radio_t* obj, uint8_t dest, uint8_t group, uint8_t msg_id);
+void radio_group_unicast_done        (radio_t* obj, uint8_t dest, uint8_t msg_id, bool ok);
+void radio_group_finish              (radio_t* obj);
+
+// multi-hop functions
+uint8_t radio_relay_rx               (radio_t* obj, uint8_t* src, uint8_t* frame, uint8_t len);
+uint8_t radio_relay_header           (radio_t* obj, radio_node_t* node, uint8_t* data, bool confirm);
+uint8_t radio_relay_length           (radio_message_t* msg);
+bool radio_relay_queue               (radio_t* obj, radio_message_t* msg, uint8_t* data);
+void radio_relay_confirm             (radio_t* obj, uint8_t origin, uint8_t msg_id);
+void radio_relay_wait                (radio_t* obj, radio_message_t* msg);
+void radio_relay_confirmed           (radio_t* obj, uint8_t origin, uint8_t msg_id);
+void radio_relay_loop                (radio_t* obj);
+bool radio_relay_window              (radio_t* obj, radio_message_t* msg);
+
+// beacon mode functions
+bool radio_beacon_send               (radio_t* obj);
+void radio_beacon_map                (radio_t* obj);
+void radio_beacon_rx                 (radio_t* obj, uint8_t* data, uint16_t len);
+bool radio_beacon_tx                 (radio_t* obj);
+bool radio_beacon_active             (radio_beacon_slot_t* slot, uint8_t frame);
+void radio_node_report               (radio_t* obj, radio_node_t* node);
+radio_beacon_slot_t* radio_beacon_find(radio_t* obj, uint8_t address);
+uint8_t radio_beacon_owner           (radio_t* obj);
+
+// link adaptation functions
+void radio_control_rx                (radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len);
+void radio_link_rx                   (radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len);
+void radio_link_adapt                (radio_t* obj, radio_node_t* node);
+void radio_link_notice               (radio_t* obj, radio_node_t* node);
+void radio_link_notice_rx            (radio_t* obj, radio_node_t* node);
+void radio_link_send                 (radio_t* obj, radio_node_t* node, uint8_t rate, int8_t power);
+void radio_link_done                 (radio_t* obj, radio_node_t* node, radio_message_t* msg, bool ok);
+void radio_link_failed               (radio_t* obj, radio_node_t* node);
+void radio_link_fallback             (radio_t* obj, radio_node_t* node);
+bool radio_link_tx                   (radio_t* obj, radio_message_t* msg);
+void radio_link_listen               (radio_t* obj);
+bool radio_link_apply                (radio_t* obj, uint8_t rate, int8_t power);
+
+// bulk transfer functions
+void radio_bulk_tx_fill              (radio_t* obj);
+uint32_t radio_bulk_end              (radio_message_t* msg);
+bool radio_bulk_confirm_point        (uint32_t offset, uint32_t end, uint32_t total);
+void radio_bulk_tx_acked             (radio_t* obj, uint8_t dest, uint32_t offset);
+void radio_bulk_tx_failed            (radio_t* obj);
+void radio_bulk_tx_rewind            (radio_t* obj);
+void radio_bulk_tx_drop              (radio_t* obj);
+bool radio_bulk_rx                   (radio_t* obj, uint8_t src, uint8_t* data, uint16_t len);
+void     radio_write_u32             (uint8_t* data, uint32_t value);
+uint32_t radio_read_u32              (uint8_t* data);
+
+// header functions
+void    radio_generate_header       (radio_t* obj, radio_header_t* header, radio_message_t* msg);
+uint8_t radio_header_get_PART       (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_get_PARTS_TOTAL(radio_t* obj, radio_header_t* header);
+uint8_t radio_header_get_SEQ        (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_get_MSG_ID     (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_get_FLAGS      (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_get_CRC        (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_del_CRC        (radio_t* obj, radio_header_t* header);
+uint8_t radio_header_cal_CRC        (radio_t* obj, radio_message_t* msg);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void radio_init (radio_t* obj, uint8_t address, const radio_geometry_t* geometry) {
+	obj->address = address;
+	obj->buffer_rx = geometry->buffer_rx;
+	obj->buffer_tx = geometry->buffer_tx;
+	obj->rx_frames = geometry->rx_frames;
+	obj->rx_frame_map = geometry->rx_frame_map;
+	obj->buffer_rx_size = geometry->buffer_rx_size;
+	obj->buffer_tx_size = geometry->buffer_tx_size;
+	obj->frame_size = geometry->frame_size;
+	obj->error_cnt = 0;
+	obj->random = 0x9E3779B9 ^ address;
+	for (int i=0; i<obj->buffer_rx_size; i++) { obj->buffer_rx[i].valid = false; }
+	for (int i=0; i<RADIO_RX_FRAME_MAP_WORDS(obj->buffer_rx_size); i++) { obj->rx_frame_map[i] = 0; }
+	for (int i=0; i<obj->buffer_tx_size; i++) { obj->buffer_tx[i].valid = false; }
+	obj->buffer_rx_high_water = 0;
+	obj->buffer_tx_high_water = 0;
+	for (int i=0; i<RADIO_NODE_TABLE_SIZE; i++) { obj->nodes[i].valid = false; }
+#if !RADIO_RFM_STATIC
+	obj->rfm_transmit = NULL;
+	obj->rfm_receive = NULL;
+	obj->rfm_sendACK = NULL;
+	obj->rfm_ACKReceived = NULL;
+	obj->rfm_ACKRequested = NULL;
+	obj->rfm_receiveDone = NULL;
+	obj->rfm_setLink = NULL;
+#endif
+	obj->receive = NULL;
+	obj->delay = NULL;
+	obj->error_handler = NULL;
+	obj->millis = NULL;
+	obj->bulk_tx.state = radio_bulk_IDLE;
+	for (int i=0; i<RADIO_BULK_RX_CONTEXTS; i++) { obj->bulk_rx[i].valid = false; }
+	memset(&obj->group_tx, 0, sizeof(radio_group_tx_t));
+	memset(&obj->group_stats, 0, sizeof(radio_group_stats_t));
+	obj->msg_id_broadcast = 0;
+	obj->tx_throttled = false;
+	obj->tx_handle = 0;
+	for (int i=0; i<radio_tx_COUNT; i++) { obj->tx_status_cnt[i] = 0; }
+	obj->retry.ack_timeout_init = RADIO_RFM_INIT_ACK_TIMEOUT;
+	obj->retry.ack_timeout_min = RADIO_RFM_MIN_ACK_TIMEOUT;
+	obj->retry.ack_timeout_max = RADIO_RFM_MAX_ACK_TIMEOUT;
+	obj->retry.time_budget = RADIO_RFM_RETRY_TIME_BUDGET;
+	obj->retry.retries_min = RADIO_RFM_MIN_RETRIES;
+	obj->retry.retries_max = RADIO_RFM_MAX_RETRIES;
+	obj->retry.backoff_time = RADIO_RFM_BACKOFF_TIME;
+	obj->retry.backoff_max = RADIO_RFM_BACKOFF_MAX;
+	obj->orphans = 0;
+	obj->tx_wait = false;
+	obj->tx_time = 0;
+	obj->rx_seq = 0;
+	obj->relay = false;
+	for (int i=0; i<RADIO_RELAY_PENDING; i++) { obj->relay_wait[i].valid = false; }
+	obj->relay_forwarded = 0;
+	obj->relay_dropped = 0;
+	memset(&obj->beacon, 0, sizeof(radio_beacon_t));
+	obj->link_adapt = false;
+	obj->link_fallback = false;
+	obj->link_notice = false;
+	obj->link_rate = 0;
+	obj->link_power = RADIO_LINK_POWER_MAX;
+	obj->link_changes = 0;
+	obj->link_fallbacks = 0;
+	obj->tx_status = NULL;
+	obj->bulk_read = NULL;
+	obj->bulk_receive = NULL;
+	obj->bulk_done = NULL;
+}
+
+#if !RADIO_RFM_STATIC
+void radio_set_cb_rfm(radio_t* obj, void* transmit, void* receive, void* sendACK, void* ACKReceived, void* ACKRequested, void* receiveDone) {
+	if (transmit != NULL)		{ obj->rfm_transmit =		transmit; }
+	if (receive != NULL)		{ obj->rfm_receive =		receive; }
+	if (sendACK != NULL)		{ obj->rfm_sendACK =		sendACK; }
+	if (ACKReceived != NULL)    { obj->rfm_ACKReceived =    ACKReceived; }
+	if (ACKRequested != NULL)	{ obj->rfm_ACKRequested =	ACKRequested; }
+	if (receiveDone != NULL)	{ obj->rfm_receiveDone =	receiveDone; }
+}
+
+void radio_set_cb_rfm_link(radio_t* obj, void* setLink) {
+	if (setLink != NULL) { obj->rfm_setLink = setLink; }
+}
+#endif
+
+void radio_set_cb_func(radio_t* obj, void* receive, void* delay, void* error_handler, void* millis) {
+	if (receive != NULL)	   { obj->receive =       receive; }
+	if (delay != NULL)		   { obj->delay =         delay; }
+	if (error_handler != NULL) { obj->error_handler = error_handler; }
+	if (millis != NULL)        { obj->millis =        millis; }
+}
+
+void radio_set_cb_bulk(radio_t* obj, void* read, void* receive, void* done) {
+	if (read != NULL)    { obj->bulk_read =    read; }
+	if (receive != NULL) { obj->bulk_receive = receive; }
+	if (done != NULL)    { obj->bulk_done =    done; }
+}
+
+bool radio_set_retry_policy(radio_t* obj, const radio_retry_t* policy) {
+	if (policy == NULL) { return false; }
+	if (policy->ack_timeout_min == 0 || policy->ack_timeout_max >= 0x8000) { return false; }
+	if (policy->ack_timeout_min > policy->ack_timeout_init || policy->ack_timeout_init > policy->ack_timeout_max) { return false; }
+	if (policy->retries_min == 0 || policy->retries_min > policy->retries_max) { return false; }
+	obj->retry = *policy;
+	return true;
+}
+
+void radio_set_cb_tx_status(radio_t* obj, void* tx_status) {
+	if (tx_status != NULL) { obj->tx_status = tx_status; }
+}
+
+void radio_loop (radio_t* obj) {
+
+	// receiver bitrate: owner of the running beacon slot (base) or the default step (not while an ACK is expected)
+	if (!obj->tx_wait) { radio_link_listen(obj); }
+	
+	// RX: check for new data (not while an ACK is expected, the ACK check reads the transceiver)
+	if(!obj->tx_wait && RADIO_RFM_RECEIVE_DONE(obj)) {
+		
+		// receive directly into a free frame of the pool (RX buffer full: scratch frame, still ACKed + counted)
+		uint8_t scratch[RADIO_FRAME_SIZE_MAX];
+		uint8_t frame = radio_rx_frame_reserve(obj);
+		uint8_t* buffer = (frame == RADIO_RX_FRAME_NONE) ? scratch : &obj->rx_frames[frame * RADIO_FRAME_SIZE_MAX];
+		uint8_t source = 0x00;
+		uint8_t len = 0;
+		RADIO_RFM_RECEIVE(obj, &source, buffer, &len);
+		if (len > obj->frame_size) { len = obj->frame_size; }
+		
+		// add to RX buffer (the frame is kept, no copy)
+		bool valid = false;
+		if (len > RADIO_MSG_HEADER_SIZE)
+			valid = radio_buffer_rx_add(obj, source, buffer, len, frame);
+
+		// send ACK (with a pending downlink frame if the node supports it)
+		if (RADIO_RFM_ACK_REQUESTED(obj, source)) {
+			uint8_t ack[RADIO_FRAME_SIZE_MAX];
+			uint8_t ack_len = 0;
+			if (valid) { ack_len = radio_ack_data(obj, source, ack); }
+			if (RADIO_RFM_DELAY_BEFORE_ACK) {
+				obj->delay(RADIO_RFM_DELAY_BEFORE_ACK_TIME);
+			}
+			radio_node_t* node = radio_node_find(obj, source);
+			radio_link_apply(obj, obj->link_rate, (node == NULL) ? RADIO_LINK_POWER_MAX : node->link_power); // bitrate of the frame
+			RADIO_RFM_SEND_ACK(obj, source, ack, ack_len);
+		}
+	}
+	
+	// Process RX data
+	if (!radio_buffer_empty_rx(obj)) {
+		
+		// merge splitted messages
+		radio_buffer_rx_merge_single_msg(obj);
+		
+		// get next msg (a not splited one)
+		radio_message_t msg;
+		radio_buffer_rx_get(obj, &msg);
+		if (msg.valid == true && radio_decompress(obj, &msg)) {
+			
+			// relayed message complete: confirm it to the origin
+			if (msg.flags & RADIO_FLAG_RELAY) { radio_relay_confirm(obj, msg.source, msg.msg_id); }
+
+			// call external receive function
+			obj->rx_seq = msg.seq;
+			if (obj->receive != NULL)
+				obj->receive(msg.source, msg.data, msg.data_length);
+			radio_rx_release(obj, &msg);
+		}
+
+		// sort buffer
+		radio_buffer_sort(obj, radio_BUFFER_RX);
+	}
+	
+	// TX: queue next parts of a running bulk transfer, unicast repair of group messages
+	radio_bulk_tx_fill(obj);
+	radio_group_loop(obj);
+	radio_relay_loop(obj);
+
+	// TX: ACK of the frame in flight, beacon (beacon mode) or send next message from TX buffer
+	if (obj->tx_wait) {
+		radio_tx_ack(obj);
+	} else if (radio_beacon_send(obj)) {
+		// start of a superframe
+	} else if (!radio_buffer_empty_tx(obj)) {
+		
+		// get next msg (messages waiting for a retry are skipped)
+		radio_message_t msg;
+		uint8_t tx_buffer_pos = radio_buffer_tx_get(obj, &msg);
+		uint8_t data[RADIO_FRAME_SIZE_MAX];
+		if (msg.valid) { radio_generate_tx_data(obj, &msg, data); }
+
+		// send (link profile of the next hop, transceiver not switched yet: again in the next loop)
+		if (msg.valid && msg.data_length && !radio_link_tx(obj, &msg)) {
+			obj->buffer_tx[tx_buffer_pos].valid = true;
+		} else if (msg.valid && msg.data_length) {
+
+			// transmit
+			RADIO_RFM_TRANSMIT(obj, msg.via, data, (uint8_t)msg.data_length + RADIO_MSG_HEADER_SIZE);
+
+			// TEST ###############################################################################################################
+			//radio_buffer_rx_add(obj, msg.destination, data, (uint8_t)msg.data_length + RADIO_MSG_HEADER_SIZE);
+
+			// broadcast (group message): no ACK, confirmed by radio_group_*()
+			if (msg.destination == RADIO_BROADCAST) {
+				radio_group_sent(obj, &msg);
+				RADIO_FREE(msg.data);
+			} else {
+
+				// keep in the TX buffer until the ACK is received or the retries are used up
+				obj->buffer_tx[tx_buffer_pos].valid = true;
+				obj->buffer_tx[tx_buffer_pos].in_flight = true;
+				obj->tx_wait = true;
+				obj->tx_time = radio_time(obj);
+				radio_tx_ack(obj);
+			}
+		}
+
+		// sort buffer
+		radio_buffer_sort(obj, radio_BUFFER_TX);
+	}
+}
+
+bool radio_buffer_empty_tx(radio_t* obj) {
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool radio_buffer_empty_rx(radio_t* obj) {
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == true) {
+			return false;
+		}
+	}
+	return true;
+}
+
+radio_tx_status_t radio_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint16_t* handle) {
+	obj->tx_handle++;
+	if (obj->tx_handle == 0) { obj->tx_handle = 1; } // 0 = internal message
+	if (handle != NULL) { *handle = obj->tx_handle; }
+
+	// messages replaced or evicted by this one are reported first (after data is copied)
+	radio_tx_status_t status = radio_tx_REJECTED;
+	if (data != NULL && len != 0 && dest != RADIO_BROADCAST) {
+
+		// sleeping node: hold the command until the next uplink
+		radio_node_t* node = radio_node_get(obj, dest);
+		uint16_t fragments = radio_tx_fragments(obj, len);
+		uint8_t queued = radio_buffer_tx_count_dest(obj, dest);
+		if (node->sleepy && radio_node_tx_state(obj, dest) == 0) {
+			uint16_t merged_len = 0;
+			uint8_t* merged = NULL;
+			uint16_t old_handle = node->mailbox_handle;
+			bool old = node->mailbox != NULL;
+			if (RADIO_COALESCE && old) { merged = radio_coalesce_data(obj, node->mailbox, node->mailbox_length, data, len, &merged_len); }
+			if (merged != NULL) {
+				if (radio_mailbox_put(obj, node, merged, merged_len, 0x00, obj->tx_handle)) { status = radio_tx_HELD; }
+				RADIO_FREE(merged);
+			} else if (radio_mailbox_put(obj, node, data, len, 0x00, obj->tx_handle)) {
+				status = radio_tx_HELD;
+			}
+
+			// the old command is reported after data is copied into the mailbox (kept if there was no memory)
+			if (old && status == radio_tx_HELD) { radio_tx_report(obj, dest, old_handle, (merged_len > len) ? radio_tx_MERGED : radio_tx_REPLACED); }
+
+		// coalesced with a queued command
+		} else if (RADIO_COALESCE && radio_coalesce(obj, node, data, len, obj->tx_handle)) {
+			status = radio_tx_ACCEPTED;
+
+		// admission control (a message longer than the node limit is accepted if nothing else is queued for the node)
+		} else if (fragments > radio_tx_free(obj)) {
+			status = radio_tx_REJECTED_FULL;
+		} else if (queued && queued + fragments > RADIO_TX_NODE_LIMIT) {
+			status = radio_tx_REJECTED_LIMIT;
+		} else if (radio_buffer_tx_add(obj, dest, data, len, 0x00, obj->tx_handle)) {
+			status = radio_tx_ACCEPTED;
+		}
+	}
+	radio_tx_report(obj, dest, obj->tx_handle, status);
+	return status;
+}
+
+uint8_t radio_tx_free(radio_t* obj) {
+	uint16_t high = (uint16_t)obj->buffer_tx_size * RADIO_TX_HIGH_WATERMARK / 100;
+	uint16_t low = (uint16_t)obj->buffer_tx_size * RADIO_TX_LOW_WATERMARK / 100;
+	uint8_t used = radio_buffer_count(obj, radio_BUFFER_TX);
+	if (used >= high) { obj->tx_throttled = true; }
+	if (used <= low) { obj->tx_throttled = false; }
+	if (obj->tx_throttled) { return 0; }
+	return (uint8_t)(high - used);
+}
+
+uint16_t radio_tx_fragments(radio_t* obj, uint16_t len) {
+	if (len == 0) { return 0; }
+	return (uint16_t)(((len - 1) / RADIO_MSG_MAX_DATA_SIZE(obj)) + 1);
+}
+
+bool radio_bulk_send(radio_t* obj, uint8_t dest, uint8_t transfer_id, uint32_t total, uint32_t offset) {
+	if (obj->bulk_read == NULL || obj->bulk_tx.state == radio_bulk_RUNNING || offset >= total) { return false; }
+	obj->bulk_tx.state = radio_bulk_RUNNING;
+	obj->bulk_tx.destination = dest;
+	obj->bulk_tx.transfer_id = transfer_id;
+	obj->bulk_tx.total = total;
+	obj->bulk_tx.offset_queued = offset;
+	obj->bulk_tx.offset_acked = offset;
+	obj->bulk_tx.rewinds = 0;
+	return true;
+}
+
+bool radio_group_transmit(radio_t* obj, uint8_t group, uint8_t* data, uint16_t len, bool collect_acks) {
+	if (data == NULL || len == 0 || (group & 0x0F) || len + 1 > RADIO_MSG_MAX_DATA_SIZE(obj)) { return false; } // one frame (group byte in front)
+
+	// a running group message is not tracked any more (its repair is queued now)
+	if (obj->group_tx.state == radio_group_COLLECTING) { radio_group_repair(obj); }
+	if (obj->group_tx.state != radio_group_IDLE) { radio_group_finish(obj); }
+
+	// [group] + data
+	uint8_t* payload = RADIO_MALLOC(len + 1);
+	if (payload == NULL) {
+		radio_throw_error(obj, radio_error_RAM_FULL);
+		return false;
+	}
+	payload[0] = group;
+	memcpy(payload + 1, data, len);
+	bool added = radio_buffer_tx_add(obj, RADIO_BROADCAST, payload, len + 1, RADIO_FLAG_GROUP | (collect_acks ? RADIO_FLAG_GROUP_ACK : 0x00), 0);
+	RADIO_FREE(payload);
+	if (!added) { return false; }
+
+	// members: known nodes of the class
+	radio_group_tx_t* grp = &obj->group_tx;
+	grp->members = 0;
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		if (obj->nodes[i].valid && (obj->nodes[i].address & 0xF0) == group && obj->nodes[i].stats.packets_rx) {
+			grp->members |= (uint16_t)(1 << (obj->nodes[i].address & 0x0F));
+		}
+	}
+	grp->data = RADIO_MALLOC(len);
+	if (grp->data != NULL) { memcpy(grp->data, data, len); }
+	grp->data_length = len;
+	grp->state = radio_group_SENDING;
+	grp->group = group;
+	grp->msg_id = obj->msg_id_broadcast;
+	grp->collect_acks = collect_acks && grp->data != NULL;
+	grp->confirmed = 0;
+	grp->failed = 0;
+	grp->time_start = radio_time(obj);
+	obj->group_stats.messages++;
+	obj->group_stats.members = 0;
+	for (int i = 0; i < 16; i++) { if (grp->members & (1 << i)) { obj->group_stats.members++; } }
+	return true;
+}
+
+bool radio_bulk_resume(radio_t* obj) {
+	if (obj->bulk_tx.state != radio_bulk_PAUSED) { return false; }
+	obj->bulk_tx.state = radio_bulk_RUNNING;
+	obj->bulk_tx.offset_queued = obj->bulk_tx.offset_acked;
+	obj->bulk_tx.rewinds = 0;
+	return true;
+}
+
+uint16_t radio_sweep(radio_t* obj) {
+	uint16_t removed = 0;
+
+	// RX: incomplete splitted messages (also while nothing is received)
+	uint8_t used = radio_buffer_count(obj, radio_BUFFER_RX);
+	radio_buffer_rx_remove_expired(obj);
+	removed += used - radio_buffer_count(obj, radio_BUFFER_RX);
+
+	// RX frame pool: frames without a queued message
+	uint32_t map[RADIO_RX_FRAME_MAP_WORDS(obj->buffer_rx_size)];
+	memset(map, 0, sizeof(map));
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid && obj->buffer_rx[i].frame != RADIO_RX_FRAME_NONE) {
+			map[obj->buffer_rx[i].frame / 32] |= 1UL << (obj->buffer_rx[i].frame % 32);
+		}
+	}
+	for (int i = 0; i < RADIO_RX_FRAME_MAP_WORDS(obj->buffer_rx_size); i++) {
+		removed += __builtin_popcount(obj->rx_frame_map[i] & ~map[i]);
+		obj->rx_frame_map[i] = map[i];
+	}
+	if (obj->millis == NULL) {
+		obj->orphans += removed;
+		return removed;
+	}
+
+	// TX: node did not come back (asleep, listen window never opened)
+	uint32_t now = radio_time(obj);
+	used = radio_buffer_count(obj, radio_BUFFER_TX);
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid && !obj->buffer_tx[i].in_flight && now - obj->buffer_tx[i].time > RADIO_MAILBOX_TIMEOUT) {
+			radio_message_t msg = obj->buffer_tx[i];
+			obj->buffer_tx[i].valid = false;
+			RADIO_FREE(msg.data);
+			radio_tx_report(obj, msg.destination, msg.handle, radio_tx_FAILED);
+			if (msg.parts_total > 1) { radio_buffer_tx_remove_msg(obj, msg.destination, msg.msg_id); }
+			radio_group_unicast_done(obj, msg.destination, msg.msg_id, false);
+			if (msg.flags & RADIO_FLAG_BULK) { radio_bulk_tx_failed(obj); }
+			if (msg.flags & RADIO_FLAG_CONTROL) { radio_link_done(obj, radio_node_get(obj, msg.destination), &msg, false); }
+		}
+	}
+	removed += used - radio_buffer_count(obj, radio_BUFFER_TX);
+	radio_buffer_sort(obj, radio_BUFFER_TX);
+
+	// mailboxes (otherwise only checked on the next uplink)
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		radio_node_t* node = &obj->nodes[i];
+		if (node->valid && node->mailbox != NULL && now - node->mailbox_time > RADIO_MAILBOX_TIMEOUT) {
+			radio_tx_report(obj, node->address, node->mailbox_handle, radio_tx_FAILED);
+			radio_mailbox_clear(obj, node);
+			radio_throw_error(obj, radio_error_MAILBOX_EXPIRED);
+			removed++;
+		}
+	}
+	obj->orphans += removed;
+	return removed;
+}
+
+radio_node_t* radio_node_find(radio_t* obj, uint8_t address) {
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		if (obj->nodes[i].valid == true && obj->nodes[i].address == address) {
+			return &obj->nodes[i];
+		}
+	}
+	return NULL;
+}
+
+void radio_node_set_rssi(radio_t* obj, uint8_t address, int16_t rssi) {
+	radio_node_t* node = radio_node_get(obj, address);
+	node->stats.rssi = rssi;
+
+	// smoothed for the link adaptation (weight of the new sample 1/4)
+	if (node->link_rssi == 0) {
+		node->link_rssi = (int16_t)(rssi * 4);
+	} else {
+		node->link_rssi = (int16_t)(node->link_rssi - node->link_rssi / 4 + rssi);
+	}
+}
+
+void radio_set_relay(radio_t* obj, bool repeater) {
+	obj->relay = repeater;
+}
+
+bool radio_relay_set_path(radio_t* obj, uint8_t dest, const uint8_t* path, uint8_t hops) {
+	if (hops > RADIO_RELAY_MAX_HOPS || dest == RADIO_BROADCAST || (hops && path == NULL)) { return false; }
+	radio_node_t* node = radio_node_get(obj, dest);
+	node->relay_hops = hops;
+	for (int i = 0; i < hops; i++) { node->relay_path[i] = path[i]; }
+	return true;
+}
+
+void radio_beacon_enable(radio_t* obj, bool enable) {
+	memset(&obj->beacon, 0, sizeof(radio_beacon_t));
+	obj->beacon.enabled = enable;
+}
+
+void radio_link_enable(radio_t* obj, bool enable) {
+	obj->link_adapt = enable;
+}
+
+uint8_t radio_crc8(uint8_t crc, const uint8_t* data, uint16_t len) {
+	for (uint16_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (uint8_t j = 0; j < 8; j++) {
+			if ((crc & 0x80) != 0)
+				crc = (uint8_t)((crc << 1) ^ 0x31);
+			else
+				crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+void radio_generate_header(radio_t* obj, radio_header_t* header, radio_message_t* msg) {
+	header->seq =         msg->seq;
+	header->msg_id =      msg->msg_id;
+	header->flags =       msg->flags;
+	header->part =        msg->part;
+	header->parts_total = msg->parts_total;
+	header->crc8 =        0x00;
+}
+
+// header + data into frame (RADIO_FRAME_SIZE_MAX bytes, no allocation per transmission), returns the frame length
+uint8_t radio_generate_tx_data(radio_t* obj, radio_message_t* msg, uint8_t* data) {
+	radio_header_t header;
+	radio_generate_header(obj, &header, msg);
+	memcpy(data, &header, RADIO_MSG_HEADER_SIZE);						// add header
+	memcpy(data + RADIO_MSG_HEADER_SIZE, msg->data, msg->data_length);  // add data
+	((radio_header_t*)data)->crc8 = radio_cal_CRC(obj, data, RADIO_MSG_HEADER_SIZE + msg->data_length);
+	return (uint8_t)(RADIO_MSG_HEADER_SIZE + msg->data_length);
+}
+
+// ACK of the frame in flight: polled once per radio_loop() call, waits blocking (1 ms steps) without millis()
+// ACK received: done, timeout: retry after a random backoff or discard after the last retry
+void radio_tx_ack(radio_t* obj) {
+	int pos = -1;
+	for (int i = 0; i < obj->buffer_tx_size && pos < 0; i++) {
+		if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].in_flight) { pos = i; }
+	}
+	if (pos < 0) {
+		obj->tx_wait = false; // removed meanwhile (e.g. bulk transfer paused)
+		return;
+	}
+	radio_message_t msg = obj->buffer_tx[pos];
+	radio_node_t* node = radio_node_get(obj, msg.via); // next hop (RTT, retries)
+	bool ACKReceived = RADIO_RFM_ACK_RECEIVED(obj, msg.via);
+	uint32_t wait_time_ACK = radio_time(obj) - obj->tx_time;
+	if (obj->millis == NULL) {
+		for (wait_time_ACK = 0; !ACKReceived && wait_time_ACK <= node->ack_timeout; wait_time_ACK++) {
+			obj->delay(1);
+			ACKReceived = RADIO_RFM_ACK_RECEIVED(obj, msg.via);
+		}
+	}
+	if (!ACKReceived && wait_time_ACK <= node->ack_timeout) { return; }
+	obj->tx_wait = false;
+	obj->buffer_tx[pos].in_flight = false;
+
+	if (ACKReceived) {
+		obj->buffer_tx[pos].valid = false;
+		node->link_failures = 0;
+		if (node->sleepy && (int32_t)(node->listen_until - obj->tx_time) <= 0) { node->sleepy = false; } // ACK outside the listen window: awake
+		if (msg.retries == 0) { radio_node_add_rtt(obj, node, (uint16_t)wait_time_ACK); } // Karn: no samples of retransmissions
+		radio_tx_done(obj, node, &msg);
+	} else {
+		radio_node_ack_timeout(obj, node);
+		obj->buffer_tx[pos].retries++;
+		if (obj->buffer_tx[pos].retries >= radio_node_max_retries(obj, node)) {
+			obj->buffer_tx[pos].valid = false; // remove from TX buffer
+			node->stats.ack_timeouts++;
+			radio_link_done(obj, node, &msg, false);
+			radio_link_failed(obj, node);
+			RADIO_FREE(msg.data);
+			radio_throw_error(obj, radio_error_RFM_ACK_TIMEOUT);
+			radio_tx_report(obj, msg.destination, msg.handle, radio_tx_FAILED);
+			if (msg.parts_total > 1) { radio_buffer_tx_remove_msg(obj, msg.destination, msg.msg_id); } // node cannot merge it any more
+			radio_group_unicast_done(obj, msg.destination, msg.msg_id, false);
+			if (msg.flags & RADIO_FLAG_BULK) { radio_bulk_tx_failed(obj); }
+		} else {
+			node->stats.retries++;
+
+			// random backoff, avoids a collision with the same sender again
+			uint32_t backoff = (uint32_t)obj->retry.backoff_time << obj->buffer_tx[pos].retries;
+			if (backoff > obj->retry.backoff_max) { backoff = obj->retry.backoff_max; }
+			obj->buffer_tx[pos].time_retry = radio_time(obj) + (radio_random(obj) % (backoff + 1));
+		}
+	}
+	radio_buffer_sort(obj, radio_BUFFER_TX);
+}
+
+// message ACKed (by the next hop): statistics, free data
+// own relayed messages are delivered when the target confirms them (bulk frames: the confirmation points)
+void radio_tx_done(radio_t* obj, radio_node_t* node, radio_message_t* msg) {
+	node->stats.packets_tx++;
+	if (msg->part + 1 == msg->parts_total) {
+		if ((msg->flags & RADIO_FLAG_RELAY) && !(msg->data[2] & RADIO_RELAY_CONFIRM) && msg->source == obj->address) {
+			uint8_t* bulk = msg->data + radio_relay_length(msg);
+			if (!(msg->flags & RADIO_FLAG_BULK) || radio_bulk_confirm_point(radio_read_u32(bulk + 1), radio_bulk_end(msg), radio_read_u32(bulk + 5))) {
+				radio_relay_wait(obj, msg);
+			}
+		} else {
+			radio_tx_delivered(obj, msg->destination, msg->handle, msg->msg_id, msg->time);
+			if (msg->flags & RADIO_FLAG_BULK) { radio_bulk_tx_acked(obj, msg->destination, radio_bulk_end(msg)); }
+		}
+	}
+	radio_link_done(obj, node, msg, true);
+	RADIO_FREE(msg->data);
+}
+
+// last part of a message delivered: status, group repair, latency
+void radio_tx_delivered(radio_t* obj, uint8_t dest, uint16_t handle, uint8_t msg_id, uint32_t time) {
+	radio_node_t* node = radio_node_get(obj, dest);
+	radio_tx_report(obj, dest, handle, radio_tx_DELIVERED);
+	radio_group_unicast_done(obj, dest, msg_id, true);
+	uint32_t latency = radio_time(obj) - time;
+	node->stats.latency = (latency > 0xFFFF ? 0xFFFF : (uint16_t)latency);
+	if (node->stats.latency > node->stats.latency_max) { node->stats.latency_max = node->stats.latency; }
+}
+
+// max data per frame to dest (without the relay header)
+uint8_t radio_max_data(radio_t* obj, uint8_t dest) {
+	radio_node_t* node = (dest == RADIO_BROADCAST) ? NULL : radio_node_find(obj, dest);
+	if (node == NULL || node->relay_hops == 0) { return RADIO_MSG_MAX_DATA_SIZE(obj); }
+	return (uint8_t)(RADIO_MSG_MAX_DATA_SIZE(obj) - RADIO_RELAY_HEADER_SIZE(node->relay_hops));
+}
+
+// count the status and call tx_status() (not for internal messages)
+void radio_tx_report(radio_t* obj, uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	if (handle == 0) { return; }
+	obj->tx_status_cnt[status]++;
+	if (obj->tx_status != NULL) { obj->tx_status(dest, handle, status); }
+}
+
+// generate the ACK payload: next single frame message to dest (0 = empty ACK), not sent before
+// it stays in the TX buffer until the node confirms it, a retransmitted uplink gets it again
+uint8_t radio_ack_data(radio_t* obj, uint8_t dest, uint8_t* data) {
+	radio_node_t* node = radio_node_find(obj, dest);
+	if (node == NULL || !node->ack_data) { return 0; }
+	if (node->ack_data_pending && node->ack_data_uplink != node->seq_rx_last) { return 0; }
+
+	// first message to dest (messages to one destination are sent in buffer order)
+	int pos = -1;
+	for (int i = 0; i < obj->buffer_tx_size && pos < 0; i++) {
+		if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].destination == dest) { pos = i; }
+	}
+	if (pos < 0) { return 0; }
+	radio_message_t* msg = &obj->buffer_tx[pos];
+	if (msg->parts_total != 1 || msg->retries != 0 || (msg->flags & (RADIO_FLAG_BULK | RADIO_FLAG_RELAY | RADIO_FLAG_CONTROL))) { return 0; }
+	if (node->ack_data_pending && msg->seq != node->ack_data_seq) { return 0; }
+
+	uint8_t len = radio_generate_tx_data(obj, msg, data);
+	if (!node->ack_data_pending) {
+		node->ack_data_pending = true;
+		node->ack_data_seq = msg->seq;
+		node->ack_data_uplink = node->seq_rx_last;
+		node->ack_data_time = radio_time(obj);
+		node->stats.ack_data++;
+	}
+	return len;
+}
+
+// uplink received (direct, not a control frame): learn ACK payload support, returns the data bytes to skip
+// uplinks with RADIO_FLAG_ACK_DATA start with the sequence number of the last downlink frame the node took from an
+// ACK (0 = none): confirms the pending frame, a new uplink without it: the frame is sent again as a normal frame
+uint8_t radio_ack_data_rx(radio_t* obj, radio_node_t* node, uint8_t* frame, bool duplicate) {
+	uint8_t flags = radio_header_get_FLAGS(obj, (radio_header_t*)frame);
+	if (flags & (RADIO_FLAG_RELAY | RADIO_FLAG_CONTROL)) { return 0; }
+	node->ack_data = (flags & RADIO_FLAG_ACK_DATA) != 0 && node->seq_rx_last != 0; // needs sequence numbers
+	if (!(flags & RADIO_FLAG_ACK_DATA)) { return 0; }
+	if (!node->ack_data_pending) { return 1; }
+
+	if (frame[RADIO_MSG_HEADER_SIZE] == node->ack_data_seq) {
+		node->ack_data_pending = false;
+		for (int i = 0; i < obj->buffer_tx_size; i++) {
+			if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].destination == node->address && obj->buffer_tx[i].seq == node->ack_data_seq) {
+				obj->buffer_tx[i].valid = false;
+				radio_tx_done(obj, node, &obj->buffer_tx[i]);
+				break;
+			}
+		}
+	} else if (!duplicate && node->seq_rx_last != node->ack_data_uplink) {
+		radio_ack_data_failed(obj, node);
+	}
+	return 1;
+}
+
+// downlink frame of the last ACK not confirmed: counted as one transmission, sent as a normal frame
+void radio_ack_data_failed(radio_t* obj, radio_node_t* node) {
+	node->ack_data_pending = false;
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].destination == node->address && obj->buffer_tx[i].seq == node->ack_data_seq) {
+			obj->buffer_tx[i].retries++;
+			break;
+		}
+	}
+}
+
+// true = valid frame (CRC ok, also duplicates), false = ignored
+// a queued frame keeps its pool frame (data points behind the header), frame = RADIO_RX_FRAME_NONE: not queued
+bool radio_buffer_rx_add (radio_t* obj, uint8_t src, uint8_t* data, uint8_t len, uint8_t frame) {
+	if (data == NULL || len == 0) { return false; }
+
+	// check CRC
+	uint8_t crc_received = radio_header_get_CRC(obj, (radio_header_t*)data);
+	radio_header_del_CRC(obj, (radio_header_t*)data);
+	uint8_t crc_calulated = radio_cal_CRC(obj, data, len);
+	radio_node_t* node = radio_node_get(obj, src);
+	if (crc_received != crc_calulated) {
+		node->time_last_seen = radio_time(obj);
+		node->stats.crc_errors++;
+		radio_throw_error(obj, radio_error_RX_CRC_WRONG);
+		return false;
+	}
+
+	// drop retransmissions (our ACK was lost), the ACK is sent again by radio_loop()
+	bool duplicate = radio_node_is_duplicate(obj, node, radio_header_get_SEQ(obj, (radio_header_t*)data));
+	node->time_last_seen = radio_time(obj);
+	node->seq_rx_last = radio_header_get_SEQ(obj, (radio_header_t*)data);
+	uint8_t ack_data_len = (len > RADIO_MSG_HEADER_SIZE) ? radio_ack_data_rx(obj, node, data, duplicate) : 0;
+
+	// node is awake: open the listen window, held commands are sent after the ACK
+	if (radio_header_get_FLAGS(obj, (radio_header_t*)data) & RADIO_FLAG_SLEEPY) { node->sleepy = true; }
+	if (node->sleepy) {
+		radio_node_wakeup(obj, node);
+		node->sleepy = (radio_header_get_FLAGS(obj, (radio_header_t*)data) & RADIO_FLAG_SLEEPY) != 0;
+	}
+	if (duplicate) {
+		node->stats.duplicates++;
+		return true;
+	}
+
+	// control frame: beacon (beacon mode) or link profile (link adaptation), not counted as traffic of the sender
+	// (a peer we received frames from is taken for sleeping after an ACK timeout, see radio_tx_ack())
+	if (radio_header_get_FLAGS(obj, (radio_header_t*)data) & RADIO_FLAG_CONTROL) {
+		radio_control_rx(obj, node, data + RADIO_MSG_HEADER_SIZE, len - RADIO_MSG_HEADER_SIZE);
+		return true;
+	}
+	node->stats.packets_rx++;
+
+	// relayed frame: forwarded (repeater) or passed on with the origin as source, otherwise the node is heard directly
+	uint8_t offset = RADIO_MSG_HEADER_SIZE + ack_data_len;
+	if (radio_header_get_FLAGS(obj, (radio_header_t*)data) & RADIO_FLAG_RELAY) {
+		uint8_t relay_len = radio_relay_rx(obj, &src, data, len);
+		if (relay_len == 0) { return true; }
+		offset += relay_len;
+	} else {
+		node->relay_hops = 0;
+		if (radio_header_get_PART(obj, (radio_header_t*)data) == 0) {
+			radio_node_report(obj, node);
+			radio_link_adapt(obj, node);
+		}
+	}
+
+	// group message (broadcast): members take the data behind the group, answer with a group ACK if requested
+	// group ACK: unicast frame with GROUP_ACK only
+	uint8_t flags = radio_header_get_FLAGS(obj, (radio_header_t*)data);
+	if (flags & RADIO_FLAG_GROUP) {
+		if (len - offset < 2 || data[offset] != (obj->address & 0xF0)) { return true; } // other group
+		if (flags & RADIO_FLAG_GROUP_ACK) { radio_group_ack_send(obj, src, data[offset], radio_header_get_MSG_ID(obj, (radio_header_t*)data)); }
+		offset++;
+	} else if (flags & RADIO_FLAG_GROUP_ACK) {
+		radio_group_ack_rx(obj, src, data + offset, len - offset);
+		return true;
+	}
+
+	// bulk transfer frames are passed to the sink directly, relayed ones in order are confirmed to the origin
+	if (flags & RADIO_FLAG_BULK) {
+		if (radio_bulk_rx(obj, src, data + offset, len - offset) && (flags & RADIO_FLAG_RELAY)) {
+			radio_relay_confirm(obj, src, radio_header_get_MSG_ID(obj, (radio_header_t*)data));
+		}
+		return true;
+	}
+
+	// get next free buffer slot
+	uint8_t pos = 0; bool pos_found = false;
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == false) {
+			pos_found = true;
+			pos = i;
+			break;
+		}
+	}
+	if (!pos_found || frame == RADIO_RX_FRAME_NONE) {
+		radio_throw_error(obj, radio_error_RX_BUFFER_FULL);
+		return true;
+	}
+
+	// take over the frame
+	obj->rx_frame_map[frame / 32] |=	1UL << (frame % 32);
+	obj->buffer_rx[pos].frame =			frame;
+	obj->buffer_rx[pos].data =			data + offset;
+	obj->buffer_rx[pos].valid =			true;
+	obj->buffer_rx[pos].source =		src;
+	obj->buffer_rx[pos].destination =	obj->address;
+	obj->buffer_rx[pos].data_length =	len - offset;
+	obj->buffer_rx[pos].part =			radio_header_get_PART       (obj, (radio_header_t*)data);
+	obj->buffer_rx[pos].parts_total =	radio_header_get_PARTS_TOTAL(obj, (radio_header_t*)data);
+	obj->buffer_rx[pos].retries =       0;
+	obj->buffer_rx[pos].seq =           radio_header_get_SEQ        (obj, (radio_header_t*)data);
+	obj->buffer_rx[pos].msg_id =        radio_header_get_MSG_ID     (obj, (radio_header_t*)data);
+	obj->buffer_rx[pos].flags =         radio_header_get_FLAGS      (obj, (radio_header_t*)data);
+	obj->buffer_rx[pos].time =          radio_time(obj);
+
+	// statistics
+	uint8_t used = radio_buffer_count(obj, radio_BUFFER_RX);
+	if (used > obj->buffer_rx_high_water) { obj->buffer_rx_high_water = used; }
+	return true;
+}
+
+// true = message added to the TX buffer
+bool radio_buffer_tx_add (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle) {
+	if (data == NULL || len == 0) { return false; }
+
+	// compress splitted messages, use the compressed data only if it saves at least one fragment
+	uint8_t MSG_MAX_DATA_SIZE = radio_max_data(obj, dest);
+	if (RADIO_COMPRESSION && !(flags & RADIO_FLAG_BULK) && len > MSG_MAX_DATA_SIZE && len <= RADIO_LZ_MAX_INPUT) {
+		uint16_t single_packets = ((len - 1) / MSG_MAX_DATA_SIZE) + 1;
+		uint16_t len_max = (uint16_t)((single_packets - 1) * MSG_MAX_DATA_SIZE);
+		uint8_t* data_lz = RADIO_MALLOC(len_max);
+		if (data_lz != NULL) {
+			uint16_t len_lz = radio_lz_compress(data, len, data_lz, len_max);
+			if (len_lz) {
+				bool added = radio_buffer_tx_add_split(obj, dest, data_lz, len_lz, flags | RADIO_FLAG_LZ, handle);
+				if (added) {
+					radio_node_t* node = radio_node_find(obj, dest);
+					if (node != NULL) {
+						node->stats.lz_messages++;
+						node->stats.lz_fragments_saved += single_packets - (((len_lz - 1) / MSG_MAX_DATA_SIZE) + 1);
+					}
+				}
+				RADIO_FREE(data_lz);
+				return added;
+			}
+			RADIO_FREE(data_lz);
+		}
+	}
+	return radio_buffer_tx_add_split(obj, dest, data, len, flags, handle);
+}
+
+bool radio_buffer_tx_add_split (radio_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle) {
+
+	// get positions of all free buffer slots
+	uint8_t pos[obj->buffer_tx_size]; uint8_t pos_count = 0;
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == false) {
+			pos[pos_count] = i;
+			pos_count++;
+		}
+	}
+
+	// calculate number of single packets
+	uint8_t MSG_MAX_DATA_SIZE = radio_max_data(obj, dest);
+	uint16_t single_packets = ((len - 1) / MSG_MAX_DATA_SIZE) + 1;
+	if (single_packets > 0xFF) {
+		radio_throw_error(obj, radio_error_MSG_TOO_LONG); // use radio_bulk_send()
+		return false;
+	}
+	if (single_packets > pos_count) {
+		radio_throw_error(obj, radio_error_TX_BUFFER_FULL);
+		return false;
+	}
+
+	// broadcast: own message id, no sequence number (every node counts sequence numbers of its own)
+	// relayed: message id of the target, sequence number of the first repeater, every part starts with the relay header
+	radio_node_t* node = NULL;
+	radio_node_t* hop = NULL;
+	uint8_t msg_id = 0;
+	uint8_t relay[RADIO_RELAY_HEADER_SIZE(RADIO_RELAY_MAX_HOPS)];
+	uint8_t relay_len = 0;
+	if (dest == RADIO_BROADCAST) {
+		msg_id = ++obj->msg_id_broadcast;
+	} else {
+		node = radio_node_get(obj, dest);
+		msg_id = radio_node_next_msg_id(obj, node);
+		hop = node;
+		if (node->relay_hops) {
+			relay_len = radio_relay_header(obj, node, relay, false);
+			flags |= RADIO_FLAG_RELAY;
+			hop = radio_node_get(obj, node->relay_path[0]);
+		}
+	}
+	for (int i = 0; i < single_packets; i++) {
+
+		// calculate parameters
+		uint8_t data_length = 0;
+		if (i + 1 == single_packets) {
+			data_length = len % MSG_MAX_DATA_SIZE;
+			if (!data_length) { data_length = MSG_MAX_DATA_SIZE; }
+		} else {
+			data_length = MSG_MAX_DATA_SIZE;
+		}
+		uint16_t pointer_offset = (uint16_t)(i * MSG_MAX_DATA_SIZE);
+
+		// allocate bytes for message (no memory: remove the parts added so far)
+		obj->buffer_tx[pos[i]].data = RADIO_MALLOC(relay_len + data_length);
+		if (obj->buffer_tx[pos[i]].data == NULL) {
+			for (int j = 0; j < i; j++) {
+				RADIO_FREE(obj->buffer_tx[pos[j]].data);
+				obj->buffer_tx[pos[j]].valid = false;
+			}
+			radio_throw_error(obj, radio_error_RAM_FULL);
+			return false;
+		}
+
+		// copy data
+		obj->buffer_tx[pos[i]].valid = true;
+		obj->buffer_tx[pos[i]].source = obj->address;
+		obj->buffer_tx[pos[i]].destination = dest;
+		obj->buffer_tx[pos[i]].via = (hop != NULL ? hop->address : dest);
+		obj->buffer_tx[pos[i]].data_length = relay_len + data_length;
+		memcpy(obj->buffer_tx[pos[i]].data, relay, relay_len);
+		memcpy(obj->buffer_tx[pos[i]].data + relay_len, data + pointer_offset, data_length);
+		obj->buffer_tx[pos[i]].part = i;
+		obj->buffer_tx[pos[i]].parts_total = single_packets;
+		obj->buffer_tx[pos[i]].retries = 0;
+		obj->buffer_tx[pos[i]].seq = (hop != NULL ? radio_node_next_seq(obj, hop) : 0);
+		obj->buffer_tx[pos[i]].msg_id = msg_id;
+		obj->buffer_tx[pos[i]].flags = flags;
+		obj->buffer_tx[pos[i]].time = radio_time(obj);
+		obj->buffer_tx[pos[i]].time_retry = obj->buffer_tx[pos[i]].time;
+		obj->buffer_tx[pos[i]].handle = handle;
+		obj->buffer_tx[pos[i]].in_flight = false;
+	}
+
+	// statistics
+	uint8_t used = radio_buffer_count(obj, radio_BUFFER_TX);
+	if (used > obj->buffer_tx_high_water) { obj->buffer_tx_high_water = used; }
+	return true;
+}
+
+// coalesce with the last queued command to the node if it was not sent yet (not retried, not in an ACK)
+bool radio_coalesce(radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len, uint16_t handle) {
+	if (len > RADIO_MSG_MAX_DATA_SIZE(obj)) { return false; }
+
+	// last queued message to the node (sequence numbers count frames)
+	radio_message_t* msg = NULL;
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		radio_message_t* m = &obj->buffer_tx[i];
+		if (m->valid == true && m->destination == node->address && (msg == NULL || (int8_t)(m->seq - msg->seq) > 0)) { msg = m; }
+	}
+	if (msg == NULL || msg->handle == 0 || msg->flags != 0x00 || msg->parts_total != 1 || msg->retries != 0 || msg->in_flight) { return false; }
+	if (node->ack_data_pending && msg->seq == node->ack_data_seq) { return false; }
+
+	uint16_t merged_len = 0;
+	uint8_t* merged = radio_coalesce_data(obj, msg->data, msg->data_length, data, len, &merged_len);
+	if (merged == NULL) { return false; }
+
+	// statistics: frames + ACKs before and after
+	uint32_t airtime_before = radio_airtime(RADIO_HEADER_SIZE + msg->data_length) + radio_airtime(RADIO_HEADER_SIZE + len) + 2 * radio_airtime(0);
+	uint32_t airtime_after = radio_airtime(RADIO_HEADER_SIZE + merged_len) + radio_airtime(0);
+	node->stats.airtime_saved += airtime_before - airtime_after;
+	node->stats.coalesced++;
+
+	radio_tx_report(obj, node->address, msg->handle, (merged_len > len) ? radio_tx_MERGED : radio_tx_REPLACED);
+	RADIO_FREE(msg->data);
+	msg->data = merged;
+	msg->data_length = merged_len;
+	msg->handle = handle;
+	return true;
+}
+
+// flat JSON objects: same keys = copy of data (set-point, latest wins), no common key = both objects in one,
+// fits into one frame, NULL = not coalescable
+uint8_t* radio_coalesce_data(radio_t* obj, uint8_t* old, uint16_t old_len, uint8_t* data, uint16_t len, uint16_t* merged_len) {
+	uint16_t old_pos[RADIO_COALESCE_MAX_KEYS], pos[RADIO_COALESCE_MAX_KEYS];
+	uint8_t  old_key_len[RADIO_COALESCE_MAX_KEYS], key_len[RADIO_COALESCE_MAX_KEYS];
+	uint8_t old_keys = radio_json_keys(old, old_len, old_pos, old_key_len);
+	uint8_t keys = radio_json_keys(data, len, pos, key_len);
+	if (old_keys == 0 || keys == 0) { return NULL; }
+
+	// common keys
+	uint8_t common = 0;
+	for (int i = 0; i < keys; i++) {
+		for (int j = 0; j < old_keys; j++) {
+			if (key_len[i] == old_key_len[j] && memcmp(data + pos[i], old + old_pos[j], key_len[i]) == 0) {
+				common++;
+				break;
+			}
+		}
+	}
+
+	uint8_t* merged = NULL;
+	if (common == keys && keys == old_keys) {
+		merged = RADIO_MALLOC(len);
+		if (merged == NULL) { return NULL; }
+		memcpy(merged, data, len);
+		*merged_len = len;
+	} else if (common == 0 && old_len + len - 1 <= RADIO_MSG_MAX_DATA_SIZE(obj)) {
+		*merged_len = old_len + len - 1;
+		merged = RADIO_MALLOC(*merged_len);
+		if (merged == NULL) { return NULL; }
+		memcpy(merged, old, old_len - 1);            // without '}'
+		merged[old_len - 1] = ',';
+		memcpy(merged + old_len, data + 1, len - 1); // without '{'
+	}
+	return merged;
+}
+
+// keys of a flat JSON object (no nested objects / arrays), returns the number of keys (0 = no flat object)
+uint8_t radio_json_keys(uint8_t* data, uint16_t len, uint16_t* pos, uint8_t* key_len) {
+	if (len < 2 || data[0] != '{' || data[len - 1] != '}') { return 0; }
+	uint16_t end = len - 1;
+	uint8_t keys = 0;
+	uint16_t i = 1;
+	while (i < end) {
+
+		// key
+		while (i < end && data[i] == ' ') { i++; }
+		if (i >= end || data[i] != '"' || keys == RADIO_COALESCE_MAX_KEYS) { return 0; }
+		uint16_t start = ++i;
+		while (i < end && data[i] != '"') { i += (data[i] == '\\') ? 2 : 1; }
+		if (i >= end || i - start > 0xFF) { return 0; }
+		pos[keys] = start;
+		key_len[keys] = (uint8_t)(i - start);
+		keys++;
+		i++;
+		while (i < end && data[i] == ' ') { i++; }
+		if (i >= end || data[i] != ':') { return 0; }
+		i++;
+
+		// value up to the next ',' outside of strings
+		bool string = false;
+		while (i < end && (string || data[i] != ',')) {
+			if (string && data[i] == '\\') {
+				i++;
+			} else if (data[i] == '"') {
+				string = !string;
+			} else if (!string && (data[i] == '{' || data[i] == '[')) {
+				return 0;
+			}
+			i++;
+		}
+		if (string) { return 0; }
+		i++;
+	}
+	return keys;
+}
+
+// estimated airtime of a frame with len bytes (0 = ACK without payload), us
+uint32_t radio_airtime(uint16_t len) {
+	return (uint32_t)(RADIO_AIR_OVERHEAD + len) * 8 * 1000000UL / RADIO_BITRATE;
+}
+
+// remove all parts of a message from the TX buffer
+void radio_buffer_tx_remove_msg(radio_t* obj, uint8_t dest, uint8_t msg_id) {
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].destination == dest && obj->buffer_tx[i].msg_id == msg_id) {
+			RADIO_FREE(obj->buffer_tx[i].data);
+			obj->buffer_tx[i].valid = false;
+		}
+	}
+}
+
+uint8_t radio_buffer_tx_count_dest(radio_t* obj, uint8_t dest) {
+	uint8_t count = 0;
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true && obj->buffer_tx[i].destination == dest) { count++; }
+	}
+	return count;
+}
+
+void radio_buffer_rx_merge_single_msg(radio_t* obj) {
+
+	typedef struct {
+		bool valid;
+		uint8_t buffer_pos;
+	} positions_t;
+
+	// discard splitted messages that were not completed in time
+	radio_buffer_rx_remove_expired(obj);
+
+	// check for splitted messages (identified by source + msg_id)
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total > 1) {
+			uint8_t address = obj->buffer_rx[i].source;
+			uint8_t msg_id = obj->buffer_rx[i].msg_id;
+			uint8_t parts_total = obj->buffer_rx[i].parts_total;
+
+			// check if splitted message is complete + get positions
+			uint8_t msg_cnt = 0;
+			positions_t pos[obj->buffer_rx_size];
+			for (int j = 0; j < obj->buffer_rx_size; j++) { pos[j].valid = false; }
+			for (int j = 0; j < obj->buffer_rx_size; j++) {
+				if (obj->buffer_rx[j].valid == true && obj->buffer_rx[j].parts_total == parts_total && obj->buffer_rx[j].source == address && obj->buffer_rx[j].msg_id == msg_id) {
+					pos[obj->buffer_rx[j].part % obj->buffer_rx_size].valid = true;
+					pos[obj->buffer_rx[j].part % obj->buffer_rx_size].buffer_pos = j;
+					msg_cnt++;
+				}
+			}
+			if (msg_cnt != parts_total) { continue; } // parts are missing
+			bool complete = true;
+			for (int j = 0; j < parts_total; j++) {
+				if (pos[j].valid == false) { complete = false; } // parts are missing (e.g. in case of the same part number twice)
+			}
+			if (!complete) { continue; }
+
+			// allocate bytes for full message
+			uint16_t data_length = 0;
+			for (int j = 0; j < parts_total; j++) {
+				data_length = data_length + obj->buffer_rx[pos[j].buffer_pos].data_length;
+			}
+			uint8_t* data = RADIO_MALLOC(data_length);
+			if (data == NULL) {
+				radio_throw_error(obj, radio_error_RAM_FULL);
+				return;
+			}
+
+			// copy data (the only copy of a splitted message: frame pool -> destination)
+			uint8_t pos_first = pos[0].buffer_pos;
+			obj->buffer_rx[pos_first].valid = true;
+			obj->buffer_rx[pos_first].source = address;
+			obj->buffer_rx[pos_first].destination = obj->address;
+			uint16_t pointer_offset = 0;
+			for (int j = 0; j < parts_total; j++) {
+				memcpy(data + pointer_offset, obj->buffer_rx[pos[j].buffer_pos].data, obj->buffer_rx[pos[j].buffer_pos].data_length);
+				pointer_offset = pointer_offset + obj->buffer_rx[pos[j].buffer_pos].data_length;
+			}
+			obj->buffer_rx[pos_first].data_length = data_length;
+			obj->buffer_rx[pos_first].part =		0;
+			obj->buffer_rx[pos_first].parts_total = 1;
+
+			// free + delete old splitted messages
+			for (int j = 0; j < parts_total; j++) {
+				radio_rx_release(obj, &obj->buffer_rx[pos[j].buffer_pos]);
+				obj->buffer_rx[pos[j].buffer_pos].valid = false;
+			}
+			obj->buffer_rx[pos_first].valid = true;
+			obj->buffer_rx[pos_first].data  = data;
+			obj->buffer_rx[pos_first].frame = RADIO_RX_FRAME_NONE;
+		}
+	}
+}
+
+// decompress a received message in place, false = message discarded
+bool radio_decompress(radio_t* obj, radio_message_t* msg) {
+	if (!(msg->flags & RADIO_FLAG_LZ)) { return true; }
+
+	uint16_t len = radio_lz_get_length(msg->data, msg->data_length);
+	uint8_t* data = (len ? RADIO_MALLOC(len) : NULL);
+	if (len && data == NULL) {
+		radio_throw_error(obj, radio_error_RAM_FULL);
+		radio_rx_release(obj, msg);
+		return false;
+	}
+	if (data == NULL || radio_lz_decompress(msg->data, msg->data_length, data, len) != len) {
+		radio_throw_error(obj, radio_error_RX_DECOMPRESS);
+		RADIO_FREE(data);
+		radio_rx_release(obj, msg);
+		return false;
+	}
+	radio_rx_release(obj, msg);
+	msg->data = data;
+	msg->frame = RADIO_RX_FRAME_NONE;
+	msg->data_length = len;
+	msg->flags &= (uint8_t)~RADIO_FLAG_LZ;
+	return true;
+}
+
+uint8_t radio_buffer_tx_get(radio_t* obj, radio_message_t* msg) {
+	
+	// get next msg
+	// a message waiting for its retry time blocks all following messages to the same destination
+	// 1st pass: nodes in their listen window, 2nd pass: all others (not to sleeping nodes)
+	// own relayed messages: max RADIO_RELAY_WINDOW per target not confirmed yet
+	// beacon mode: only in the own slot / contention period (node) or outside the used slots (base)
+	uint8_t pos = 0; bool pos_found = false;
+	uint32_t now = radio_time(obj);
+	if (!radio_beacon_tx(obj)) {
+		msg->valid = false;
+		return 0;
+	}
+	for (uint8_t pass = 2; pass >= 1 && !pos_found; pass--) {
+		for (int i=0; i<obj->buffer_tx_size && !pos_found; i++) {
+			if (obj->buffer_tx[i].valid == true && (int32_t)(now - obj->buffer_tx[i].time_retry) >= 0 && radio_node_tx_state(obj, obj->buffer_tx[i].via) >= pass && radio_relay_window(obj, &obj->buffer_tx[i])) {
+				pos_found = true;
+				pos = i;
+				for (int j=0; j<i; j++) {
+					if (obj->buffer_tx[j].valid == true && obj->buffer_tx[j].destination == obj->buffer_tx[i].destination) {
+						pos_found = false;
+						break;
+					}
+				}
+			}
+		}
+	}
+	if (!pos_found) {
+		msg->valid = false;
+		return 0;
+	}
+
+	// copy data and return
+	memcpy(msg, &obj->buffer_tx[pos], sizeof(radio_message_t));
+	obj->buffer_tx[pos].valid = false;
+	return pos;
+}
+
+void radio_buffer_rx_get(radio_t* obj, radio_message_t* msg) {
+	
+	// get next (not splitted) msg
+	uint8_t pos = 0; bool pos_found = false;
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total == 1) {
+			pos_found = true;
+			pos = i;
+			break;
+		}
+	}
+	if (!pos_found) {
+		msg->valid = false;
+		return;
+	}
+
+	// copy data and return
+	memcpy(msg, &obj->buffer_rx[pos], sizeof(radio_message_t));
+	obj->buffer_rx[pos].valid = false;
+	return;
+}
+
+void radio_buffer_rx_remove_expired(radio_t* obj) {
+	if (obj->millis == NULL) { return; }
+
+	uint32_t now = radio_time(obj);
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total > 1 && now - obj->buffer_rx[i].time > RADIO_REASSEMBLY_TIMEOUT) {
+			radio_node_get(obj, obj->buffer_rx[i].source)->stats.reassembly_timeouts++;
+			radio_buffer_rx_remove_msg(obj, obj->buffer_rx[i].source, obj->buffer_rx[i].msg_id);
+			radio_throw_error(obj, radio_error_REASSEMBLY_TIMEOUT);
+		}
+	}
+}
+
+// remove all parts of a splitted message
+void radio_buffer_rx_remove_msg(radio_t* obj, uint8_t src, uint8_t msg_id) {
+	for (int i = 0; i < obj->buffer_rx_size; i++) {
+		if (obj->buffer_rx[i].valid == true && obj->buffer_rx[i].parts_total > 1 && obj->buffer_rx[i].source == src && obj->buffer_rx[i].msg_id == msg_id) {
+			radio_rx_release(obj, &obj->buffer_rx[i]);
+			obj->buffer_rx[i].valid = false;
+		}
+	}
+}
+
+// first unused frame of the RX frame pool (RADIO_RX_FRAME_NONE = all frames queued), 32 frames per step
+uint8_t radio_rx_frame_reserve(radio_t* obj) {
+	for (int i = 0; i < RADIO_RX_FRAME_MAP_WORDS(obj->buffer_rx_size); i++) {
+		uint32_t free_frames = ~obj->rx_frame_map[i];
+		if (free_frames == 0) { continue; }
+		uint8_t frame = (uint8_t)(i * 32 + __builtin_ctz(free_frames));
+		return (frame < obj->buffer_rx_size) ? frame : RADIO_RX_FRAME_NONE;
+	}
+	return RADIO_RX_FRAME_NONE;
+}
+
+// give the data of a received message back (frame pool or malloc'ed)
+void radio_rx_release(radio_t* obj, radio_message_t* msg) {
+	if (msg->frame == RADIO_RX_FRAME_NONE) {
+		RADIO_FREE(msg->data);
+	} else {
+		obj->rx_frame_map[msg->frame / 32] &= ~(1UL << (msg->frame % 32));
+	}
+	msg->data = NULL;
+}
+
+uint8_t radio_buffer_count(radio_t* obj, radio_buffer_t buffer) {
+	uint8_t count = 0;
+	switch (buffer) {
+		case radio_BUFFER_TX: for (int i = 0; i < obj->buffer_tx_size; i++) { if (obj->buffer_tx[i].valid) { count++; } } break;
+		case radio_BUFFER_RX: for (int i = 0; i < obj->buffer_rx_size; i++) { if (obj->buffer_rx[i].valid) { count++; } } break;
+		default: break;
+	}
+	return count;
+}
+
+void radio_buffer_sort(radio_t* obj, radio_buffer_t buffer) {
+
+	// set parameter
+	uint16_t         BUFFER_SIZE = 0;
+	radio_message_t* BUFFER = NULL;
+	switch (buffer) {
+		case radio_BUFFER_TX: BUFFER_SIZE = obj->buffer_tx_size; BUFFER = obj->buffer_tx; break;
+		case radio_BUFFER_RX: BUFFER_SIZE = obj->buffer_rx_size; BUFFER = obj->buffer_rx; break;
+		default: return; break;
+	}
+
+	// find next gap
+	for (int pos_gap = 0; pos_gap < BUFFER_SIZE; pos_gap++) {
+		if (BUFFER[pos_gap].valid == false) {
+
+			// find next valid item
+			for (int pos = pos_gap + 1; pos < BUFFER_SIZE; pos++) {
+				if (BUFFER[pos].valid == true) {
+
+					// move item to gap position
+					BUFFER[pos_gap] = BUFFER[pos];
+					BUFFER[pos].valid = false;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void radio_bulk_tx_fill(radio_t* obj) {
+	radio_bulk_tx_t* bulk = &obj->bulk_tx;
+	if (bulk->state != radio_bulk_RUNNING) { return; }
+
+	// number of queued bulk frames
+	uint8_t queued = 0;
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true && (obj->buffer_tx[i].flags & RADIO_FLAG_BULK)) { queued++; }
+	}
+
+	// read the next parts from the source and queue them
+	uint8_t MAX_CHUNK_SIZE = radio_max_data(obj, bulk->destination) - RADIO_BULK_HEADER_SIZE;
+	uint8_t frame[RADIO_FRAME_SIZE_MAX];
+	while (queued < RADIO_BULK_TX_WINDOW && bulk->offset_queued < bulk->total && radio_buffer_count(obj, radio_BUFFER_TX) < obj->buffer_tx_size) {
+		uint32_t chunk = bulk->total - bulk->offset_queued;
+		if (chunk > MAX_CHUNK_SIZE) { chunk = MAX_CHUNK_SIZE; }
+		uint16_t read = obj->bulk_read(bulk->destination, bulk->transfer_id, bulk->offset_queued, frame + RADIO_BULK_HEADER_SIZE, (uint16_t)chunk);
+		if (read == 0 || read > chunk) {
+			radio_bulk_tx_failed(obj);
+			return;
+		}
+
+		frame[0] = bulk->transfer_id;
+		radio_write_u32(frame + 1, bulk->offset_queued);
+		radio_write_u32(frame + 5, bulk->total);
+		if (!radio_buffer_tx_add(obj, bulk->destination, frame, RADIO_BULK_HEADER_SIZE + read, RADIO_FLAG_BULK, 0)) { return; }
+		bulk->offset_queued = bulk->offset_queued + read;
+		queued++;
+	}
+}
+
+// offset behind the chunk of a queued bulk frame
+uint32_t radio_bulk_end(radio_message_t* msg) {
+	uint8_t* data = msg->data + radio_relay_length(msg);
+	return radio_read_u32(data + 1) + (msg->data_length - radio_relay_length(msg) - RADIO_BULK_HEADER_SIZE);
+}
+
+// relayed frame the target confirms (in order, so the frames before are delivered too)
+bool radio_bulk_confirm_point(uint32_t offset, uint32_t end, uint32_t total) {
+	return end == total || offset / RADIO_BULK_CONFIRM != end / RADIO_BULK_CONFIRM;
+}
+
+// frame ACKed (relayed: confirmed by the target), the frames of a transfer are removed when it pauses
+void radio_bulk_tx_acked(radio_t* obj, uint8_t dest, uint32_t offset) {
+	radio_bulk_tx_t* bulk = &obj->bulk_tx;
+	if (bulk->state != radio_bulk_RUNNING || dest != bulk->destination || offset <= bulk->offset_acked) { return; }
+
+	// earlier confirmation points with a lost confirmation are delivered too
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		radio_relay_wait_t* wait = &obj->relay_wait[i];
+		if (wait->valid && wait->destination == dest && wait->bulk_offset != 0 && wait->bulk_offset <= offset) { wait->valid = false; }
+	}
+	bulk->offset_acked = offset;
+	bulk->rewinds = 0;
+	if (bulk->offset_acked >= bulk->total) {
+		bulk->state = radio_bulk_DONE;
+		if (obj->bulk_done != NULL) { obj->bulk_done(bulk->destination, bulk->transfer_id, radio_bulk_DONE, bulk->offset_acked); }
+	}
+}
+
+// pause the transfer at the last ACKed offset, continue with radio_bulk_resume()
+void radio_bulk_tx_failed(radio_t* obj) {
+	radio_bulk_tx_t* bulk = &obj->bulk_tx;
+	if (bulk->state != radio_bulk_RUNNING) { return; }
+
+	radio_bulk_tx_drop(obj);
+	bulk->state = radio_bulk_PAUSED;
+	if (obj->bulk_done != NULL) { obj->bulk_done(bulk->destination, bulk->transfer_id, radio_bulk_PAUSED, bulk->offset_acked); }
+}
+
+// relayed frame without confirmation (lost after the first hop): continue at the last confirmed offset
+void radio_bulk_tx_rewind(radio_t* obj) {
+	radio_bulk_tx_t* bulk = &obj->bulk_tx;
+	if (bulk->state != radio_bulk_RUNNING) { return; }
+	if (++bulk->rewinds > RADIO_BULK_REWINDS) {
+		radio_bulk_tx_failed(obj);
+		return;
+	}
+	radio_bulk_tx_drop(obj);
+}
+
+// queued frames and confirmations still expected are dropped, the next frame is read at the last ACKed offset
+void radio_bulk_tx_drop(radio_t* obj) {
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		if (obj->buffer_tx[i].valid == true && (obj->buffer_tx[i].flags & RADIO_FLAG_BULK)) {
+			RADIO_FREE(obj->buffer_tx[i].data);
+			obj->buffer_tx[i].valid = false;
+		}
+	}
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		if (obj->relay_wait[i].bulk_offset != 0) { obj->relay_wait[i].valid = false; }
+	}
+	obj->bulk_tx.offset_queued = obj->bulk_tx.offset_acked;
+}
+
+// true = confirm it (relayed): confirmation point taken now or before, false = invalid, behind a gap (lost on a later
+// hop) or no confirmation point
+bool radio_bulk_rx(radio_t* obj, uint8_t src, uint8_t* data, uint16_t len) {
+	if (obj->bulk_receive == NULL || len <= RADIO_BULK_HEADER_SIZE) { return false; }
+
+	uint8_t  transfer_id = data[0];
+	uint32_t offset = radio_read_u32(data + 1);
+	uint32_t total = radio_read_u32(data + 5);
+	uint16_t chunk = len - RADIO_BULK_HEADER_SIZE;
+	if (chunk > total || offset > total - chunk) { return false; } // invalid frame (no overflow of offset + chunk)
+
+	// find transfer or use a free / the oldest context
+	// a new context starts at the offset of the first frame, that allows to resume a transfer
+	uint32_t now = radio_time(obj);
+	radio_bulk_rx_t* ctx = NULL;
+	for (int i = 0; i < RADIO_BULK_RX_CONTEXTS; i++) {
+		if (obj->bulk_rx[i].valid == true && obj->bulk_rx[i].source == src && obj->bulk_rx[i].transfer_id == transfer_id) {
+			ctx = &obj->bulk_rx[i];
+			break;
+		}
+	}
+	if (ctx == NULL) {
+		ctx = &obj->bulk_rx[0];
+		for (int i = 0; i < RADIO_BULK_RX_CONTEXTS; i++) {
+			if (obj->bulk_rx[i].valid == false) {
+				ctx = &obj->bulk_rx[i];
+				break;
+			}
+			if (now - obj->bulk_rx[i].time_last > now - ctx->time_last) { ctx = &obj->bulk_rx[i]; }
+		}
+		ctx->valid = true;
+		ctx->source = src;
+		ctx->transfer_id = transfer_id;
+		ctx->offset = offset;
+	} else if (now - ctx->time_last > RADIO_BULK_TIMEOUT) {
+		ctx->offset = offset; // transfer restarted after a long pause
+	}
+	ctx->time_last = now;
+
+	// already delivered (e.g. resumed transfer), gap (the origin resumes at the last confirmed offset)
+	if (offset < ctx->offset) { return radio_bulk_confirm_point(offset, offset + chunk, total); }
+	if (offset > ctx->offset) { return false; }
+
+	// stream into the sink
+	obj->bulk_receive(src, transfer_id, offset, total, data + RADIO_BULK_HEADER_SIZE, chunk);
+	ctx->offset = offset + chunk;
+	if (ctx->offset == total) {
+		ctx->valid = false;
+		if (obj->bulk_done != NULL) { obj->bulk_done(src, transfer_id, radio_bulk_DONE, total); }
+	}
+	return radio_bulk_confirm_point(offset, offset + chunk, total);
+}
+
+void radio_write_u32(uint8_t* data, uint32_t value) {
+	data[0] = (uint8_t)(value);
+	data[1] = (uint8_t)(value >> 8);
+	data[2] = (uint8_t)(value >> 16);
+	data[3] = (uint8_t)(value >> 24);
+}
+
+uint32_t radio_read_u32(uint8_t* data) {
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void radio_throw_error(radio_t* obj, radio_error_code_t error) {
+	obj->error_cnt++;
+	if (obj->error_handler != NULL) {
+		obj->error_handler(error);
+	}
+}
+
+uint32_t radio_time(radio_t* obj) {
+	if (obj->millis == NULL) { return 0; }
+	return obj->millis();
+}
+
+// xorshift32
+uint32_t radio_random(radio_t* obj) {
+	obj->random ^= obj->random << 13;
+	obj->random ^= obj->random >> 17;
+	obj->random ^= obj->random << 5;
+	return obj->random;
+}
+
+radio_node_t* radio_node_get(radio_t* obj, uint8_t address) {
+
+	// known node
+	radio_node_t* node = radio_node_find(obj, address);
+	if (node != NULL) { return node; }
+
+	// new node: use a free entry or replace the node not seen for the longest time
+	uint8_t pos = 0;
+	uint32_t now = radio_time(obj);
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		if (obj->nodes[i].valid == false) {
+			pos = i;
+			break;
+		}
+		if (now - obj->nodes[i].time_last_seen > now - obj->nodes[pos].time_last_seen) {
+			pos = i;
+		}
+	}
+	node = &obj->nodes[pos];
+	if (node->valid && node->mailbox != NULL) { radio_tx_report(obj, node->address, node->mailbox_handle, radio_tx_FAILED); }
+	radio_mailbox_clear(obj, node);
+	memset(node, 0, sizeof(radio_node_t));
+	node->valid = true;
+	node->address = address;
+	node->time_last_seen = now;
+	node->ack_timeout = obj->retry.ack_timeout_init;
+	node->link_power = RADIO_LINK_POWER_MAX;
+	return node;
+}
+
+void radio_group_loop(radio_t* obj) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	if (grp->state == radio_group_COLLECTING && radio_time(obj) - grp->time_sent > RADIO_GROUP_ACK_WINDOW) {
+		radio_group_repair(obj);
+	}
+}
+
+// ACK window of a group message is over: queue unicast messages to members without group ACK
+void radio_group_repair(radio_t* obj) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	grp->state = radio_group_REPAIR;
+	for (int i = 0; i < 16; i++) {
+		uint16_t bit = (uint16_t)(1 << i);
+		if (!(grp->members & bit) || (grp->confirmed & bit)) { continue; }
+		uint8_t address = grp->group | i;
+		if (radio_buffer_tx_add(obj, address, grp->data, grp->data_length, 0x00, 0)) {
+			grp->repair_msg_id[i] = radio_node_get(obj, address)->msg_id_tx;
+			obj->group_stats.repairs++;
+		} else {
+			grp->failed |= bit;
+		}
+	}
+	if ((grp->confirmed | grp->failed) == grp->members) { radio_group_finish(obj); }
+}
+
+// last part of the broadcast sent
+void radio_group_sent(radio_t* obj, radio_message_t* msg) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	if (grp->state != radio_group_SENDING || msg->msg_id != grp->msg_id || msg->part + 1 != msg->parts_total) { return; }
+	if (grp->collect_acks && grp->members) {
+		grp->state = radio_group_COLLECTING;
+		grp->time_sent = radio_time(obj);
+	} else {
+		grp->confirmed = grp->members; // no confirmation, latency = time to send
+		radio_group_finish(obj);
+	}
+}
+
+// group ACK: [group][msg_id]
+void radio_group_ack_rx(radio_t* obj, uint8_t src, uint8_t* data, uint16_t len) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	if (len < 2 || grp->state != radio_group_COLLECTING || data[0] != grp->group || data[1] != grp->msg_id || (src & 0xF0) != grp->group) { return; }
+	grp->members |= (uint16_t)(1 << (src & 0x0F)); // member that was not known yet
+	grp->confirmed |= (uint16_t)(1 << (src & 0x0F));
+	if (grp->confirmed == grp->members) { radio_group_finish(obj); }
+}
+
+// member: group ACK to the sender in the own slot (address & 0x0F), the members would collide otherwise
+void radio_group_ack_send(radio_t* obj, uint8_t dest, uint8_t group, uint8_t msg_id) {
+	uint8_t ack[2] = { group, msg_id };
+	if (!radio_buffer_tx_add(obj, dest, ack, sizeof(ack), RADIO_FLAG_GROUP_ACK, 0)) { return; }
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		radio_message_t* msg = &obj->buffer_tx[i];
+		if (msg->valid && msg->destination == dest && (msg->flags & RADIO_FLAG_GROUP_ACK) && !msg->in_flight && msg->retries == 0) {
+			msg->time_retry = radio_time(obj) + (uint32_t)(obj->address & 0x0F) * RADIO_GROUP_ACK_SLOT;
+		}
+	}
+}
+
+// unicast repair ACKed or failed
+void radio_group_unicast_done(radio_t* obj, uint8_t dest, uint8_t msg_id, bool ok) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	uint16_t bit = (uint16_t)(1 << (dest & 0x0F));
+	if (grp->state != radio_group_REPAIR || (dest & 0xF0) != grp->group || !(grp->members & bit) || grp->repair_msg_id[dest & 0x0F] != msg_id) { return; }
+	if ((grp->confirmed | grp->failed) & bit) { return; }
+	if (ok) {
+		grp->confirmed |= bit;
+	} else {
+		grp->failed |= bit;
+	}
+	if ((grp->confirmed | grp->failed) == grp->members) { radio_group_finish(obj); }
+}
+
+void radio_group_finish(radio_t* obj) {
+	radio_group_tx_t* grp = &obj->group_tx;
+	if ((grp->confirmed | grp->failed) == grp->members) {
+		uint32_t latency = radio_time(obj) - grp->time_start;
+		obj->group_stats.latency = (latency > 0xFFFF ? 0xFFFF : (uint16_t)latency);
+		if (obj->group_stats.latency > obj->group_stats.latency_max) { obj->group_stats.latency_max = obj->group_stats.latency; }
+	}
+	for (int i = 0; i < 16; i++) {
+		if (grp->failed & (1 << i)) { obj->group_stats.failed++; }
+	}
+	RADIO_FREE(grp->data);
+	grp->data = NULL;
+	grp->state = radio_group_IDLE;
+}
+
+// relayed frame (after the duplicate check of the last hop): forward it along its path (repeater) or learn the path
+// back to the origin (target), returns the relay header length, 0 = frame consumed (forwarded, confirmation or invalid)
+uint8_t radio_relay_rx(radio_t* obj, uint8_t* src, uint8_t* frame, uint8_t len) {
+	uint8_t* relay = frame + RADIO_MSG_HEADER_SIZE;
+	uint8_t hops = (len > RADIO_MSG_HEADER_SIZE + 2) ? (relay[2] & 0x0F) : 0xFF;
+	if (hops > RADIO_RELAY_MAX_HOPS || len <= RADIO_MSG_HEADER_SIZE + RADIO_RELAY_HEADER_SIZE(hops)) {
+		obj->relay_dropped++;
+		radio_throw_error(obj, radio_error_RELAY_DROPPED);
+		return 0;
+	}
+	uint8_t origin = relay[0];
+	uint8_t target = relay[1];
+	uint8_t* path = relay + 3;
+
+	// repeater: to the next repeater of the path or the target (message id and parts of the origin are kept)
+	if (target != obj->address) {
+		int i = 0;
+		while (i < hops && path[i] != obj->address) { i++; }
+		radio_message_t msg;
+		radio_header_t* header = (radio_header_t*)frame;
+		msg.destination = target;
+		msg.via = (i + 1 < hops) ? path[i + 1] : target;
+		msg.source = origin;
+		msg.msg_id = radio_header_get_MSG_ID(obj, header);
+		msg.part = radio_header_get_PART(obj, header);
+		msg.parts_total = radio_header_get_PARTS_TOTAL(obj, header);
+		msg.flags = radio_header_get_FLAGS(obj, header) & RADIO_RELAY_FLAGS;
+		msg.data_length = len - RADIO_MSG_HEADER_SIZE;
+		if (obj->relay && i < hops && radio_relay_queue(obj, &msg, relay)) {
+			obj->relay_forwarded++;
+		} else {
+			obj->relay_dropped++;
+			radio_throw_error(obj, radio_error_RELAY_DROPPED);
+		}
+		return 0;
+	}
+
+	// target: reversed path to the origin, the last uplink path wins
+	radio_node_t* node = radio_node_get(obj, origin);
+	node->relay_hops = hops;
+	for (int i = 0; i < hops; i++) { node->relay_path[i] = path[hops - 1 - i]; }
+	node->time_last_seen = radio_time(obj);
+	node->sleepy = false; // the repeater listens
+	if (relay[2] & RADIO_RELAY_CONFIRM) {
+		radio_relay_confirmed(obj, origin, relay[RADIO_RELAY_HEADER_SIZE(hops)]);
+		return 0;
+	}
+	node->stats.packets_rx++;
+	*src = origin;
+	return RADIO_RELAY_HEADER_SIZE(hops);
+}
+
+// relay header of a frame to node (own address as origin), returns its length
+uint8_t radio_relay_header(radio_t* obj, radio_node_t* node, uint8_t* data, bool confirm) {
+	data[0] = obj->address;
+	data[1] = node->address;
+	data[2] = node->relay_hops | (confirm ? RADIO_RELAY_CONFIRM : 0x00);
+	memcpy(data + 3, node->relay_path, node->relay_hops);
+	return RADIO_RELAY_HEADER_SIZE(node->relay_hops);
+}
+
+// relay header length of a queued message (data starts with it)
+uint8_t radio_relay_length(radio_message_t* msg) {
+	if (!(msg->flags & RADIO_FLAG_RELAY)) { return 0; }
+	return RADIO_RELAY_HEADER_SIZE(msg->data[2] & 0x0F);
+}
+
+// queue a single relayed frame to msg->via (data = relay header + payload, internal message)
+bool radio_relay_queue(radio_t* obj, radio_message_t* msg, uint8_t* data) {
+	int pos = -1;
+	for (int i = 0; i < obj->buffer_tx_size && pos < 0; i++) {
+		if (obj->buffer_tx[i].valid == false) { pos = i; }
+	}
+	if (pos < 0) { return false; }
+	uint8_t* copy = RADIO_MALLOC(msg->data_length);
+	if (copy == NULL) {
+		radio_throw_error(obj, radio_error_RAM_FULL);
+		return false;
+	}
+	memcpy(copy, data, msg->data_length);
+
+	radio_message_t* m = &obj->buffer_tx[pos];
+	*m = *msg;
+	m->data = copy;
+	m->valid = true;
+	m->retries = 0;
+	m->seq = radio_node_next_seq(obj, radio_node_get(obj, msg->via));
+	m->handle = 0;
+	m->time = radio_time(obj);
+	m->time_retry = m->time;
+	m->in_flight = false;
+	uint8_t used = radio_buffer_count(obj, radio_BUFFER_TX);
+	if (used > obj->buffer_tx_high_water) { obj->buffer_tx_high_water = used; }
+	return true;
+}
+
+// relayed message delivered to receive(): confirmation [msg_id] back to the origin (path just learned)
+void radio_relay_confirm(radio_t* obj, uint8_t origin, uint8_t msg_id) {
+	radio_node_t* node = radio_node_find(obj, origin);
+	if (node == NULL || node->relay_hops == 0) { return; }
+	uint8_t data[RADIO_RELAY_HEADER_SIZE(RADIO_RELAY_MAX_HOPS) + 1];
+	uint8_t len = radio_relay_header(obj, node, data, true);
+	data[len++] = msg_id;
+
+	radio_message_t msg;
+	msg.destination = origin;
+	msg.via = node->relay_path[0];
+	msg.source = obj->address;
+	msg.msg_id = radio_node_next_msg_id(obj, node);
+	msg.part = 0;
+	msg.parts_total = 1;
+	msg.flags = RADIO_FLAG_RELAY;
+	msg.data_length = len;
+	if (!radio_relay_queue(obj, &msg, data)) { radio_throw_error(obj, radio_error_TX_BUFFER_FULL); }
+}
+
+// last part of an own relayed message ACKed by the first repeater: wait for the confirmation (table full: oldest fails)
+void radio_relay_wait(radio_t* obj, radio_message_t* msg) {
+	radio_relay_wait_t* wait = &obj->relay_wait[0];
+	uint32_t now = radio_time(obj);
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		if (obj->relay_wait[i].valid == false) {
+			wait = &obj->relay_wait[i];
+			break;
+		}
+		if (now - obj->relay_wait[i].time_forwarded > now - wait->time_forwarded) { wait = &obj->relay_wait[i]; }
+	}
+	if (wait->valid) {
+		radio_tx_report(obj, wait->destination, wait->handle, radio_tx_FAILED);
+		radio_group_unicast_done(obj, wait->destination, wait->msg_id, false);
+		if (wait->bulk_offset != 0) { radio_bulk_tx_rewind(obj); }
+	}
+	wait->valid = true;
+	wait->destination = msg->destination;
+	wait->msg_id = msg->msg_id;
+	wait->handle = msg->handle;
+	wait->time = msg->time;
+	wait->time_forwarded = now;
+	wait->bulk_offset = (msg->flags & RADIO_FLAG_BULK) ? radio_bulk_end(msg) : 0;
+	radio_tx_report(obj, msg->destination, msg->handle, radio_tx_FORWARDED);
+}
+
+// confirmation of the target received
+void radio_relay_confirmed(radio_t* obj, uint8_t origin, uint8_t msg_id) {
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		radio_relay_wait_t* wait = &obj->relay_wait[i];
+		if (wait->valid && wait->destination == origin && wait->msg_id == msg_id) {
+			wait->valid = false;
+			radio_tx_delivered(obj, origin, wait->handle, msg_id, wait->time);
+			if (wait->bulk_offset != 0) { radio_bulk_tx_acked(obj, origin, wait->bulk_offset); }
+			return;
+		}
+	}
+
+	// before the ACK of the first repeater (ACK lost, retransmission queued): delivered, drop the retransmission
+	for (int i = 0; i < obj->buffer_tx_size; i++) {
+		radio_message_t* msg = &obj->buffer_tx[i];
+		if (msg->valid && msg->destination == origin && msg->msg_id == msg_id && msg->source == obj->address && (msg->flags & RADIO_FLAG_RELAY)) {
+			radio_tx_delivered(obj, origin, msg->handle, msg_id, msg->time);
+			if (msg->flags & RADIO_FLAG_BULK) { radio_bulk_tx_acked(obj, origin, radio_bulk_end(msg)); }
+			radio_buffer_tx_remove_msg(obj, origin, msg_id);
+			radio_buffer_sort(obj, radio_BUFFER_TX);
+			return;
+		}
+	}
+}
+
+// relayed messages without confirmation (lost after the first hop)
+void radio_relay_loop(radio_t* obj) {
+	if (obj->millis == NULL) { return; }
+	uint32_t now = radio_time(obj);
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		radio_relay_wait_t* wait = &obj->relay_wait[i];
+		if (wait->valid && now - wait->time_forwarded > (uint32_t)(RADIO_RELAY_MAX_HOPS + 1) * obj->retry.time_budget) {
+			wait->valid = false;
+			radio_node_get(obj, wait->destination)->stats.ack_timeouts++;
+			radio_throw_error(obj, radio_error_RELAY_TIMEOUT);
+			radio_tx_report(obj, wait->destination, wait->handle, radio_tx_FAILED);
+			radio_group_unicast_done(obj, wait->destination, wait->msg_id, false);
+			if (wait->bulk_offset != 0) { radio_bulk_tx_rewind(obj); }
+		}
+	}
+}
+
+// false = RADIO_RELAY_WINDOW own relayed messages to the target of msg wait for the confirmation (flow control)
+bool radio_relay_window(radio_t* obj, radio_message_t* msg) {
+	if (!(msg->flags & RADIO_FLAG_RELAY) || msg->source != obj->address || (msg->data[2] & RADIO_RELAY_CONFIRM)) { return true; }
+	uint8_t count = 0;
+	for (int i = 0; i < RADIO_RELAY_PENDING; i++) {
+		if (obj->relay_wait[i].valid && obj->relay_wait[i].destination == msg->destination) { count++; }
+	}
+	return count < RADIO_RELAY_WINDOW;
+}
+
+// beacon (base): sent directly at the start of every superframe (not queued, no ACK), true = sent
+// the slot map is sent in pages (one per beacon) and recomputed at the start of every page cycle
+bool radio_beacon_send(radio_t* obj) {
+	radio_beacon_t* b = &obj->beacon;
+	if (!b->enabled || obj->millis == NULL) { return false; }
+	uint32_t now = radio_time(obj);
+	if (b->period != 0 && now - b->time_start < b->period) { return false; }
+	if (!radio_link_apply(obj, 0, RADIO_LINK_POWER_MAX)) { return false; }
+	if (b->page == 0) { radio_beacon_map(obj); }
+	uint8_t per_page = (uint8_t)((RADIO_MSG_MAX_DATA_SIZE(obj) - 1 - RADIO_BEACON_HEADER_SIZE) / RADIO_BEACON_ENTRY_SIZE);
+	uint8_t pages = (b->entries == 0) ? 1 : (uint8_t)((b->entries - 1) / per_page + 1);
+	uint8_t first = (uint8_t)(b->page * per_page);
+	uint8_t count = (b->entries - first < per_page) ? (uint8_t)(b->entries - first) : per_page;
+	b->frame++;
+	b->time_start = now;
+	b->sent++;
+
+	uint8_t payload[RADIO_FRAME_SIZE_MAX];
+	uint8_t* beacon = payload + 1;
+	payload[0] = RADIO_CONTROL_BEACON;
+	radio_write_u32(beacon, now);
+	beacon[4] = (uint8_t)(b->period & 0xFF);
+	beacon[5] = (uint8_t)(b->period >> 8);
+	beacon[6] = b->slot_length;
+	beacon[7] = b->slots;
+	beacon[8] = b->frame;
+	beacon[9] = b->version;
+	beacon[10] = (uint8_t)(b->page << 4 | pages);
+	memcpy(beacon + RADIO_BEACON_HEADER_SIZE, &b->map[first], count * RADIO_BEACON_ENTRY_SIZE);
+	b->page = (b->page + 1 >= pages) ? 0 : (uint8_t)(b->page + 1);
+
+	radio_message_t msg;
+	memset(&msg, 0, sizeof(radio_message_t));
+	msg.parts_total = 1;
+	msg.flags = RADIO_FLAG_CONTROL;
+	msg.destination = RADIO_BROADCAST;
+	msg.data = payload;
+	msg.data_length = 1 + RADIO_BEACON_HEADER_SIZE + count * RADIO_BEACON_ENTRY_SIZE;
+	uint8_t frame[RADIO_FRAME_SIZE_MAX];
+	uint8_t len = radio_generate_tx_data(obj, &msg, frame);
+	RADIO_RFM_TRANSMIT(obj, RADIO_BROADCAST, frame, len);
+	return true;
+}
+
+// slot map from the report intervals of the node table (base): superframe = shortest interval (a bit less, rounded
+// down to the step), a node reporting every n superframes uses its slot every 2^k <= n superframes (k <= 3) and shares
+// it with other nodes (phase), nodes reporting faster than the superframe and relayed nodes use the contention period
+// the schedule is kept stable: superframe and slot periods are only made longer with a margin of 1/4, nodes keep
+// their slot if it is still free, slots given up are not reassigned in the next version (nodes that did not receive
+// their page yet still use them)
+void radio_beacon_map(radio_t* obj) {
+	radio_beacon_t* b = &obj->beacon;
+	uint32_t now = radio_time(obj);
+	uint32_t interval[RADIO_NODE_TABLE_SIZE];
+	uint32_t interval_min = RADIO_BEACON_PERIOD_MAX;
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		radio_node_t* node = &obj->nodes[i];
+		interval[i] = 0;
+		if (!node->valid || node->report_interval == 0 || node->relay_hops || node->address == RADIO_BROADCAST) { continue; }
+		uint32_t ms = node->report_interval * 100UL;
+		ms -= ms / 8;
+		if (now - node->time_last_seen > 4 * ms) { continue; } // silent for several intervals
+		interval[i] = ms;
+		if (ms < interval_min) { interval_min = ms; }
+	}
+	uint32_t period = interval_min / RADIO_BEACON_PERIOD_STEP * RADIO_BEACON_PERIOD_STEP;
+	if (period < RADIO_BEACON_PERIOD_MIN) { period = RADIO_BEACON_PERIOD_MIN; }
+	if (b->period >= RADIO_BEACON_PERIOD_MIN && b->period < period && interval_min < b->period + b->period / 4) { period = b->period; }
+	uint32_t slots_max = (period - 2 * RADIO_BEACON_GUARD - RADIO_BEACON_CAP_MIN) / RADIO_BEACON_SLOT;
+	if (slots_max > 0xFF) { slots_max = 0xFF; }
+
+	// period of every node (k = 0xFF: contention period)
+	uint8_t k_node[RADIO_NODE_TABLE_SIZE];
+	for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+		uint32_t n = interval[i] / period;
+		k_node[i] = (n == 0) ? 0xFF : (n >= 8) ? 3 : (n >= 4) ? 2 : (n >= 2) ? 1 : 0;
+		radio_beacon_slot_t* prev = NULL;
+		for (int j = 0; j < b->entries && prev == NULL; j++) {
+			if (b->map[j].address == obj->nodes[i].address) { prev = &b->map[j]; }
+		}
+		if (k_node[i] != 0xFF && prev != NULL && period == b->period && (prev->period >> 4) < k_node[i] && interval[i] < (period << k_node[i]) + (period << k_node[i]) / 4) {
+			k_node[i] = prev->period >> 4;
+		}
+	}
+
+	// shortest period first, previous slot or first slot with a free phase (bit per superframe counter % 8)
+	uint8_t used[0x100], used_prev[0x100];
+	memset(used, 0, sizeof(used));
+	memset(used_prev, 0, sizeof(used_prev));
+	for (int j = 0; j < b->entries; j++) {
+		for (uint8_t f = b->map[j].period & 0x0F; f < 8; f += (uint8_t)(1 << (b->map[j].period >> 4))) { used_prev[b->map[j].slot] |= (uint8_t)(1 << f); }
+	}
+	radio_beacon_slot_t map[RADIO_NODE_TABLE_SIZE];
+	uint8_t entries = 0, slots = 0;
+	for (uint8_t k = 0; k <= 3; k++) {
+		uint8_t mask = 0;
+		for (uint8_t j = 0; j < 8; j += (uint8_t)(1 << k)) { mask |= (uint8_t)(1 << j); }
+		for (uint8_t pass = 0; pass < 2; pass++) {
+			for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+				if (k_node[i] != k) { continue; }
+				bool found = false;
+				for (int j = 0; j < b->entries && pass == 0 && !found; j++) {
+					radio_beacon_slot_t* prev = &b->map[j];
+					if (prev->address != obj->nodes[i].address || (prev->period >> 4) != k || prev->slot >= slots_max) { continue; }
+					if (used[prev->slot] & (uint8_t)(mask << (prev->period & 0x0F))) { continue; }
+					used[prev->slot] |= (uint8_t)(mask << (prev->period & 0x0F));
+					map[entries++] = *prev;
+					found = true;
+				}
+				for (uint32_t s = 0; s < slots_max && pass == 1 && !found; s++) {
+					for (uint8_t phase = 0; phase < (1 << k) && !found; phase++) {
+						if ((used[s] | used_prev[s]) & (uint8_t)(mask << phase)) { continue; }
+						used[s] |= (uint8_t)(mask << phase);
+						map[entries].address = obj->nodes[i].address;
+						map[entries].slot = (uint8_t)s;
+						map[entries].period = (uint8_t)(k << 4 | phase);
+						entries++;
+						found = true;
+					}
+				}
+				if (found) { k_node[i] = 0xFE; } // placed
+			}
+		}
+	}
+	for (int i = 0; i < entries; i++) {
+		if (map[i].slot + 1 > slots) { slots = (uint8_t)(map[i].slot + 1); }
+	}
+
+	// new version if the schedule changed (nodes keep their old slot until they received their page)
+	if (period != b->period || entries != b->entries || slots != b->slots || memcmp(map, b->map, entries * RADIO_BEACON_ENTRY_SIZE) != 0) {
+		b->version++;
+	}
+	memcpy(b->map, map, entries * RADIO_BEACON_ENTRY_SIZE);
+	b->entries = entries;
+	b->slots = slots;
+	b->period = (uint16_t)period;
+	b->slot_length = RADIO_BEACON_SLOT;
+}
+
+// beacon received (node): superframe starts now, own slot from the slot map, the old one is kept until the node
+// found its entry in the new version or received all pages without it
+void radio_beacon_rx(radio_t* obj, uint8_t* data, uint16_t len) {
+	radio_beacon_t* b = &obj->beacon;
+	if (b->enabled || obj->millis == NULL || len < RADIO_BEACON_HEADER_SIZE) { return; }
+	b->time_start = radio_time(obj);
+	b->time_base = radio_read_u32(data);
+	b->period = (uint16_t)(data[4] | data[5] << 8);
+	b->slot_length = data[6];
+	b->slots = data[7];
+	b->frame = data[8];
+	if (!b->synced) { b->own.address = 0; }
+	if (!b->synced || data[9] != b->version) {
+		b->version = data[9];
+		b->pages_seen = 0;
+		b->own_current = false;
+	}
+	b->pages_seen |= (uint16_t)(1 << (data[10] >> 4));
+	for (uint16_t i = RADIO_BEACON_HEADER_SIZE; i + RADIO_BEACON_ENTRY_SIZE <= len; i += RADIO_BEACON_ENTRY_SIZE) {
+		if (data[i] == obj->address) {
+			memcpy(&b->own, &data[i], RADIO_BEACON_ENTRY_SIZE);
+			b->own_current = true;
+		}
+	}
+	if (!b->own_current && b->pages_seen == (uint16_t)((1 << (data[10] & 0x0F)) - 1)) { b->own.address = 0; }
+	b->synced = b->period > 0 && b->slot_length > RADIO_BEACON_GUARD;
+}
+
+// false = no transmission may start now (beacon mode): around the beacon, outside the own slot (node with slot),
+// outside the contention period (node without slot or after a link fallback) or in a slot used in this superframe (base)
+// frame + ACK have to fit into the slot: transmissions start in the first RADIO_BEACON_GUARD ms of a slot,
+// nodes without slot start at a random time in the first half of the contention period (no burst at its start)
+bool radio_beacon_tx(radio_t* obj) {
+	radio_beacon_t* b = &obj->beacon;
+	if (!(b->enabled || b->synced) || b->period == 0 || obj->millis == NULL) { return true; }
+	uint32_t elapsed = radio_time(obj) - b->time_start;
+	if (b->synced && elapsed >= (uint32_t)RADIO_BEACON_SYNC_FRAMES * b->period) {
+		b->synced = false; // beacons lost: random access with the default link profile
+		for (int i = 0; i < RADIO_NODE_TABLE_SIZE; i++) {
+			if (obj->nodes[i].valid) { radio_link_fallback(obj, &obj->nodes[i]); }
+		}
+		return true;
+	}
+	bool scheduled = b->own.address != 0 && !obj->link_fallback; // fallback: default bitrate, not in the slot
+	uint8_t frame = (uint8_t)(b->frame + elapsed / b->period);
+	uint32_t t = elapsed % b->period;
+	if (t < RADIO_BEACON_GUARD || t + b->slot_length + RADIO_BEACON_GUARD > b->period) { return false; }
+	t -= RADIO_BEACON_GUARD;
+	uint32_t slots_end = (uint32_t)b->slots * b->slot_length;
+	if (t >= slots_end && b->synced) {
+		uint32_t cap = b->period - 2 * RADIO_BEACON_GUARD - slots_end;
+		uint32_t offset = ((uint32_t)obj->address * 2654435761UL ^ (uint32_t)frame * 40503UL) % (cap / 2 + 1);
+		return !scheduled && t >= slots_end + offset;
+	}
+	if (t >= slots_end) { return true; }
+	uint8_t slot = (uint8_t)(t / b->slot_length);
+	if (t % b->slot_length >= RADIO_BEACON_GUARD) { return false; }
+	if (b->synced) { return scheduled && b->own.slot == slot && radio_beacon_active(&b->own, frame); }
+	for (int i = 0; i < b->entries; i++) {
+		if (b->map[i].slot == slot && radio_beacon_active(&b->map[i], frame)) { return false; }
+	}
+	return true;
+}
+
+// slot used in the superframe with this counter
+bool radio_beacon_active(radio_beacon_slot_t* slot, uint8_t frame) {
+	return (frame & ((1 << (slot->period >> 4)) - 1)) == (slot->period & 0x0F);
+}
+
+// report interval: mean interval of RADIO_BEACON_REPORTS new uplink messages (not changed by the slot timing of the
+// beacon mode), smoothed (weight of the new mean 1/2)
+void radio_node_report(radio_t* obj, radio_node_t* node) {
+	uint32_t now = radio_time(obj);
+	if (obj->millis == NULL) { return; }
+	if (node->time_report == 0 || now - node->time_report > 0xFFFF * 100UL * RADIO_BEACON_REPORTS) {
+		node->time_report = now;
+		node->report_count = 0;
+		return;
+	}
+	if (++node->report_count < RADIO_BEACON_REPORTS) { return; }
+	uint32_t mean = (now - node->time_report) / 100 / node->report_count;
+	node->report_interval = (uint16_t)((node->report_interval == 0) ? mean : (node->report_interval + mean) / 2);
+	node->time_report = now;
+	node->report_count = 0;
+}
+
+// slot map entry of a node (base), NULL = contention period
+radio_beacon_slot_t* radio_beacon_find(radio_t* obj, uint8_t address) {
+	for (int i = 0; i < obj->beacon.entries; i++) {
+		if (obj->beacon.map[i].address == address) { return &obj->beacon.map[i]; }
+	}
+	return NULL;
+}
+
+// node of the uplink slot running now (base), 0 = none (beacon, contention period or free slot)
+uint8_t radio_beacon_owner(radio_t* obj) {
+	radio_beacon_t* b = &obj->beacon;
+	if (!b->enabled || b->period == 0 || b->slot_length == 0 || obj->millis == NULL) { return 0; }
+	uint32_t elapsed = radio_time(obj) - b->time_start;
+	uint8_t frame = (uint8_t)(b->frame + elapsed / b->period);
+	uint32_t t = elapsed % b->period;
+	if (t < RADIO_BEACON_GUARD || t - RADIO_BEACON_GUARD >= (uint32_t)b->slots * b->slot_length) { return 0; }
+	uint8_t slot = (uint8_t)((t - RADIO_BEACON_GUARD) / b->slot_length);
+	for (int i = 0; i < b->entries; i++) {
+		if (b->map[i].slot == slot && radio_beacon_active(&b->map[i], frame)) { return b->map[i].address; }
+	}
+	return 0;
+}
+
+// control frame: [type] + data
+void radio_control_rx(radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len) {
+	if (len < 1) { return; }
+	switch (data[0]) {
+		case RADIO_CONTROL_BEACON: radio_beacon_rx(obj, data + 1, len - 1); break;
+		case RADIO_CONTROL_LINK:   radio_link_rx(obj, node, data + 1, len - 1); break;
+		case RADIO_CONTROL_FALLBACK: radio_link_notice_rx(obj, node); break;
+		default: break;
+	}
+}
+
+// link profile of the base station (node): used for the frames to / from it, ends a fallback
+void radio_link_rx(radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len) {
+	if (obj->link_adapt || len < 2) { return; }
+	int8_t power = (int8_t)data[1];
+	node->link_rate = (data[0] < RADIO_LINK_STEPS) ? data[0] : 0;
+	node->link_power = (power < RADIO_LINK_POWER_MIN) ? RADIO_LINK_POWER_MIN : (power > RADIO_LINK_POWER_MAX) ? RADIO_LINK_POWER_MAX : power;
+	node->link_failures = 0;
+	obj->link_fallback = false;
+	obj->link_changes++;
+}
+
+// new direct uplink message (base): every RADIO_LINK_SAMPLES messages the fastest bitrate step with the margin above
+// its sensitivity (a faster step needs the hysteresis on top, only nodes with a beacon slot) and the lowest TX power
+// that keeps the margin, any loss since the last decision: one step down and full power
+void radio_link_adapt(radio_t* obj, radio_node_t* node) {
+	static const int8_t sensitivity[RADIO_LINK_STEPS] = RADIO_LINK_SENSITIVITY;
+	if (!obj->link_adapt) { return; }
+	if (node->link_pending || node->link_rssi == 0 || ++node->link_samples < RADIO_LINK_SAMPLES) { return; }
+	node->link_samples = 0;
+	uint8_t loss = (uint8_t)(node->stats.ack_timeouts + node->stats.duplicates + node->stats.crc_errors);
+	bool lost = loss != node->link_loss;
+	node->link_loss = loss;
+
+	// RSSI at full power
+	int16_t rssi = (int16_t)(node->link_rssi / 4 + (RADIO_LINK_POWER_MAX - node->link_power));
+	uint8_t rate = 0;
+	int16_t power = RADIO_LINK_POWER_MAX;
+	if (lost) {
+		rate = (node->link_rate > 0) ? (uint8_t)(node->link_rate - 1) : 0;
+	} else {
+		bool slot = obj->beacon.enabled && radio_beacon_find(obj, node->address) != NULL;
+		for (uint8_t step = RADIO_LINK_STEPS - 1; step > 0 && rate == 0 && slot; step--) {
+			if (rssi - sensitivity[step] >= RADIO_LINK_MARGIN + (step > node->link_rate ? RADIO_LINK_HYSTERESIS : 0)) { rate = step; }
+		}
+		power = (int16_t)(RADIO_LINK_POWER_MAX - (rssi - sensitivity[rate] - RADIO_LINK_MARGIN));
+		if (power > RADIO_LINK_POWER_MAX) { power = RADIO_LINK_POWER_MAX; }
+		if (power < RADIO_LINK_POWER_MIN) { power = RADIO_LINK_POWER_MIN; }
+		if (power < node->link_power && power > node->link_power - RADIO_LINK_HYSTERESIS) { power = node->link_power; }
+	}
+	if (rate != node->link_rate || power != node->link_power) { radio_link_send(obj, node, rate, (int8_t)power); }
+}
+
+// control frame with a new profile (base), sent with the default profile, used once the node ACKed it
+void radio_link_send(radio_t* obj, radio_node_t* node, uint8_t rate, int8_t power) {
+	uint8_t data[3] = { RADIO_CONTROL_LINK, rate, (uint8_t)power };
+	node->link_pending = radio_buffer_tx_add(obj, node->address, data, sizeof(data), RADIO_FLAG_CONTROL, 0);
+}
+
+// message to the node ACKed or failed: a control frame with a profile confirmed (base), RSSI samples follow the power
+// node in a fallback: notice to the base once it ACKed a message (in reach again), sent again after a failed notice
+void radio_link_done(radio_t* obj, radio_node_t* node, radio_message_t* msg, bool ok) {
+	if (ok && obj->link_fallback && !(msg->flags & (RADIO_FLAG_CONTROL | RADIO_FLAG_RELAY))) { radio_link_notice(obj, node); }
+	if (!(msg->flags & RADIO_FLAG_CONTROL) || msg->data_length < 1) { return; }
+	if (msg->data[0] == RADIO_CONTROL_FALLBACK) {
+		obj->link_notice = false;
+		return;
+	}
+	if (msg->data_length < 3 || msg->data[0] != RADIO_CONTROL_LINK) { return; }
+	node->link_pending = false;
+	if (!ok) { return; }
+	int8_t power = (int8_t)msg->data[2];
+	if (node->link_rssi != 0) { node->link_rssi = (int16_t)(node->link_rssi + (power - node->link_power) * 4); }
+	node->link_rate = msg->data[1];
+	node->link_power = power;
+	node->link_samples = 0;
+	obj->link_changes++;
+}
+
+// message failed after the last retry: after RADIO_LINK_FAILSAFE failed messages in a row the default profile is used
+// (node: signalled in its next uplinks, base: sent to the node with the default profile)
+void radio_link_failed(radio_t* obj, radio_node_t* node) {
+	if (++node->link_failures < RADIO_LINK_FAILSAFE) { return; }
+	node->link_failures = 0;
+	bool changed = node->link_rate != 0 || node->link_power != RADIO_LINK_POWER_MAX;
+	radio_link_fallback(obj, node);
+	if (obj->link_adapt && changed && !node->link_pending) { radio_link_send(obj, node, 0, RADIO_LINK_POWER_MAX); }
+}
+
+// fail-safe: default profile (node: until the base sends a new one, signalled with a control frame)
+void radio_link_fallback(radio_t* obj, radio_node_t* node) {
+	if (node->link_rate == 0 && node->link_power == RADIO_LINK_POWER_MAX) { return; }
+	if (node->link_rssi != 0) { node->link_rssi = (int16_t)(node->link_rssi + (RADIO_LINK_POWER_MAX - node->link_power) * 4); }
+	node->link_rate = 0;
+	node->link_power = RADIO_LINK_POWER_MAX;
+	obj->link_fallback = !obj->link_adapt;
+	obj->link_fallbacks++;
+}
+
+// node: fallback notice to the base (control frame, default profile), one at a time
+void radio_link_notice(radio_t* obj, radio_node_t* node) {
+	uint8_t data[1] = { RADIO_CONTROL_FALLBACK };
+	if (obj->link_notice || node->address == RADIO_BROADCAST) { return; }
+	obj->link_notice = radio_buffer_tx_add(obj, node->address, data, sizeof(data), RADIO_FLAG_CONTROL, 0);
+}
+
+// base: the node fell back, it gets the default profile again
+void radio_link_notice_rx(radio_t* obj, radio_node_t* node) {
+	if (!obj->link_adapt) { return; }
+	radio_link_fallback(obj, node);
+	node->link_samples = 0;
+	if (!node->link_pending) { radio_link_send(obj, node, 0, RADIO_LINK_POWER_MAX); }
+}
+
+// profile of a frame: power of the next hop, its bitrate step only in the own beacon slot (node),
+// broadcasts and control frames with the default profile, false = transceiver not switched
+bool radio_link_tx(radio_t* obj, radio_message_t* msg) {
+	radio_node_t* node = (msg->via == RADIO_BROADCAST || (msg->flags & RADIO_FLAG_CONTROL)) ? NULL : radio_node_find(obj, msg->via);
+	if (node == NULL) { return radio_link_apply(obj, 0, RADIO_LINK_POWER_MAX); }
+	bool slot = !obj->link_adapt && !obj->link_fallback && obj->beacon.synced && obj->beacon.own.address != 0;
+	return radio_link_apply(obj, slot ? node->link_rate : 0, node->link_power);
+}
+
+// receiver: bitrate step of the slot owner (base), otherwise the default step
+void radio_link_listen(radio_t* obj) {
+	uint8_t rate = 0;
+	uint8_t owner = obj->link_adapt ? radio_beacon_owner(obj) : 0;
+	if (owner != 0) {
+		radio_node_t* node = radio_node_find(obj, owner);
+		if (node != NULL) { rate = node->link_rate; }
+	}
+	radio_link_apply(obj, rate, obj->link_power);
+}
+
+// switch the transceiver if the profile changed, false = not switched now
+bool radio_link_apply(radio_t* obj, uint8_t rate, int8_t power) {
+	if (rate == obj->link_rate && power == obj->link_power) { return true; }
+	if (!RADIO_RFM_SET_LINK(obj, rate, power)) { return false; }
+	obj->link_rate = rate;
+	obj->link_power = power;
+	return true;
+}
+
+// 0 = sleeping or waiting for an ACK payload confirmation (hold messages), 1 = normal, 2 = in the listen window (send first)
+uint8_t radio_node_tx_state(radio_t* obj, uint8_t address) {
+	radio_node_t* node = radio_node_find(obj, address);
+	if (node == NULL) { return 1; }
+	if (node->ack_data_pending) {
+		uint32_t timeout = node->report_interval ? node->report_interval * 100UL * RADIO_ACK_DATA_INTERVALS : RADIO_ACK_DATA_TIMEOUT;
+		if (obj->millis == NULL || radio_time(obj) - node->ack_data_time <= timeout) { return 0; }
+		radio_ack_data_failed(obj, node); // node did not come back, send as a normal frame
+	}
+	if (!node->sleepy) { return 1; }
+	if ((int32_t)(node->listen_until - radio_time(obj)) > 0) { return 2; }
+	return 0;
+}
+
+// uplink of a sleeping node received: move the held command to the TX buffer
+void radio_node_wakeup(radio_t* obj, radio_node_t* node) {
+	uint32_t now = radio_time(obj);
+	node->listen_until = now + RADIO_LISTEN_WINDOW;
+	if (node->mailbox == NULL) { return; }
+	if (obj->millis != NULL && now - node->mailbox_time > RADIO_MAILBOX_TIMEOUT) {
+		radio_tx_report(obj, node->address, node->mailbox_handle, radio_tx_FAILED);
+		radio_mailbox_clear(obj, node);
+		radio_throw_error(obj, radio_error_MAILBOX_EXPIRED);
+		return;
+	}
+	if (radio_buffer_tx_add(obj, node->address, node->mailbox, node->mailbox_length, node->mailbox_flags, node->mailbox_handle)) {
+		radio_mailbox_clear(obj, node);
+	}
+}
+
+// latest wins: a held command is replaced by a newer one
+bool radio_mailbox_put(radio_t* obj, radio_node_t* node, uint8_t* data, uint16_t len, uint8_t flags, uint16_t handle) {
+	uint8_t* mailbox = RADIO_MALLOC(len);
+	if (mailbox == NULL) {
+		radio_throw_error(obj, radio_error_RAM_FULL);
+		return false;
+	}
+	memcpy(mailbox, data, len);
+	if (node->mailbox != NULL) { node->stats.mailbox_replaced++; }
+	radio_mailbox_clear(obj, node);
+	node->mailbox = mailbox;
+	node->mailbox_length = len;
+	node->mailbox_flags = flags;
+	node->mailbox_handle = handle;
+	node->mailbox_time = radio_time(obj);
+	node->stats.mailbox_held++;
+	return true;
+}
+
+void radio_mailbox_clear(radio_t* obj, radio_node_t* node) {
+	if (node->valid && node->mailbox != NULL) { RADIO_FREE(node->mailbox); }
+	node->mailbox = NULL;
+	node->mailbox_length = 0;
+}
+
+// Jacobson / Karels: srtt = 7/8 srtt + 1/8 rtt, rttvar = 3/4 rttvar + 1/4 |rtt - srtt|
+void radio_node_add_rtt(radio_t* obj, radio_node_t* node, uint16_t rtt) {
+	if (node->srtt == 0) {
+		node->srtt = (uint16_t)(rtt << 3);
+		node->rttvar = (uint16_t)(rtt << 1);
+	} else {
+		int32_t delta = (int32_t)rtt - (node->srtt >> 3);
+		node->srtt = (uint16_t)(node->srtt + delta);
+		if (delta < 0) { delta = -delta; }
+		node->rttvar = (uint16_t)(node->rttvar + delta - (node->rttvar >> 2));
+	}
+	if (node->srtt == 0) { node->srtt = 1; } // keep "sample available"
+
+	uint32_t timeout = (node->srtt >> 3) + node->rttvar;
+	if (timeout < obj->retry.ack_timeout_min) { timeout = obj->retry.ack_timeout_min; }
+	if (timeout > obj->retry.ack_timeout_max) { timeout = obj->retry.ack_timeout_max; }
+	node->ack_timeout = (uint16_t)timeout;
+}
+
+// double the timeout until the next valid sample
+void radio_node_ack_timeout(radio_t* obj, radio_node_t* node) {
+	uint32_t timeout = (uint32_t)node->ack_timeout * 2;
+	if (timeout > obj->retry.ack_timeout_max) { timeout = obj->retry.ack_timeout_max; }
+	node->ack_timeout = (uint16_t)timeout;
+}
+
+// number of transmission attempts whose (doubling) timeouts fit into the time budget
+uint8_t radio_node_max_retries(radio_t* obj, radio_node_t* node) {
+	radio_retry_t* policy = &obj->retry;
+	uint32_t timeout = policy->ack_timeout_init;
+	if (node->srtt != 0) { timeout = (node->srtt >> 3) + node->rttvar; }
+	if (timeout < policy->ack_timeout_min) { timeout = policy->ack_timeout_min; }
+
+	uint8_t retries = 0;
+	uint32_t time_sum = 0;
+	while (retries < policy->retries_max && time_sum + timeout <= policy->time_budget) {
+		time_sum = time_sum + timeout;
+		timeout = (timeout * 2 > policy->ack_timeout_max ? policy->ack_timeout_max : timeout * 2);
+		retries++;
+	}
+	if (retries < policy->retries_min) { retries = policy->retries_min; }
+	return retries;
+}
+
+// true = seq was already received from this node (retransmission)
+bool radio_node_is_duplicate(radio_t* obj, radio_node_t* node, uint8_t seq) {
+	if (seq == 0) { return false; } // node without sequence numbers
+
+	// forget old sequence numbers (e.g. node restarted with the same seq)
+	if (radio_time(obj) - node->time_last_seen > RADIO_DEDUP_TIMEOUT) {
+		for (int i = 0; i < RADIO_DEDUP_WINDOW; i++) { node->seq_rx[i] = 0; }
+	}
+
+	for (int i = 0; i < RADIO_DEDUP_WINDOW; i++) {
+		if (node->seq_rx[i] == seq) { return true; }
+	}
+	node->seq_rx[node->seq_rx_pos] = seq;
+	node->seq_rx_pos = (node->seq_rx_pos + 1) % RADIO_DEDUP_WINDOW;
+	return false;
+}
+
+uint8_t radio_node_next_msg_id(radio_t* obj, radio_node_t* node) {
+	node->msg_id_tx++;
+	return node->msg_id_tx;
+}
+
+uint8_t radio_node_next_seq(radio_t* obj, radio_node_t* node) {
+	node->seq_tx++;
+	if (node->seq_tx == 0) { node->seq_tx = 1; } // 0 = no sequence number
+	return node->seq_tx;
+}
+
+uint8_t radio_header_get_PART(radio_t* obj, radio_header_t* header) {
+	return header->part;
+}
+
+uint8_t radio_header_get_PARTS_TOTAL(radio_t* obj, radio_header_t* header) {
+	return header->parts_total;
+}
+
+uint8_t radio_header_get_SEQ(radio_t* obj, radio_header_t* header) {
+	return header->seq;
+}
+
+uint8_t radio_header_get_MSG_ID(radio_t* obj, radio_header_t* header) {
+	return header->msg_id;
+}
+
+uint8_t radio_header_get_FLAGS(radio_t* obj, radio_header_t* header) {
+	return header->flags;
+}
+
+uint8_t radio_header_get_CRC(radio_t* obj, radio_header_t* header) {
+	return header->crc8;
+}
+
+uint8_t radio_header_del_CRC(radio_t* obj, radio_header_t* header) {
+	header->crc8 = 0x00;
+	return 0;
+}
+
+uint8_t radio_header_cal_CRC(radio_t* obj, radio_message_t* msg) {
+
+	// create header + data
+	uint8_t data[RADIO_FRAME_SIZE_MAX];
+	uint16_t len = radio_generate_tx_data(obj, msg, data);
+
+	// crc
+	return radio_crc8(0xFF, data, len);
+}
+
+uint8_t radio_cal_CRC(radio_t* obj, uint8_t* data, uint16_t len) {
+	if (data == NULL) { return 0x00; }
+	return radio_crc8(0xFF, data, len);
 }
\ No newline at end of file
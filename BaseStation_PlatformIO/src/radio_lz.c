@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////
+// FILENAME:    radio_lz.c                         //
+// DESCRIPTION: LZ compression for radio messages  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <string.h>
+#include "radio_lz.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+// keys + values of our JSON payloads, must be identical on the nodes
+#define RADIO_LZ_DICTIONARY  "\"state\":\"off\",\"state\":\"on\",\"bright\":\"value\":\"temp\":\"hum\":\"batt\":\"cmd\":\"set\",\"mode\":\"auto\",\"color\":true,false}"
+#define RADIO_LZ_DICT_LEN    (sizeof(RADIO_LZ_DICTIONARY) - 1)
+
+#define RADIO_LZ_MIN_MATCH   3
+#define RADIO_LZ_MAX_MATCH   (0x7F + RADIO_LZ_MIN_MATCH)
+#define RADIO_LZ_MAX_LITERAL 0x80
+#define RADIO_LZ_MAX_DIST    256
+
+static const uint8_t radio_lz_dict[] = RADIO_LZ_DICTIONARY;
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t radio_lz_window        (const uint8_t* data, int32_t pos);
+bool    radio_lz_flush_literals(const uint8_t* in, uint16_t lit_start, uint16_t lit_len, uint8_t* out, uint16_t* out_pos, uint16_t out_size);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+uint16_t radio_lz_compress(const uint8_t* in, uint16_t in_len, uint8_t* out, uint16_t out_size) {
+	if (in == NULL || in_len == 0 || out_size < 2) { return 0; }
+
+	out[0] = (uint8_t)(in_len);
+	out[1] = (uint8_t)(in_len >> 8);
+	uint16_t out_pos = 2;
+	uint16_t lit_start = 0;
+	uint16_t lit_len = 0;
+
+	uint16_t i = 0;
+	while (i < in_len) {
+
+		// find the longest match (greedy)
+		uint16_t best_len = 0;
+		uint16_t best_dist = 0;
+		for (uint16_t dist = 1; dist <= RADIO_LZ_MAX_DIST && (int32_t)i - dist >= -(int32_t)RADIO_LZ_DICT_LEN; dist++) {
+			uint16_t len = 0;
+			while (len < RADIO_LZ_MAX_MATCH && i + len < in_len && radio_lz_window(in, (int32_t)i - dist + len) == in[i + len]) {
+				len++;
+			}
+			if (len > best_len) {
+				best_len = len;
+				best_dist = dist;
+			}
+		}
+
+		if (best_len >= RADIO_LZ_MIN_MATCH) {
+			if (!radio_lz_flush_literals(in, lit_start, lit_len, out, &out_pos, out_size)) { return 0; }
+			lit_len = 0;
+			if (out_pos + 2 > out_size) { return 0; }
+			out[out_pos++] = (uint8_t)(0x80 | (best_len - RADIO_LZ_MIN_MATCH));
+			out[out_pos++] = (uint8_t)(best_dist - 1);
+			i = i + best_len;
+		} else {
+			if (lit_len == 0) { lit_start = i; }
+			lit_len++;
+			if (lit_len == RADIO_LZ_MAX_LITERAL) {
+				if (!radio_lz_flush_literals(in, lit_start, lit_len, out, &out_pos, out_size)) { return 0; }
+				lit_len = 0;
+			}
+			i++;
+		}
+	}
+	if (!radio_lz_flush_literals(in, lit_start, lit_len, out, &out_pos, out_size)) { return 0; }
+	return out_pos;
+}
+
+uint16_t radio_lz_decompress(const uint8_t* in, uint16_t in_len, uint8_t* out, uint16_t out_size) {
+	uint16_t len = radio_lz_get_length(in, in_len);
+	if (len == 0 || len > out_size) { return 0; }
+
+	uint16_t i = 2;
+	uint16_t out_pos = 0;
+	while (i < in_len) {
+		uint8_t token = in[i++];
+		if (token < 0x80) {
+			uint16_t n = token + 1;
+			if (i + n > in_len || out_pos + n > len) { return 0; }
+			memcpy(out + out_pos, in + i, n);
+			i = i + n;
+			out_pos = out_pos + n;
+		} else {
+			uint16_t n = (token & 0x7F) + RADIO_LZ_MIN_MATCH;
+			if (i >= in_len || out_pos + n > len) { return 0; }
+			int32_t src = (int32_t)out_pos - (in[i++] + 1);
+			if (src < -(int32_t)RADIO_LZ_DICT_LEN) { return 0; }
+			for (uint16_t j = 0; j < n; j++) {
+				out[out_pos] = radio_lz_window(out, src + j);
+				out_pos++;
+			}
+		}
+	}
+	return (out_pos == len ? len : 0);
+}
+
+uint16_t radio_lz_get_length(const uint8_t* in, uint16_t in_len) {
+	if (in == NULL || in_len < 2) { return 0; }
+	return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// data with the dictionary in front of it (pos < 0)
+uint8_t radio_lz_window(const uint8_t* data, int32_t pos) {
+	if (pos < 0) { return radio_lz_dict[RADIO_LZ_DICT_LEN + pos]; }
+	return data[pos];
+}
+
+bool radio_lz_flush_literals(const uint8_t* in, uint16_t lit_start, uint16_t lit_len, uint8_t* out, uint16_t* out_pos, uint16_t out_size) {
+	if (lit_len == 0) { return true; }
+	if (*out_pos + 1 + lit_len > out_size) { return false; }
+	out[(*out_pos)++] = (uint8_t)(lit_len - 1);
+	memcpy(out + *out_pos, in + lit_start, lit_len);
+	*out_pos = *out_pos + lit_len;
+	return true;
+}
@@ -0,0 +1,202 @@
+/////////////////////////////////////////////////////
+// FILENAME:    route.c                            //
+// DESCRIPTION: routing between several radios     //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <string.h>
+#include "route.h"
+
+RADIO_STATIC_ASSERT(ROUTE_MAX_RADIOS > 0 && ROUTE_MAX_RADIOS <= 8, "invalid number of radios");
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+route_node_t* route_node_get  (route_t* obj, uint8_t address, uint32_t time);
+bool          route_heard     (route_node_t* node, uint8_t radio, uint32_t time);
+void          route_switch    (route_t* obj, route_node_t* node, uint8_t radio);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void route_init(route_t* obj, radio_t* radios, uint8_t count) {
+	obj->radios = radios;
+	obj->radio_count = (count > ROUTE_MAX_RADIOS) ? ROUTE_MAX_RADIOS : count;
+	obj->radio_current = 0;
+	obj->tx_handle = 0;
+	obj->msg_id_broadcast = 0;
+	for (int i = 0; i < ROUTE_TABLE_SIZE; i++) { obj->nodes[i].valid = false; }
+	obj->switches = 0;
+	obj->duplicates = 0;
+	for (int i = 0; i < ROUTE_MAX_RADIOS; i++) { obj->rx[i] = 0; }
+}
+
+void route_loop(route_t* obj) {
+	for (uint8_t i = 0; i < obj->radio_count; i++) {
+		obj->radio_current = i;
+		radio_loop(&obj->radios[i]);
+	}
+}
+
+void route_rx(route_t* obj, radio_t* radio, uint8_t address, int16_t rssi, uint32_t time) {
+	uint8_t r = route_index(obj, radio);
+	route_node_t* node = route_node_get(obj, address, time);
+	obj->rx[r]++;
+
+	// smoothed RSSI (dBm * 4, weight of the new sample 1/4)
+	if (node->rssi[r] == 0 || !route_heard(node, r, time)) {
+		node->rssi[r] = (int16_t)(rssi * 4);
+	} else {
+		node->rssi[r] = (int16_t)(node->rssi[r] - node->rssi[r] / 4 + rssi);
+	}
+	node->time_rx[r] = time;
+
+	// take the node over: current radio did not hear it for a while or is worse by more than the hysteresis
+	if (r != node->radio && (!route_heard(node, node->radio, time) || node->rssi[r] > node->rssi[node->radio] + ROUTE_HYSTERESIS * 4)) {
+		route_switch(obj, node, r);
+	}
+}
+
+bool route_deliver(route_t* obj, uint8_t source, uint32_t time) {
+	if (obj->radio_count < 2) { return true; }
+	uint8_t r = obj->radio_current;
+	uint8_t seq = obj->radios[r].rx_seq;
+	route_node_t* node = route_node_get(obj, source, time);
+	if (seq != 0 && seq == node->seq_delivered && r != node->radio_delivered && time - node->time_delivered < ROUTE_DEDUP_TIMEOUT) {
+		obj->duplicates++;
+		return false;
+	}
+	node->seq_delivered = seq;
+	node->radio_delivered = r;
+	node->time_delivered = time;
+	return true;
+}
+
+bool route_ack(route_t* obj, radio_t* radio, uint8_t source) {
+	if (obj->radio_count < 2) { return true; }
+	return route_radio(obj, source) == radio;
+}
+
+radio_t* route_radio(route_t* obj, uint8_t address) {
+	route_node_t* node = route_node_find(obj, address);
+	if (node == NULL || node->radio >= obj->radio_count) {
+
+		// not heard directly: radio that learned a path over repeaters (see radio_relay_rx())
+		for (uint8_t i = 0; i < obj->radio_count; i++) {
+			radio_node_t* n = radio_node_find(&obj->radios[i], address);
+			if (n != NULL && n->relay_hops) { return &obj->radios[i]; }
+		}
+		return &obj->radios[0];
+	}
+	return &obj->radios[node->radio];
+}
+
+uint8_t route_index(route_t* obj, radio_t* radio) {
+	if (radio < obj->radios || radio >= obj->radios + obj->radio_count) { return 0; }
+	return (uint8_t)(radio - obj->radios);
+}
+
+route_node_t* route_node_find(route_t* obj, uint8_t address) {
+	for (int i = 0; i < ROUTE_TABLE_SIZE; i++) {
+		if (obj->nodes[i].valid && obj->nodes[i].address == address) { return &obj->nodes[i]; }
+	}
+	return NULL;
+}
+
+radio_tx_status_t route_transmit(route_t* obj, uint8_t dest, uint8_t* data, uint16_t len, uint16_t* handle) {
+	radio_t* radio = route_radio(obj, dest);
+	radio->tx_handle = obj->tx_handle;
+	radio_tx_status_t status = radio_transmit(radio, dest, data, len, handle);
+	obj->tx_handle = radio->tx_handle;
+	return status;
+}
+
+bool route_group_transmit(route_t* obj, uint8_t group, uint8_t* data, uint16_t len, bool collect_acks) {
+
+	// same message id on all radios (a node hearing several radios takes it once)
+	uint8_t msg_id = obj->msg_id_broadcast;
+	bool queued = false;
+	for (uint8_t i = 0; i < obj->radio_count; i++) {
+		radio_t* radio = &obj->radios[i];
+		radio->msg_id_broadcast = msg_id;
+		if (!radio_group_transmit(radio, group, data, len, collect_acks)) { continue; }
+		obj->msg_id_broadcast = radio->msg_id_broadcast;
+		queued = true;
+
+		// group ACKs and unicast repair only for the members routed to this radio
+		for (uint8_t j = 0; j < 16 && obj->radio_count > 1; j++) {
+			if ((radio->group_tx.members & (1 << j)) && route_radio(obj, group | j) != radio) {
+				radio->group_tx.members &= (uint16_t)~(1 << j);
+			}
+		}
+		radio->group_stats.members = (uint8_t)__builtin_popcount(radio->group_tx.members);
+	}
+	return queued;
+}
+
+bool route_buffer_empty_tx(route_t* obj) {
+	for (uint8_t i = 0; i < obj->radio_count; i++) {
+		if (!radio_buffer_empty_tx(&obj->radios[i])) { return false; }
+	}
+	return true;
+}
+
+uint16_t route_sweep(route_t* obj) {
+	uint16_t removed = 0;
+	for (uint8_t i = 0; i < obj->radio_count; i++) {
+		removed += radio_sweep(&obj->radios[i]);
+	}
+	return removed;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// known node, free entry or the node not heard for the longest time
+route_node_t* route_node_get(route_t* obj, uint8_t address, uint32_t time) {
+	route_node_t* node = route_node_find(obj, address);
+	if (node != NULL) { return node; }
+
+	node = &obj->nodes[0];
+	uint32_t age_max = 0;
+	for (int i = 0; i < ROUTE_TABLE_SIZE; i++) {
+		route_node_t* n = &obj->nodes[i];
+		if (!n->valid) {
+			node = n;
+			break;
+		}
+		uint32_t heard = n->time_delivered;
+		for (int r = 0; r < ROUTE_MAX_RADIOS; r++) {
+			if (time - n->time_rx[r] < time - heard) { heard = n->time_rx[r]; }
+		}
+		if (time - heard >= age_max) {
+			age_max = time - heard;
+			node = n;
+		}
+	}
+	memset(node, 0, sizeof(route_node_t));
+	node->valid = true;
+	node->address = address;
+	node->radio_delivered = 0xFF;
+	return node;
+}
+
+// radio heard the node within ROUTE_RSSI_TIMEOUT
+bool route_heard(route_node_t* node, uint8_t radio, uint32_t time) {
+	return node->rssi[radio] != 0 && time - node->time_rx[radio] < ROUTE_RSSI_TIMEOUT;
+}
+
+// continue the sequence numbers / message ids of the old radio (the node detects duplicates by them)
+void route_switch(route_t* obj, route_node_t* node, uint8_t radio) {
+	radio_node_t* from = radio_node_find(&obj->radios[node->radio], node->address);
+	radio_node_t* to = radio_node_find(&obj->radios[radio], node->address);
+	if (from != NULL && to != NULL) {
+		to->seq_tx = from->seq_tx;
+		to->msg_id_tx = from->msg_id_tx;
+	}
+	node->radio = radio;
+	node->switches++;
+	obj->switches++;
+}
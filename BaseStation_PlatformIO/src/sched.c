@@ -0,0 +1,173 @@
+/////////////////////////////////////////////////////
+// FILENAME:    sched.c                            //
+// DESCRIPTION: cooperative timer wheel scheduler  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include "sched.h"
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void     sched_link    (sched_t* obj, int8_t id);
+void     sched_unlink  (sched_t* obj, int8_t id);
+void     sched_run_slot(sched_t* obj, uint8_t slot, uint64_t now);
+uint64_t sched_tick    (uint64_t time);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void sched_init(sched_t* obj, void* micros, void* wait) {
+	for (int i = 0; i < SCHED_MAX_JOBS; i++) { obj->jobs[i].valid = false; obj->jobs[i].active = false; }
+	for (int i = 0; i < SCHED_WHEEL_SLOTS; i++) { obj->wheel[i] = -1; }
+	obj->pass = 0;
+	obj->event = false;
+	memset(&obj->stats, 0, sizeof(sched_stats_t));
+	obj->time_last = 0;
+	obj->time_high = 0;
+	obj->micros = micros;
+	obj->wait = wait;
+	obj->tick = sched_tick(sched_time(obj));
+}
+
+void sched_loop(sched_t* obj) {
+	uint64_t now = sched_time(obj);
+	uint64_t now_tick = sched_tick(now);
+	obj->pass++;
+
+	// loop was blocked longer than one revolution: every slot once is enough
+	if (obj->tick + SCHED_WHEEL_SLOTS <= now_tick) { obj->tick = now_tick - SCHED_WHEEL_SLOTS + 1; }
+	while (true) {
+		sched_run_slot(obj, obj->tick % SCHED_WHEEL_SLOTS, now);
+		if (obj->tick >= now_tick) { break; }
+		obj->tick++;
+	}
+}
+
+void sched_sleep(sched_t* obj, uint32_t max_ms) {
+	if (obj->event) {
+		obj->event = false;
+		return;
+	}
+	if (obj->wait == NULL) { return; }
+
+	// next due job
+	uint64_t now = sched_time(obj);
+	uint64_t next = now + (uint64_t)max_ms * 1000;
+	for (int i = 0; i < SCHED_MAX_JOBS; i++) {
+		if (obj->jobs[i].active && obj->jobs[i].due < next) { next = obj->jobs[i].due; }
+	}
+	if (next <= now + 1000) { return; }
+
+	obj->wait((uint32_t)((next - now) / 1000));
+	obj->event = false;
+	obj->stats.time_idle += sched_time(obj) - now;
+}
+
+void sched_event(sched_t* obj) {
+	obj->event = true;
+	obj->stats.wakeups++;
+}
+
+int8_t sched_add(sched_t* obj, sched_func_t func, void* arg, uint32_t delay, uint32_t period) {
+	for (int8_t i = 0; i < SCHED_MAX_JOBS; i++) {
+		if (obj->jobs[i].valid) { continue; }
+		obj->jobs[i].valid = true;
+		obj->jobs[i].active = false;
+		obj->jobs[i].func = func;
+		obj->jobs[i].arg = arg;
+		obj->jobs[i].period = period;
+		sched_start(obj, i, delay);
+		return i;
+	}
+	return -1;
+}
+
+void sched_start(sched_t* obj, int8_t id, uint32_t delay) {
+	if (id < 0 || id >= SCHED_MAX_JOBS || !obj->jobs[id].valid) { return; }
+	if (obj->jobs[id].active) { sched_unlink(obj, id); }
+	obj->jobs[id].due = sched_time(obj) + (uint64_t)delay * 1000;
+	sched_link(obj, id);
+}
+
+void sched_stop(sched_t* obj, int8_t id) {
+	if (id < 0 || id >= SCHED_MAX_JOBS || !obj->jobs[id].active) { return; }
+	sched_unlink(obj, id);
+}
+
+uint64_t sched_time(sched_t* obj) {
+	uint32_t now = obj->micros();
+	if (now < obj->time_last) { obj->time_high++; } // 32 bit overflow (every 71 minutes)
+	obj->time_last = now;
+	return ((uint64_t)obj->time_high << 32) | now;
+}
+
+uint64_t sched_millis(sched_t* obj) {
+	return sched_time(obj) / 1000;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// insert at the slot of the due time (past due times: current slot)
+void sched_link(sched_t* obj, int8_t id) {
+	sched_job_t* job = &obj->jobs[id];
+	uint64_t tick = sched_tick(job->due);
+	if (tick < obj->tick) { tick = obj->tick; }
+	job->slot = tick % SCHED_WHEEL_SLOTS;
+	job->next = obj->wheel[job->slot];
+	job->pass = obj->pass;
+	job->active = true;
+	obj->wheel[job->slot] = id;
+}
+
+void sched_unlink(sched_t* obj, int8_t id) {
+	sched_job_t* job = &obj->jobs[id];
+	int8_t* pnt = &obj->wheel[job->slot];
+	while (*pnt >= 0) {
+		if (*pnt == id) {
+			*pnt = job->next;
+			break;
+		}
+		pnt = &obj->jobs[*pnt].next;
+	}
+	job->active = false;
+}
+
+void sched_run_slot(sched_t* obj, uint8_t slot, uint64_t now) {
+	int8_t id = obj->wheel[slot];
+	while (id >= 0) {
+		sched_job_t* job = &obj->jobs[id];
+		int8_t next = job->next;
+
+		// due (jobs of later revolutions and jobs scheduled in this pass stay)
+		if (job->due <= now && job->pass != obj->pass) {
+			sched_unlink(obj, id);
+
+			// jitter: delay against the due time
+			uint64_t late = sched_time(obj) - job->due;
+			uint32_t late_us = (late > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)late;
+			obj->stats.jitter = obj->stats.jitter - (obj->stats.jitter >> 3) + (late_us >> 3);
+			if (late_us > obj->stats.jitter_max) { obj->stats.jitter_max = late_us; }
+			obj->stats.runs++;
+
+			// periodic: keep the phase, skip missed runs
+			if (job->period) {
+				job->due += (uint64_t)job->period * 1000;
+				if (job->due <= now) { job->due = now + (uint64_t)job->period * 1000; }
+				sched_link(obj, id);
+			}
+			job->func(job->arg);
+			next = obj->wheel[slot]; // job may have changed the slot, start again
+		}
+		id = next;
+	}
+}
+
+uint64_t sched_tick(uint64_t time) {
+	return time / 1000 / SCHED_TICK_MS;
+}
@@ -0,0 +1,209 @@
+/////////////////////////////////////////////////////
+// FILENAME:    stats.c                            //
+// DESCRIPTION: base station statistics for MQTT   //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint16_t stats_check_length(int len, uint16_t size);
+
+
+/* Public functions -----------------------------------------------------------------------------*/
+
+void stats_init(stats_t* obj, uint32_t time) {
+	obj->uptime_seconds = 0;
+	obj->uptime_ms = 0;
+	obj->time_last = time;
+	obj->packets_rx = 0;
+	obj->packets_tx = 0;
+	obj->tx_status_dropped = 0;
+	for (int i = 0; i < radio_error_COUNT; i++) { obj->error_cnt[i] = 0; }
+	for (int i = 0; i < stats_boot_COUNT; i++) { obj->boot_time[i] = 0; }
+}
+
+void stats_update(stats_t* obj, uint32_t time) {
+
+	// add elapsed time (unsigned subtraction handles the millis() overflow)
+	obj->uptime_ms = obj->uptime_ms + (time - obj->time_last);
+	obj->time_last = time;
+	obj->uptime_seconds = obj->uptime_seconds + (obj->uptime_ms / 1000);
+	obj->uptime_ms = obj->uptime_ms % 1000;
+}
+
+void stats_add_rx(stats_t* obj) {
+	obj->packets_rx++;
+}
+
+void stats_add_tx(stats_t* obj) {
+	obj->packets_tx++;
+}
+
+void stats_add_tx_dropped(stats_t* obj) {
+	obj->tx_status_dropped++;
+}
+
+void stats_add_error(stats_t* obj, radio_error_code_t error) {
+	if (error < radio_error_COUNT) {
+		obj->error_cnt[error]++;
+	}
+}
+
+bool stats_boot(stats_t* obj, stats_boot_t phase, uint32_t time) {
+	if (phase >= stats_boot_COUNT || obj->boot_time[phase] != 0) { return false; }
+	obj->boot_time[phase] = (time == 0) ? 1 : time;
+	return true;
+}
+
+// {"up":3600,"rx":120,"tx":4,"hw_rx":3,"hw_tx":2,"grp":{"n":2,"mbr":8,"lat":420,"lat_max":900,"rep":1,"fail":0},"sch":{"jit":120,"jit_max":4100,"wake":57,"idle":93},"lnk":[12,1],"txd":0,"txs":[4,0,3,1,0,0,0,0,0],"err":[0,0,0,1,2,0]}
+// grp: group messages, members / latency of the last one, sch: scheduler jitter (us), RFM wakeups, idle time (%)
+// lnk: link profiles confirmed by the nodes, fallbacks to the default profile
+// txd: command status reports dropped (not published), txs: see radio_tx_status_t, err: see radio_error_code_t
+// all radios: high water marks / latencies max, counters summed (a group message is sent by every radio, counted once)
+uint16_t stats_format_base(stats_t* obj, route_t* route, sched_t* sched, char* buffer, uint16_t size) {
+	uint8_t hw_rx = 0, hw_tx = 0, members = 0;
+	uint16_t latency = 0, latency_max = 0;
+	uint32_t repairs = 0, failed = 0, link_changes = 0, link_fallbacks = 0;
+	uint32_t tx_status_cnt[radio_tx_COUNT] = { 0 };
+	for (uint8_t r = 0; r < route->radio_count; r++) {
+		radio_t* radio = &route->radios[r];
+		if (radio->buffer_rx_high_water > hw_rx) { hw_rx = radio->buffer_rx_high_water; }
+		if (radio->buffer_tx_high_water > hw_tx) { hw_tx = radio->buffer_tx_high_water; }
+		members += radio->group_stats.members;
+		if (radio->group_stats.latency > latency) { latency = radio->group_stats.latency; }
+		if (radio->group_stats.latency_max > latency_max) { latency_max = radio->group_stats.latency_max; }
+		repairs += radio->group_stats.repairs;
+		failed += radio->group_stats.failed;
+		link_changes += radio->link_changes;
+		link_fallbacks += radio->link_fallbacks;
+		for (int i = 0; i < radio_tx_COUNT; i++) { tx_status_cnt[i] += radio->tx_status_cnt[i]; }
+	}
+
+	int len = snprintf(buffer, size, "{\"up\":%lu,\"rx\":%lu,\"tx\":%lu,\"hw_rx\":%u,\"hw_tx\":%u,\"grp\":{\"n\":%lu,\"mbr\":%u,\"lat\":%u,\"lat_max\":%u,\"rep\":%lu,\"fail\":%lu},\"sch\":{\"jit\":%lu,\"jit_max\":%lu,\"wake\":%lu,\"idle\":%u},\"lnk\":[%lu,%lu],\"txd\":%lu,\"txs\":[",
+		(unsigned long)obj->uptime_seconds, (unsigned long)obj->packets_rx, (unsigned long)obj->packets_tx,
+		hw_rx, hw_tx,
+		(unsigned long)route->radios[0].group_stats.messages, members, latency, latency_max,
+		(unsigned long)repairs, (unsigned long)failed,
+		(unsigned long)sched->stats.jitter, (unsigned long)sched->stats.jitter_max, (unsigned long)sched->stats.wakeups,
+		(unsigned int)(sched->stats.time_idle * 100 / (sched_time(sched) + 1)),
+		(unsigned long)link_changes, (unsigned long)link_fallbacks, (unsigned long)obj->tx_status_dropped);
+	if (stats_check_length(len, size) == 0) { return 0; }
+
+	for (int i = 0; i < radio_tx_COUNT; i++) {
+		len = len + snprintf(buffer + len, size - len, (i == 0 ? "%lu" : ",%lu"), (unsigned long)tx_status_cnt[i]);
+		if (stats_check_length(len, size) == 0) { return 0; }
+	}
+	len = len + snprintf(buffer + len, size - len, "],\"err\":[");
+	if (stats_check_length(len, size) == 0) { return 0; }
+
+	for (int i = 0; i < radio_error_COUNT; i++) {
+		len = len + snprintf(buffer + len, size - len, (i == 0 ? "%lu" : ",%lu"), (unsigned long)obj->error_cnt[i]);
+		if (stats_check_length(len, size) == 0) { return 0; }
+	}
+	len = len + snprintf(buffer + len, size - len, "]}");
+	return stats_check_length(len, size);
+}
+
+// {"rssi":-71,"rx":50,"tx":3,"crc":0,"dup":1,"ack":1,"rty":2,"reasm":0,"lat":18,"lat_max":250,"rto":40,"lz":2,"lz_saved":3,"mbox":1,"mbox_rpl":0,"ackd":4,"coal":5,"air_saved":14,"hops":1,"int":60000,"link":[1,8]}
+// coal: commands coalesced, air_saved: estimated airtime saved by coalescing (ms), hops: repeaters to the node,
+// int: smoothed report interval (ms, slot map of the beacon mode), link: bitrate step and TX power (dBm) of the node
+uint16_t stats_format_node(stats_t* obj, radio_node_t* node, char* buffer, uint16_t size) {
+	int len = snprintf(buffer, size, "{\"rssi\":%d,\"rx\":%lu,\"tx\":%lu,\"crc\":%lu,\"dup\":%lu,\"ack\":%lu,\"rty\":%lu,\"reasm\":%lu,\"lat\":%u,\"lat_max\":%u,\"rto\":%u,\"lz\":%lu,\"lz_saved\":%lu,\"mbox\":%lu,\"mbox_rpl\":%lu,\"ackd\":%lu,\"coal\":%lu,\"air_saved\":%lu,\"hops\":%u,\"int\":%lu,\"link\":[%u,%d]}",
+		node->stats.rssi, (unsigned long)node->stats.packets_rx, (unsigned long)node->stats.packets_tx,
+		(unsigned long)node->stats.crc_errors, (unsigned long)node->stats.duplicates, (unsigned long)node->stats.ack_timeouts, (unsigned long)node->stats.retries,
+		(unsigned long)node->stats.reassembly_timeouts, node->stats.latency, node->stats.latency_max, node->ack_timeout,
+		(unsigned long)node->stats.lz_messages, (unsigned long)node->stats.lz_fragments_saved,
+		(unsigned long)node->stats.mailbox_held, (unsigned long)node->stats.mailbox_replaced,
+		(unsigned long)node->stats.ack_data, (unsigned long)node->stats.coalesced, (unsigned long)(node->stats.airtime_saved / 1000), node->relay_hops,
+		(unsigned long)node->report_interval * 100, node->link_rate, node->link_power);
+	return stats_check_length(len, size);
+}
+
+// {"radio":180,"fs":240,"eth":1400,"mqtt":1650,"rx":2100,"pub":2100} (ms since reset, 0 = not reached yet)
+uint16_t stats_format_boot(stats_t* obj, char* buffer, uint16_t size) {
+	int len = snprintf(buffer, size, "{\"radio\":%lu,\"fs\":%lu,\"eth\":%lu,\"mqtt\":%lu,\"rx\":%lu,\"pub\":%lu}",
+		(unsigned long)obj->boot_time[stats_boot_RADIO], (unsigned long)obj->boot_time[stats_boot_STORAGE],
+		(unsigned long)obj->boot_time[stats_boot_ETHERNET], (unsigned long)obj->boot_time[stats_boot_MQTT],
+		(unsigned long)obj->boot_time[stats_boot_FIRST_RX], (unsigned long)obj->boot_time[stats_boot_FIRST_PUB]);
+	return stats_check_length(len, size);
+}
+
+// {"in":1200,"pub":180,"sup":1020,"agg":40,"red":81}
+// in: messages received, pub: published, sup: suppressed (unchanged), agg: aggregates, red: rate reduction (%)
+uint16_t stats_format_edge(edge_t* edge, char* buffer, uint16_t size) {
+	int len = snprintf(buffer, size, "{\"in\":%lu,\"pub\":%lu,\"sup\":%lu,\"agg\":%lu,\"red\":%u}",
+		(unsigned long)edge->messages_in, (unsigned long)edge->messages_published,
+		(unsigned long)edge->messages_suppressed, (unsigned long)edge->aggregates, edge_reduction(edge));
+	return stats_check_length(len, size);
+}
+
+// {"free":180000,"free_min":151000,"largest":110000,"frag":12,"frag_max":30,"blk":42,"bytes":2300,"bytes_max":5100,"fail":0,"bad_free":0,"orph":0,"sites":[["radio.c",731,3,165,0]]}
+// frag: 100 - largest free block / free heap (%), blk / bytes: allocated by HEAP_MALLOC(), orph: see radio_sweep()
+// sites: [file, line, blocks, bytes, failed allocations] of the call sites with allocated blocks or failures (as many as fit)
+uint16_t stats_format_heap(heap_t* heap, route_t* route, char* buffer, uint16_t size) {
+	uint32_t orphans = 0;
+	for (uint8_t r = 0; r < route->radio_count; r++) { orphans += route->radios[r].orphans; }
+	int len = snprintf(buffer, size, "{\"free\":%lu,\"free_min\":%lu,\"largest\":%lu,\"frag\":%u,\"frag_max\":%u,\"blk\":%lu,\"bytes\":%lu,\"bytes_max\":%lu,\"fail\":%lu,\"bad_free\":%lu,\"orph\":%lu,\"sites\":[",
+		(unsigned long)heap->free_size, (unsigned long)(heap->free_min == UINT32_MAX ? 0 : heap->free_min), (unsigned long)heap->largest_block,
+		heap->fragmentation, heap->fragmentation_max,
+		(unsigned long)heap->blocks, (unsigned long)heap->bytes, (unsigned long)heap->bytes_max,
+		(unsigned long)heap->fails, (unsigned long)heap->invalid_frees, (unsigned long)orphans);
+	if (stats_check_length(len, size) == 0) { return 0; }
+
+	bool first = true;
+	for (int i = 0; i <= HEAP_MAX_SITES; i++) {
+		heap_site_t* site = &heap->sites[i];
+		if (site->blocks == 0 && site->fails == 0) { continue; }
+		const char* file = "other";
+		if (site->file != NULL) {
+			file = strrchr(site->file, '/');
+			file = (file != NULL) ? file + 1 : site->file;
+		}
+		int site_len = snprintf(buffer + len, size - len, "%s[\"%s\",%u,%lu,%lu,%lu]", (first ? "" : ","), file, site->line,
+			(unsigned long)site->blocks, (unsigned long)site->bytes, (unsigned long)site->fails);
+		if (site_len < 0 || len + site_len + 2 >= size) {
+			buffer[len] = '\0'; // does not fit: skip the remaining sites
+			break;
+		}
+		len = len + site_len;
+		first = false;
+	}
+	len = len + snprintf(buffer + len, size - len, "]}");
+	return stats_check_length(len, size);
+}
+
+
+// {"sw":3,"dup":120,"r":[[500,3,2,12],[320,2,1,5]]}
+// sw: route changes, dup: uplinks heard by several radios (passed on once), r: per radio [uplink frames, hw_rx, hw_tx, nodes routed]
+uint16_t stats_format_route(route_t* route, char* buffer, uint16_t size) {
+	int len = snprintf(buffer, size, "{\"sw\":%lu,\"dup\":%lu,\"r\":[", (unsigned long)route->switches, (unsigned long)route->duplicates);
+	if (stats_check_length(len, size) == 0) { return 0; }
+
+	for (uint8_t r = 0; r < route->radio_count; r++) {
+		uint8_t nodes = 0;
+		for (int i = 0; i < ROUTE_TABLE_SIZE; i++) {
+			if (route->nodes[i].valid && route->nodes[i].radio == r) { nodes++; }
+		}
+		radio_t* radio = &route->radios[r];
+		len = len + snprintf(buffer + len, size - len, "%s[%lu,%u,%u,%u]", (r == 0 ? "" : ","), (unsigned long)route->rx[r],
+			radio->buffer_rx_high_water, radio->buffer_tx_high_water, nodes);
+		if (stats_check_length(len, size) == 0) { return 0; }
+	}
+	len = len + snprintf(buffer + len, size - len, "]}");
+	return stats_check_length(len, size);
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+uint16_t stats_check_length(int len, uint16_t size) {
+	if (len < 0 || len >= size) { return 0; }
+	return (uint16_t)len;
+}
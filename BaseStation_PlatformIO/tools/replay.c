@@ -0,0 +1,526 @@
+/////////////////////////////////////////////////////
+// FILENAME:    replay.c                           //
+// DESCRIPTION: host replay of a capture trace     //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+// Replays a trace of capture.h through the radio lib of the base station on a host and reports queue depths,
+// drops and latencies, so a field trace becomes a repeatable benchmark.
+// - RX frames are fed into the transceivers of the trace (one frame per transceiver like the RFM69, a frame that
+//   arrives before the previous one was read is lost), ACKs of the nodes are taken from the ACK records (the next
+//   frame to the node is ACKed), a downlink the base station did not send in the trace gets no ACK
+// - MQTT_IN messages and uplinks are handled by bridge.c like in the firmware (route, last value cache, report by
+//   exception, command status, snapshot, bulk transfer), MQTT is taken as connected, no journal, no capture
+// - the configuration is the one of the firmware (main.h, radio_config.h, ...)
+// - time: the trace time is the time base (1 ms steps, skipped while idle), speed 0 = as fast as possible,
+//   1 = real time, 10 = ten times faster
+//
+// build (from BaseStation_PlatformIO, one command):
+//   gcc -O2 -std=gnu99 -Iinclude -o replay tools/replay.c src/bridge.c src/capture.c src/journal.c src/radio.c
+//       src/radio_lz.c src/route.c src/heap.c src/cache.c src/edge.c src/stats.c src/sched.c -lm
+// usage:
+//   ./replay capture.bin [speed]
+// fetch a trace: "base_0x01_ctl/capture" = file, later = dump (serial output to a file, debug output is skipped),
+// or = serial while the output is recorded, e.g. cat /dev/ttyUSB0 > capture.bin
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "main.h"
+#include "radio.h"
+#include "route.h"
+#include "stats.h"
+#include "cache.h"
+#include "edge.h"
+#include "sched.h"
+#include "heap.h"
+#include "capture.h"
+#include "bridge.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define REPLAY_DRAIN_MS       60000     // max time after the last record until the buffers are empty
+#define REPLAY_HANDLES        1024      // downlink latency: queue time per handle (handle % REPLAY_HANDLES)
+#define REPLAY_LATENCY_BINS   16        // histogram, bin n: < 2^n ms
+
+
+/* Private typedef ------------------------------------------------------------------------------*/
+
+// transceiver: frame not read yet, ACKs of the trace not used yet
+typedef struct {
+	bool     valid;
+	uint8_t  source;
+	int8_t   rssi;
+	uint8_t  flags;
+	uint8_t  len;
+	uint8_t  data[RADIO_FRAME_SIZE_MAX];
+	uint32_t time;
+	uint16_t acks[256];
+} replay_rfm_t;
+
+typedef struct {
+	uint32_t count;
+	uint64_t sum;
+	uint32_t max;
+	uint32_t bins[REPLAY_LATENCY_BINS];
+} replay_latency_t;
+
+typedef struct {
+	// trace
+	uint32_t records[capture_MQTT_OUT + 1];
+	uint32_t trace_tx_frames;
+	uint32_t trace_acks_sent;
+	uint32_t time_first;
+	uint32_t time_last;
+
+	// replay
+	uint32_t rx_frames;
+	uint32_t rx_overruns;               // frame lost, previous frame not read yet
+	uint32_t tx_frames;
+	uint32_t acks_sent;
+	uint32_t published;
+	uint32_t aggregates;
+	uint32_t downlinks;
+	uint32_t tx_status[radio_tx_COUNT];
+	uint32_t errors[radio_error_COUNT];
+	uint64_t tx_depth_sum[ROUTE_MAX_RADIOS];
+	uint32_t tx_depth_max[ROUTE_MAX_RADIOS];
+	uint64_t rx_depth_sum[ROUTE_MAX_RADIOS];
+	uint32_t samples;
+	replay_latency_t rx_wait;           // frame arrival -> read from the transceiver
+	replay_latency_t uplink;            // last frame arrival -> publish
+	replay_latency_t downlink;          // MQTT_IN -> delivered / failed
+} replay_stats_t;
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+static uint32_t now = 0;
+static uint32_t rx_frame_time = 0;      // arrival of the last frame read (uplink latency)
+static bool in_receive = false;         // publish of an uplink (not a snapshot)
+static radio_t radios[ROUTE_MAX_RADIOS];
+static radio_geometry_t geometry[ROUTE_MAX_RADIOS];
+static replay_rfm_t rfm[ROUTE_MAX_RADIOS];
+static uint32_t handle_time[REPLAY_HANDLES];
+static bool handle_valid[REPLAY_HANDLES];
+static route_t route;
+static stats_t stats;
+static cache_t cache;
+static edge_t edge;
+static sched_t sched;
+static bridge_t bridge;
+static replay_stats_t replay;
+static uint8_t base_address = NODEID;
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void     replay_init     (uint8_t address, uint8_t radio_count);
+void     replay_record   (capture_record_t* record);
+void     replay_mqtt_in  (capture_record_t* record);
+bool     replay_publish  (const char* topic, const uint8_t* payload, uint16_t len, bool retain);
+void     replay_tx       (uint8_t dest, uint16_t handle, radio_tx_status_t status, uint8_t* data, uint16_t len);
+void     replay_sample   (void);
+bool     replay_idle     (void);
+void     replay_latency  (replay_latency_t* latency, uint32_t value);
+void     replay_print_latency(const char* name, replay_latency_t* latency);
+void     replay_report   (capture_reader_t* reader);
+void     receive         (uint8_t source, uint8_t* data, uint16_t len);
+void     tx_status       (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+void     error_handler   (radio_error_code_t error);
+void     publish_aggregate(uint8_t node, char* data, uint16_t len);
+uint16_t bulk_read       (uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len);
+void     bulk_done       (uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset);
+uint32_t replay_millis   (void);
+uint32_t replay_micros   (void);
+void     replay_delay    (uint32_t ms);
+
+
+/* Main -----------------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("usage: %s <trace> [speed]   (speed 0 = as fast as possible, 1 = real time)\n", argv[0]);
+		return 1;
+	}
+	double speed = (argc > 2) ? atof(argv[2]) : 0.0;
+	capture_reader_t reader;
+	if (!capture_read_open(&reader, argv[1])) {
+		printf("cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	// first record: START of the trace (address + number of radios), otherwise the firmware defaults
+	capture_record_t record;
+	bool pending = capture_read(&reader, &record);
+	if (!pending) {
+		printf("no records in %s\n", argv[1]);
+		capture_read_close(&reader);
+		return 1;
+	}
+	if (record.type == capture_START && record.flags != CAPTURE_VERSION) {
+		printf("trace version %u not supported (%u)\n", record.flags, CAPTURE_VERSION);
+		capture_read_close(&reader);
+		return 1;
+	}
+	now = record.time;
+	replay.time_first = record.time;
+	replay_init(record.type == capture_START ? record.address : NODEID,
+	            record.type == capture_START ? record.radio : RADIO_COUNT);
+
+	struct timespec wall_start;
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+	uint32_t time_start = now;
+	uint32_t time_edge = now;
+	uint32_t time_sweep = now;
+	uint32_t time_bulk = now;
+	uint32_t time_end = 0;
+	while (true) {
+
+		// records up to now
+		while (pending && (int32_t)(record.time - now) <= 0) {
+			replay_record(&record);
+			replay.time_last = record.time;
+			pending = capture_read(&reader, &record);
+			if (!pending) { time_end = now + REPLAY_DRAIN_MS; }
+		}
+		if (!pending && (replay_idle() || (int32_t)(now - time_end) >= 0)) { break; }
+
+		// loop() of the base station
+		route_loop(&route);
+		bridge_loop(&bridge, now);
+		replay_sample();
+		if (now - time_edge >= 1000) {
+			time_edge = now;
+			edge_loop(&edge, now);
+		}
+		if (now - time_sweep >= HEAP_SAMPLE_INTERVAL_MS) {
+			time_sweep = now;
+			route_sweep(&route);
+		}
+		if (now - time_bulk >= BULK_RESUME_INTERVAL_MS) {
+			time_bulk = now;
+			bridge_bulk_resume(&bridge);
+		}
+
+		// next ms, idle periods are skipped (nothing queued, no beacons)
+		if (pending && replay_idle() && (int32_t)(record.time - now) > 1) {
+			uint32_t skip = record.time - now;
+			if (skip > 1000) { skip = 1000; }  // edge windows
+			now = now + skip;
+			replay.samples = replay.samples + skip - 1;  // empty queues
+		} else {
+			now++;
+		}
+
+		// real / accelerated time
+		if (speed > 0.0) {
+			struct timespec wall;
+			clock_gettime(CLOCK_MONOTONIC, &wall);
+			double elapsed_ms = (wall.tv_sec - wall_start.tv_sec) * 1000.0 + (wall.tv_nsec - wall_start.tv_nsec) / 1e6;
+			double target_ms = (now - time_start) / speed;
+			if (target_ms > elapsed_ms + 1.0) { usleep((useconds_t)((target_ms - elapsed_ms) * 1000.0)); }
+		}
+	}
+
+	replay_report(&reader);
+	capture_read_close(&reader);
+	return 0;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// radios, route and the processing steps like setup() of the firmware
+void replay_init(uint8_t address, uint8_t radio_count) {
+	if (radio_count < 1) { radio_count = 1; }
+	if (radio_count > ROUTE_MAX_RADIOS) { radio_count = ROUTE_MAX_RADIOS; }
+	base_address = address;
+	heap_init(NULL, NULL);
+	sched_init(&sched, (void*)replay_micros, NULL);
+	stats_init(&stats, now);
+	for (uint8_t i = 0; i < radio_count; i++) {
+		radio_geometry_t* g = &geometry[i];
+		g->buffer_rx_size = RADIO_BUFFER_RX_SIZE / radio_count;
+		g->buffer_tx_size = RADIO_BUFFER_TX_SIZE / radio_count;
+		g->buffer_rx = calloc(g->buffer_rx_size, sizeof(radio_message_t));
+		g->buffer_tx = calloc(g->buffer_tx_size, sizeof(radio_message_t));
+		g->rx_frames = calloc(g->buffer_rx_size, RADIO_FRAME_SIZE_MAX);
+		g->rx_frame_map = calloc(RADIO_RX_FRAME_MAP_WORDS(g->buffer_rx_size), 4);
+		g->frame_size = RADIO_FRAME_SIZE_MAX;
+		radio_init(&radios[i], address, g);
+		radio_set_cb_func(&radios[i], (void*)receive, (void*)replay_delay, (void*)error_handler, (void*)replay_millis);
+		radio_set_cb_bulk(&radios[i], (void*)bulk_read, (void*)NULL, (void*)bulk_done);
+		radio_set_cb_tx_status(&radios[i], (void*)tx_status);
+		radio_beacon_enable(&radios[i], BEACON_MODE);
+		radio_link_enable(&radios[i], LINK_ADAPTATION);
+	}
+	route_init(&route, radios, radio_count);
+	cache_init(&cache);
+	edge_init(&edge, publish_aggregate);
+	bridge_init(&bridge, address, &route, &stats, &cache, &edge, NULL, NULL);
+	bridge_set_cb_mqtt(&bridge, (void*)replay_publish, NULL);
+	bridge_set_cb_notify(&bridge, NULL, (void*)replay_tx, NULL, NULL);
+}
+
+void replay_record(capture_record_t* record) {
+	if (record->type <= capture_MQTT_OUT) { replay.records[record->type]++; }
+	switch (record->type) {
+		case capture_RX: {
+			if (record->radio >= route.radio_count) { break; }
+			replay_rfm_t* r = &rfm[record->radio];
+
+			// the previous frame was read during the airtime of this one, otherwise it is lost
+			if (r->valid) { route_loop(&route); }
+			if (r->valid) {
+				replay.rx_overruns++;
+				break;
+			}
+			r->valid = true;
+			r->source = record->address;
+			r->rssi = record->rssi;
+			r->flags = record->flags;
+			r->len = (uint8_t)record->len;
+			memcpy(r->data, record->data, record->len);
+			r->time = record->time;
+			break;
+		}
+		case capture_TX:
+			if (record->flags & CAPTURE_FLAG_ACK) {
+				replay.trace_acks_sent++;
+			} else {
+				replay.trace_tx_frames++;
+			}
+			break;
+		case capture_ACK:
+			if (record->radio < route.radio_count) { rfm[record->radio].acks[record->address]++; }
+			break;
+		case capture_MQTT_IN:
+			replay_mqtt_in(record);
+			break;
+		default:
+			break;
+	}
+}
+
+// mqttCallback() of the firmware
+void replay_mqtt_in(capture_record_t* record) {
+	char topic[64];
+	uint8_t topic_len = (record->topic_len < sizeof(topic)) ? record->topic_len : sizeof(topic) - 1;
+	memcpy(topic, record->topic, topic_len);
+	topic[topic_len] = '\0';
+	bridge_mqtt_in(&bridge, topic, (uint8_t*)record->data, record->len, now);
+}
+
+// MQTT client of the bridge: uplinks (latency while in receive()), aggregates
+bool replay_publish(const char* topic, const uint8_t* payload, uint16_t len, bool retain) {
+	if (strstr(topic, "_rx/") != NULL) {
+		replay.published++;
+		if (in_receive) { replay_latency(&replay.uplink, now - rx_frame_time); }
+	} else if (strstr(topic, "_agg/") != NULL) {
+		replay.aggregates++;
+	}
+	return true;
+}
+
+// downlink passed to the radio: queue time per handle (group message: handle 0)
+void replay_tx(uint8_t dest, uint16_t handle, radio_tx_status_t status, uint8_t* data, uint16_t len) {
+	replay.downlinks++;
+	if (handle != 0 && (status == radio_tx_ACCEPTED || status == radio_tx_HELD)) {
+		handle_time[handle % REPLAY_HANDLES] = now;
+		handle_valid[handle % REPLAY_HANDLES] = true;
+	}
+}
+
+// queue depths per ms
+void replay_sample(void) {
+	for (uint8_t r = 0; r < route.radio_count; r++) {
+		radio_t* radio = &radios[r];
+		uint32_t tx = 0;
+		uint32_t rx = 0;
+		for (uint8_t i = 0; i < radio->buffer_tx_size; i++) { tx += radio->buffer_tx[i].valid; }
+		for (uint8_t i = 0; i < radio->buffer_rx_size; i++) { rx += radio->buffer_rx[i].valid; }
+		replay.tx_depth_sum[r] += tx;
+		replay.rx_depth_sum[r] += rx;
+		if (tx > replay.tx_depth_max[r]) { replay.tx_depth_max[r] = tx; }
+	}
+	replay.samples++;
+}
+
+// nothing to do until the next record
+bool replay_idle(void) {
+	if (!route_buffer_empty_tx(&route) || bridge.bulk_blob != NULL) { return false; }
+	for (uint8_t r = 0; r < route.radio_count; r++) {
+		radio_t* radio = &radios[r];
+		if (rfm[r].valid || radio->tx_wait || radio->beacon.enabled || !radio_buffer_empty_rx(radio)) { return false; }
+	}
+	return true;
+}
+
+void replay_latency(replay_latency_t* latency, uint32_t value) {
+	uint8_t bin = 0;
+	while (bin < REPLAY_LATENCY_BINS - 1 && value >= (1UL << bin)) { bin++; }
+	latency->bins[bin]++;
+	latency->count++;
+	latency->sum += value;
+	if (value > latency->max) { latency->max = value; }
+}
+
+// "uplink      n 120  avg 3 ms  max 45 ms  p50 < 4 ms  p99 < 64 ms"
+void replay_print_latency(const char* name, replay_latency_t* latency) {
+	uint32_t p50 = 0;
+	uint32_t p99 = 0;
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < REPLAY_LATENCY_BINS; i++) {
+		sum += latency->bins[i];
+		if (!p50 && sum * 2 >= latency->count) { p50 = 1UL << i; }
+		if (!p99 && sum * 100 >= latency->count * 99) { p99 = 1UL << i; }
+	}
+	printf("  %-10s n %u  avg %.1f ms  max %u ms  p50 < %u ms  p99 < %u ms\n", name, latency->count,
+	       latency->count ? (double)latency->sum / latency->count : 0.0, latency->max, p50, p99);
+}
+
+void replay_report(capture_reader_t* reader) {
+	static const char* status_names[radio_tx_COUNT] = {
+		"accepted", "held", "delivered", "failed", "replaced", "merged", "rejected_full", "rejected_limit", "rejected", "forwarded"
+	};
+	printf("trace: %u blocks (%u damaged, %u bytes skipped), %.1f s, base 0x%02x, %u radio(s)\n", reader->blocks,
+	       reader->blocks_damaged, reader->bytes_skipped, (replay.time_last - replay.time_first) / 1000.0, base_address, route.radio_count);
+	printf("  records   rx %u  tx %u  ack %u  mqtt_in %u  mqtt_out %u\n", replay.records[capture_RX], replay.records[capture_TX],
+	       replay.records[capture_ACK], replay.records[capture_MQTT_IN], replay.records[capture_MQTT_OUT]);
+	printf("frames: rx %u  lost (transceiver busy) %u | tx %u (trace %u)  acks sent %u (trace %u)\n",
+	       replay.rx_frames, replay.rx_overruns, replay.tx_frames, replay.trace_tx_frames, replay.acks_sent, replay.trace_acks_sent);
+	printf("uplinks: published %u (mqtt_out in trace %u)  suppressed %u  aggregates %u\n", replay.published,
+	       replay.records[capture_MQTT_OUT], edge.messages_suppressed, replay.aggregates);
+	printf("downlinks: %u |", replay.downlinks);
+	for (uint8_t i = 0; i < radio_tx_COUNT; i++) {
+		if (replay.tx_status[i]) { printf(" %s %u", status_names[i], replay.tx_status[i]); }
+	}
+	printf("\n");
+	printf("queues:\n");
+	for (uint8_t r = 0; r < route.radio_count; r++) {
+		printf("  radio %u   tx avg %.2f max %u (high water %u / %u)  rx avg %.2f (high water %u / %u)\n", r,
+		       replay.samples ? (double)replay.tx_depth_sum[r] / replay.samples : 0.0, replay.tx_depth_max[r],
+		       radios[r].buffer_tx_high_water, radios[r].buffer_tx_size,
+		       replay.samples ? (double)replay.rx_depth_sum[r] / replay.samples : 0.0,
+		       radios[r].buffer_rx_high_water, radios[r].buffer_rx_size);
+	}
+	printf("drops: rx lost %u  rx buffer full %u  tx buffer full %u  rejected %u  failed %u  ram %u\n", replay.rx_overruns,
+	       replay.errors[radio_error_RX_BUFFER_FULL], replay.errors[radio_error_TX_BUFFER_FULL],
+	       replay.tx_status[radio_tx_REJECTED_FULL] + replay.tx_status[radio_tx_REJECTED_LIMIT] + replay.tx_status[radio_tx_REJECTED],
+	       replay.tx_status[radio_tx_FAILED], replay.errors[radio_error_RAM_FULL]);
+	printf("latency:\n");
+	replay_print_latency("rx wait", &replay.rx_wait);
+	replay_print_latency("uplink", &replay.uplink);
+	replay_print_latency("downlink", &replay.downlink);
+
+	// same payload as "base_0x01_stats/base"
+	char payload[STATS_MAX_PAYLOAD_SIZE];
+	stats_update(&stats, now);
+	if (stats_format_base(&stats, &route, &sched, payload, sizeof(payload))) {
+		printf("base: %s\n", payload);
+	}
+}
+
+// receive() of the firmware
+void receive(uint8_t source, uint8_t* data, uint16_t len) {
+	in_receive = true;
+	bridge_receive(&bridge, source, data, len, now);
+	in_receive = false;
+}
+
+// counted, queued for "base_0x01_tx_status/..." like in the firmware
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	bridge_tx_status(&bridge, dest, handle, status);
+	if (status >= radio_tx_COUNT) { return; }
+	replay.tx_status[status]++;
+	if ((status == radio_tx_DELIVERED || status == radio_tx_FAILED) && handle_valid[handle % REPLAY_HANDLES]) {
+		handle_valid[handle % REPLAY_HANDLES] = false;
+		replay_latency(&replay.downlink, now - handle_time[handle % REPLAY_HANDLES]);
+	}
+}
+
+void error_handler(radio_error_code_t error) {
+	stats_add_error(&stats, error);
+	if (error < radio_error_COUNT) { replay.errors[error]++; }
+}
+
+void publish_aggregate(uint8_t node, char* data, uint16_t len) {
+	bridge_publish_aggregate(&bridge, node, data, len);
+}
+
+uint16_t bulk_read(uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len) {
+	return bridge_bulk_read(&bridge, dest, transfer_id, offset, data, len);
+}
+
+// paused transfers are resumed every BULK_RESUME_INTERVAL_MS
+void bulk_done(uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset) {
+	bridge_bulk_done(&bridge, address, transfer_id, status, offset);
+}
+
+uint32_t replay_millis(void) {
+	return now;
+}
+
+uint32_t replay_micros(void) {
+	return now * 1000;
+}
+
+// blocking delays of the radio lib take trace time
+void replay_delay(uint32_t ms) {
+	now = now + ms;
+}
+
+
+/* Transceiver functions (radio.h, RADIO_RFM_STATIC) --------------------------------------------*/
+
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	replay.tx_frames++;
+	return 0;
+}
+
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+	replay_rfm_t* r = &rfm[route_index(&route, obj)];
+	*src = r->source;
+	*len = r->len;
+	memcpy(data, r->data, r->len);
+	r->valid = false;
+	radio_node_set_rssi(obj, r->source, r->rssi);
+	route_rx(&route, obj, r->source, r->rssi, now);
+	replay.rx_frames++;
+	replay_latency(&replay.rx_wait, now - r->time);
+	rx_frame_time = r->time;
+	return 0;
+}
+
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	replay.acks_sent++;
+	return 0;
+}
+
+// ACK records of the trace
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+	replay_rfm_t* r = &rfm[route_index(&route, obj)];
+	if (r->acks[dest] == 0) { return 0; }
+	r->acks[dest]--;
+	return 1;
+}
+
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+	replay_rfm_t* r = &rfm[route_index(&route, obj)];
+	return (r->flags & CAPTURE_FLAG_ACK_REQUESTED) && route_ack(&route, obj, src);
+}
+
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+	return rfm[route_index(&route, obj)].valid;
+}
+
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+	return 1;
+}
@@ -0,0 +1,574 @@
+/////////////////////////////////////////////////////
+// FILENAME:    sim_channel.c                      //
+// DESCRIPTION: host simulation of a star network  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+// Simulation of a base station (0x01) and N nodes (0x10 + n) that do not hear each other (hidden nodes) on a host,
+// to compare the random access (ALOHA) with the beacon mode (TDMA slots), the link adaptation and the retry policies:
+// - traffic: every node reports SIM_REPORT_LEN bytes at its own interval (random in [min, max], whole seconds),
+//   the base sends a SIM_DOWNLINK_LEN byte message to a random node every SIM_DOWNLINK_INTERVAL ms
+// - air: airtime from the length and the bitrate step of the sender, frames to the base that overlap another frame
+//   are lost (collision, the base does not receive while it transmits), a node does not receive while it transmits
+// - path: RSSI per node between -50 and -92 dBm (or the given range) at full power, minus the power reduction,
+//   +-3 dB fading per frame,
+//   a frame is received if the receiver is on the same bitrate step and the RSSI is above the sensitivity of the step
+// - outage: the base is off (no loop, frames lost) for the given time from SIM_OUTAGE_START (link fallback)
+// - retry policy of the nodes: adaptive (ACK timeout from the RTT, retries from the time budget, jittered exponential
+//   backoff, the defaults of radio_config.h) or fixed (SIM_FIXED_TIMEOUT ms, SIM_FIXED_ATTEMPTS, retry at once)
+// - statistics after SIM_WARMUP ms (reports queued after it): delivery, collisions, latency, goodput, channel
+//   utilisation, TX energy of the nodes per delivered report (airtime * power), frames per bitrate step,
+//   delivery, retries and airtime per report of the nodes by distance (path RSSI near / mid / far)
+// - group messages (optional): every SIM_GROUP_INTERVAL ms a SIM_GROUP_LEN byte message to the group 0x10 (nodes
+//   0x10..0x1F), without or with group ACKs and unicast repair (GROUP_COLLECT_ACKS of the firmware): members reached,
+//   latency from the queue until the last member has it (broadcast or repair), until the base is done with it
+//   (radio_group_stats_t: all confirmed, without ACKs: sent), repairs per message
+// The node table of the base holds RADIO_NODE_TABLE_SIZE nodes, larger networks need a larger table (radio_config.h).
+//
+// build (from BaseStation_PlatformIO):
+//   gcc -O2 -std=gnu99 -Iinclude -o sim_channel tools/sim_channel.c src/radio.c src/radio_lz.c src/heap.c -lm
+// usage:
+//   ./sim_channel [nodes] [beacon (0/1)] [link adaptation (0/1)] [min interval (ms)] [max interval (ms)]
+//                 [duration (s)] [outage (ms)] [retry policy (0 = adaptive, 1 = fixed)] [RSSI range (dB)]
+//                 [group messages (0 = none, 1 = without ACKs, 2 = group ACKs)]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "radio.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define SIM_NODES_MAX         RADIO_NODE_TABLE_SIZE
+#define SIM_SEED              7
+#define SIM_WARMUP            300000    // ms before the statistics
+#define SIM_REPORT_LEN        30
+#define SIM_DOWNLINK_LEN      12
+#define SIM_DOWNLINK_INTERVAL 2000
+#define SIM_ACK_DELAY         5         // frame end -> start of the ACK (ms)
+#define SIM_OUTAGE_START      900000
+#define SIM_AIR_SIZE          4096      // frames on air and not yet delivered
+#define SIM_QUEUE_SIZE        64        // frames received and not yet read per instance (power of 2)
+#define SIM_RSSI_MAX          -50
+#define SIM_RSSI_RANGE        43        // dB, path RSSI -50 .. -92 dBm (default)
+#define SIM_FADING            6.0       // dB, peak to peak
+#define SIM_BANDS             3         // distance bands: thirds of the RSSI range (near / mid / far)
+#define SIM_FIXED_TIMEOUT     200       // fixed retry policy (the lib before the RTT estimation): ACK timeout (ms),
+#define SIM_FIXED_ATTEMPTS    3         // transmissions per frame, no backoff
+#define SIM_GROUP             0x10      // group of the group messages
+#define SIM_GROUP_LEN         12
+#define SIM_GROUP_INTERVAL    10000
+#define SIM_GROUP_MARK        'g'       // byte 4 of a group message (behind the queue time)
+
+
+/* Private typedef ------------------------------------------------------------------------------*/
+
+typedef struct {
+	uint32_t start;
+	uint32_t end;
+	uint8_t  from;                      // instance (0 = base)
+	uint8_t  dest;
+	uint8_t  len;
+	uint8_t  data[RADIO_FRAME_SIZE_MAX];
+	uint8_t  rate;
+	int8_t   power;
+	bool     ack;
+	bool     collided;
+	bool     done;
+} sim_air_t;
+
+typedef struct {
+	uint8_t  source;
+	uint8_t  len;
+	uint8_t  data[RADIO_FRAME_SIZE_MAX];
+	int16_t  rssi;
+	bool     broadcast;
+} sim_frame_t;
+
+typedef struct {
+	sim_frame_t frames[SIM_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t tail;
+	bool     broadcast;                 // last frame read (no ACK)
+	bool     ack;                       // ACK of the last frame received
+	uint32_t busy_until;                // transmitting
+} sim_rx_t;
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+static uint32_t now = 0;
+static uint16_t node_count;
+static radio_t inst[SIM_NODES_MAX + 1];
+static radio_geometry_t geometry[SIM_NODES_MAX + 1];
+static sim_rx_t rx[SIM_NODES_MAX + 1];
+static sim_air_t air[SIM_AIR_SIZE];
+static uint16_t air_count = 0;
+static double rssi_full[SIM_NODES_MAX + 1];
+static uint8_t band[SIM_NODES_MAX + 1];
+static uint8_t band_width;              // dB
+static const uint32_t bitrates[RADIO_LINK_STEPS] = RADIO_LINK_BITRATES;
+static const int8_t sensitivity[RADIO_LINK_STEPS] = RADIO_LINK_SENSITIVITY;
+
+// statistics
+static uint32_t up_generated, up_received, up_bytes, up_frames, up_collided, up_weak;
+static uint64_t up_latency_sum;
+static uint32_t down_generated;
+static uint32_t frames_by_rate[RADIO_LINK_STEPS];
+static double air_us;                   // channel time
+static double node_energy;              // mJ
+static uint32_t tx_status_count[radio_tx_COUNT];
+static uint32_t errors[radio_error_COUNT];
+static uint32_t band_nodes[SIM_BANDS], band_generated[SIM_BANDS], band_received[SIM_BANDS];
+static uint32_t band_retries[SIM_BANDS];
+static double band_air_us[SIM_BANDS];
+static uint32_t retries_start[SIM_NODES_MAX + 1];
+static uint16_t loop_instance;          // instance in radio_loop() (receive callbacks)
+
+// group message: the running one (members received it), statistics of the finished ones
+static uint16_t group_members;          // bit = address & 0x0F
+static uint16_t group_received;
+static uint32_t group_time;             // queued, 0 = none running
+static uint32_t group_time_last;        // last member received it
+static uint32_t group_sent, group_complete, group_reached;
+static uint64_t group_latency_sum;
+static uint32_t group_latency_max;
+static uint32_t group_repairs_start;
+static uint32_t group_finished;         // base: confirmed (or repair failed) before the next one
+static uint64_t group_finished_sum;
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+void     sim_geometry    (radio_geometry_t* g, uint8_t rx_size, uint8_t tx_size);
+uint32_t sim_airtime_us  (uint8_t len, uint8_t rate);
+void     sim_put         (uint8_t from, uint8_t dest, uint8_t* data, uint8_t len, bool ack, uint32_t start);
+bool     sim_heard       (sim_air_t* a, uint8_t receiver, uint8_t node, int16_t* rssi);
+void     sim_deliver     (void);
+void     sim_reset       (void);
+uint32_t sim_retries     (uint16_t k);
+void     sim_group_done  (void);
+void     receive_base    (uint8_t source, uint8_t* data, uint16_t len);
+void     receive_node    (uint8_t source, uint8_t* data, uint16_t len);
+void     tx_status       (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+void     error_handler   (radio_error_code_t error);
+void     sim_delay       (uint32_t ms);
+uint32_t sim_millis      (void);
+
+
+/* Main -----------------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+	node_count = (argc > 1) ? atoi(argv[1]) : 30;
+	bool beacon = (argc > 2) ? atoi(argv[2]) : false;
+	bool link = (argc > 3) ? atoi(argv[3]) : false;
+	uint32_t interval_min = (argc > 4) ? strtoul(argv[4], NULL, 0) : 10000;
+	uint32_t interval_max = (argc > 5) ? strtoul(argv[5], NULL, 0) : 60000;
+	uint32_t duration = ((argc > 6) ? strtoul(argv[6], NULL, 0) : 1800) * 1000;
+	uint32_t outage = (argc > 7) ? strtoul(argv[7], NULL, 0) : 0;
+	bool fixed = (argc > 8) ? atoi(argv[8]) : false;
+	uint8_t rssi_range = (argc > 9) ? atoi(argv[9]) : SIM_RSSI_RANGE;
+	uint8_t group = (argc > 10) ? atoi(argv[10]) : 0;
+	if (node_count < 1 || node_count > SIM_NODES_MAX) {
+		printf("1..%u nodes (RADIO_NODE_TABLE_SIZE)\n", SIM_NODES_MAX);
+		return 1;
+	}
+	if (interval_max < interval_min || interval_min < 1000 || duration <= SIM_WARMUP) {
+		printf("min interval >= 1000 ms, max interval >= min interval, duration > %u s\n", SIM_WARMUP / 1000);
+		return 1;
+	}
+	if (rssi_range < SIM_BANDS || rssi_range > 60) {
+		printf("RSSI range %u..60 dB\n", SIM_BANDS);
+		return 1;
+	}
+	if (group > 2) {
+		printf("group messages 0 = none, 1 = without ACKs, 2 = group ACKs\n");
+		return 1;
+	}
+	band_width = (uint8_t)((rssi_range + SIM_BANDS - 1) / SIM_BANDS);
+	srand(SIM_SEED);
+
+	sim_geometry(&geometry[0], 50, 50);
+	radio_init(&inst[0], 0x01, &geometry[0]);
+	radio_set_cb_func(&inst[0], receive_base, sim_delay, error_handler, sim_millis);
+	radio_set_cb_tx_status(&inst[0], (void*)tx_status);
+	radio_beacon_enable(&inst[0], beacon);
+	radio_link_enable(&inst[0], link);
+	uint32_t interval[SIM_NODES_MAX + 1];
+	uint32_t next[SIM_NODES_MAX + 1];
+	for (uint16_t k = 1; k <= node_count; k++) {
+		sim_geometry(&geometry[k], 4, 8);
+		radio_init(&inst[k], (uint8_t)(0x0F + k), &geometry[k]);
+		radio_set_cb_func(&inst[k], receive_node, sim_delay, error_handler, sim_millis);
+		interval[k] = interval_min + (uint32_t)(rand() % (interval_max - interval_min + 1));
+		interval[k] = interval[k] / 1000 * 1000;
+		next[k] = rand() % interval[k];
+		rssi_full[k] = SIM_RSSI_MAX - (rand() % rssi_range);
+		band[k] = (uint8_t)((SIM_RSSI_MAX - rssi_full[k]) / band_width);
+		band_nodes[band[k]]++;
+		if ((inst[k].address & 0xF0) == SIM_GROUP) { group_members |= (uint16_t)(1 << (inst[k].address & 0x0F)); }
+		if (fixed) {
+			radio_retry_t policy = inst[k].retry;
+			policy.ack_timeout_init = SIM_FIXED_TIMEOUT;
+			policy.ack_timeout_min = SIM_FIXED_TIMEOUT;
+			policy.ack_timeout_max = SIM_FIXED_TIMEOUT;
+			policy.retries_min = SIM_FIXED_ATTEMPTS;
+			policy.retries_max = SIM_FIXED_ATTEMPTS;
+			policy.backoff_time = 0;
+			radio_set_retry_policy(&inst[k], &policy);
+		}
+	}
+
+	uint8_t data[RADIO_FRAME_SIZE_MAX];
+	memset(data, 'x', sizeof(data));
+	uint32_t next_downlink = 5000;
+	uint32_t next_group = SIM_GROUP_INTERVAL;
+	uint8_t group_data[SIM_GROUP_LEN];
+	memset(group_data, 'x', sizeof(group_data));
+	for (now = 0; now < duration; now++) {
+		if (now == SIM_WARMUP) { sim_reset(); }
+
+		// reports and downlinks, the payload starts with the queue time
+		for (uint16_t k = 1; k <= node_count; k++) {
+			if (now < next[k]) { continue; }
+			next[k] += interval[k];
+			memcpy(data, &now, sizeof(now));
+			radio_transmit(&inst[k], 0x01, data, SIM_REPORT_LEN, NULL);
+			up_generated++;
+			band_generated[band[k]]++;
+		}
+		if (now >= next_downlink) {
+			next_downlink += SIM_DOWNLINK_INTERVAL;
+			memcpy(data, &now, sizeof(now));
+			radio_transmit(&inst[0], (uint8_t)(0x10 + rand() % node_count), data, SIM_DOWNLINK_LEN, NULL);
+			down_generated++;
+		}
+		if (group && now >= next_group) {
+			next_group += SIM_GROUP_INTERVAL;
+			sim_group_done();
+			memcpy(group_data, &now, sizeof(now));
+			group_data[4] = SIM_GROUP_MARK;
+			if (radio_group_transmit(&inst[0], SIM_GROUP, group_data, SIM_GROUP_LEN, group == 2)) {
+				group_time = now;
+				group_received = 0;
+			}
+		}
+
+		sim_deliver();
+		for (uint16_t k = 0; k <= node_count; k++) {
+			if (k == 0 && outage && now >= SIM_OUTAGE_START && now < SIM_OUTAGE_START + outage) {
+				rx[0].head = rx[0].tail;
+				continue;
+			}
+			loop_instance = k;
+			radio_loop(&inst[k]);
+		}
+	}
+	sim_group_done();
+
+	double secs = (duration - SIM_WARMUP) / 1000.0;
+	uint32_t fallbacks = 0;
+	uint32_t fast = 0;
+	double power = 0;
+	for (uint16_t k = 1; k <= node_count; k++) {
+		band_retries[band[k]] += sim_retries(k) - retries_start[k];
+		fallbacks += inst[k].link_fallbacks;
+		radio_node_t* node = radio_node_find(&inst[0], inst[k].address);
+		if (node) {
+			power += node->link_power;
+			fast += node->link_rate > 0;
+		}
+	}
+	printf("%s%s, %s retry policy, %u nodes, reports every %lu..%lu s, %.0f s\n", beacon ? "TDMA" : "ALOHA",
+	       link ? " + link adaptation" : "", fixed ? "fixed" : "adaptive",
+	       node_count, (unsigned long)(interval_min / 1000), (unsigned long)(interval_max / 1000), secs);
+	printf("uplink:   %lu reports, delivered %.1f %%, %.2f frames per report, collided %.1f %%, too weak %.1f %%, "
+	       "latency %.0f ms, goodput %.0f B/s\n",
+	       (unsigned long)up_generated, up_generated ? 100.0 * up_received / up_generated : 0,
+	       up_received ? (double)up_frames / up_received : 0,
+	       up_frames ? 100.0 * up_collided / up_frames : 0, up_frames ? 100.0 * up_weak / up_frames : 0,
+	       up_received ? (double)up_latency_sum / up_received : 0, up_bytes / secs);
+	printf("downlink: %lu messages, delivered %lu, failed %lu\n", (unsigned long)down_generated,
+	       (unsigned long)tx_status_count[radio_tx_DELIVERED], (unsigned long)tx_status_count[radio_tx_FAILED]);
+	printf("channel:  utilisation %.2f %%, node TX energy %.2f mJ per report, frames per step %lu / %lu / %lu\n",
+	       air_us / 1e4 / secs, up_received ? node_energy / up_received : 0,
+	       (unsigned long)frames_by_rate[0], (unsigned long)frames_by_rate[1], (unsigned long)frames_by_rate[2]);
+	printf("link:     nodes on a faster step %lu, avg power %.1f dBm, changes %lu, fallbacks base %lu / nodes %lu\n",
+	       (unsigned long)fast, power / node_count, (unsigned long)inst[0].link_changes,
+	       (unsigned long)inst[0].link_fallbacks, (unsigned long)fallbacks);
+	for (uint8_t b = 0; b < SIM_BANDS; b++) {
+		if (band_nodes[b] == 0) { continue; }
+		printf("distance: %s (%d..%d dBm) %lu nodes, delivered %.1f %%, retries %.2f per report, airtime %.2f ms per report\n",
+		       (b == 0) ? "near" : (b == 1) ? "mid " : "far ", SIM_RSSI_MAX - b * band_width,
+		       (b == SIM_BANDS - 1) ? SIM_RSSI_MAX - rssi_range + 1 : SIM_RSSI_MAX - (b + 1) * band_width + 1,
+		       (unsigned long)band_nodes[b],
+		       band_generated[b] ? 100.0 * band_received[b] / band_generated[b] : 0,
+		       band_received[b] ? (double)band_retries[b] / band_received[b] : 0,
+		       band_received[b] ? band_air_us[b] / 1000.0 / band_received[b] : 0);
+	}
+	if (group) {
+		uint8_t members = (uint8_t)__builtin_popcount(group_members);
+		printf("group:    %lu messages to %u members %s, reached all %.1f %%, members reached %.1f %%, "
+		       "latency %.0f ms (max %lu), done at the base %.0f ms, repairs %.2f per message\n",
+		       (unsigned long)group_sent, members, (group == 2) ? "with group ACKs" : "without ACKs",
+		       group_sent ? 100.0 * group_complete / group_sent : 0,
+		       group_sent && members ? 100.0 * group_reached / group_sent / members : 0,
+		       group_complete ? (double)group_latency_sum / group_complete : 0, (unsigned long)group_latency_max,
+		       group_finished ? (double)group_finished_sum / group_finished : 0,
+		       group_sent ? (double)(inst[0].group_stats.repairs - group_repairs_start) / group_sent : 0);
+	}
+	return 0;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// buffers of the instances (the number of nodes is known at run time)
+void sim_geometry(radio_geometry_t* g, uint8_t rx_size, uint8_t tx_size) {
+	g->buffer_rx = calloc(rx_size, sizeof(radio_message_t));
+	g->buffer_tx = calloc(tx_size, sizeof(radio_message_t));
+	g->rx_frames = calloc(rx_size, RADIO_FRAME_SIZE_MAX);
+	g->rx_frame_map = calloc(RADIO_RX_FRAME_MAP_WORDS(rx_size), sizeof(uint32_t));
+	g->buffer_rx_size = rx_size;
+	g->buffer_tx_size = tx_size;
+	g->frame_size = 61;
+}
+
+// preamble, sync word, length, address and CRC: 11 bytes
+uint32_t sim_airtime_us(uint8_t len, uint8_t rate) {
+	return (uint32_t)((11 + len) * 8 * 1000000ULL / bitrates[rate]);
+}
+
+void sim_put(uint8_t from, uint8_t dest, uint8_t* data, uint8_t len, bool ack, uint32_t start) {
+	sim_air_t* a = NULL;
+	for (uint16_t i = 0; i < air_count; i++) {
+		if (air[i].done) {
+			a = &air[i];
+			break;
+		}
+	}
+	if (a == NULL) {
+		if (air_count >= SIM_AIR_SIZE) {
+			printf("air full\n");
+			exit(1);
+		}
+		a = &air[air_count++];
+	}
+	memset(a, 0, sizeof(*a));
+	a->from = from;
+	a->dest = dest;
+	a->start = start;
+	a->ack = ack;
+	a->rate = inst[from].link_rate;
+	a->power = inst[from].link_power;
+	uint32_t us = sim_airtime_us(ack ? 0 : len, a->rate);
+	a->end = start + (us + 999) / 1000;
+	a->len = len;
+	if (len) { memcpy(a->data, data, len); }
+	if (rx[from].busy_until < a->end) { rx[from].busy_until = a->end; }
+
+	if (now > SIM_WARMUP) {
+		air_us += us;
+		if (from) {
+			node_energy += us / 1000.0 * pow(10, a->power / 10.0) / 1000.0;
+			band_air_us[band[from]] += us;
+		}
+	}
+	if (from && !ack) {
+		up_frames++;
+		if (now > SIM_WARMUP) { frames_by_rate[a->rate]++; }
+	}
+
+	// collisions at the base: uplinks with each other, an uplink while the base transmits
+	for (uint16_t i = 0; i < air_count; i++) {
+		sim_air_t* b = &air[i];
+		if (b == a || b->done || b->start >= a->end || a->start >= b->end) { continue; }
+		if (a->from) { a->collided = true; }
+		if (b->from) { b->collided = true; }
+	}
+}
+
+// frame of the path of a node received
+bool sim_heard(sim_air_t* a, uint8_t receiver, uint8_t node, int16_t* rssi) {
+	double r = rssi_full[node] - (RADIO_LINK_POWER_MAX - a->power) + ((rand() % 1000) / 1000.0 - 0.5) * SIM_FADING;
+	*rssi = (int16_t)r;
+	return inst[receiver].link_rate == a->rate && r >= sensitivity[a->rate];
+}
+
+// frames that ended
+void sim_deliver(void) {
+	for (uint16_t i = 0; i < air_count; i++) {
+		sim_air_t* a = &air[i];
+		if (a->done || a->end > now) { continue; }
+		a->done = true;
+		int16_t rssi;
+		if (a->from) {
+			if (a->collided) {
+				if (!a->ack) { up_collided++; }
+				continue;
+			}
+			if (!sim_heard(a, 0, a->from, &rssi)) {
+				if (!a->ack) { up_weak++; }
+				continue;
+			}
+			if (a->ack) {
+				rx[0].ack = true;
+				continue;
+			}
+			sim_rx_t* r = &rx[0];
+			if (r->tail - r->head >= SIM_QUEUE_SIZE) { continue; }
+			sim_frame_t* frame = &r->frames[r->tail++ % SIM_QUEUE_SIZE];
+			frame->source = inst[a->from].address;
+			frame->len = a->len;
+			frame->rssi = rssi;
+			frame->broadcast = false;
+			memcpy(frame->data, a->data, a->len);
+		} else {
+			for (uint16_t j = 1; j <= node_count; j++) {
+				if (a->dest != RADIO_BROADCAST && a->dest - 0x0F != j) { continue; }
+				if (!a->ack && rx[j].busy_until > a->start) { continue; }
+				if (!sim_heard(a, j, j, &rssi)) { continue; }
+				if (a->ack) {
+					rx[j].ack = true;
+					continue;
+				}
+				sim_rx_t* r = &rx[j];
+				if (r->tail - r->head >= SIM_QUEUE_SIZE) { continue; }
+				sim_frame_t* frame = &r->frames[r->tail++ % SIM_QUEUE_SIZE];
+				frame->source = 0x01;
+				frame->len = a->len;
+				frame->rssi = rssi;
+				frame->broadcast = (a->dest == RADIO_BROADCAST);
+				memcpy(frame->data, a->data, a->len);
+			}
+		}
+	}
+}
+
+// statistics after the warm-up
+void sim_reset(void) {
+	up_generated = 0;
+	up_received = 0;
+	up_bytes = 0;
+	up_frames = 0;
+	up_collided = 0;
+	up_weak = 0;
+	up_latency_sum = 0;
+	down_generated = 0;
+	memset(tx_status_count, 0, sizeof(tx_status_count));
+	memset(band_generated, 0, sizeof(band_generated));
+	memset(band_received, 0, sizeof(band_received));
+	for (uint16_t k = 1; k <= node_count; k++) { retries_start[k] = sim_retries(k); }
+	group_repairs_start = inst[0].group_stats.repairs;
+}
+
+// group message replaced by the next one (or end of the run): members reached, latency if all have it
+void sim_group_done(void) {
+	if (group_time <= SIM_WARMUP) { return; }
+	group_sent++;
+	group_reached += __builtin_popcount(group_received);
+	if (inst[0].group_tx.state == radio_group_IDLE) {
+		group_finished++;
+		group_finished_sum += inst[0].group_stats.latency;
+	}
+	if (group_received == group_members) {
+		group_complete++;
+		group_latency_sum += group_time_last - group_time;
+		if (group_time_last - group_time > group_latency_max) { group_latency_max = group_time_last - group_time; }
+	}
+	group_time = 0;
+}
+
+// retries of a node to the base (radio lib statistics)
+uint32_t sim_retries(uint16_t k) {
+	radio_node_t* node = radio_node_find(&inst[k], 0x01);
+	return node ? node->stats.retries : 0;
+}
+
+void receive_base(uint8_t source, uint8_t* data, uint16_t len) {
+	uint32_t time;
+	memcpy(&time, data, sizeof(time));
+	if (time < SIM_WARMUP) { return; }
+	up_received++;
+	band_received[band[source - 0x0F]]++;
+	up_bytes += len;
+	up_latency_sum += now - time;
+}
+
+// group message (broadcast or unicast repair): first copy of the running one per member
+void receive_node(uint8_t source, uint8_t* data, uint16_t len) {
+	uint32_t time;
+	memcpy(&time, data, sizeof(time));
+	uint16_t bit = (uint16_t)(1 << (inst[loop_instance].address & 0x0F));
+	if (len != SIM_GROUP_LEN || data[4] != SIM_GROUP_MARK || time != group_time || !(group_members & bit)) { return; }
+	if (group_received & bit) { return; }
+	group_received |= bit;
+	group_time_last = now;
+}
+
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	tx_status_count[status]++;
+}
+
+void error_handler(radio_error_code_t error) {
+	errors[error]++;
+}
+
+// blocking delays of the radio lib are not simulated
+void sim_delay(uint32_t ms) {
+}
+
+uint32_t sim_millis(void) {
+	return now;
+}
+
+
+/* Transceiver functions (radio.h, RADIO_RFM_STATIC) --------------------------------------------*/
+
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	uint8_t k = (uint8_t)(obj - inst);
+	rx[k].ack = false;
+	sim_put(k, dest, data, len, false, now);
+	return 0;
+}
+
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+	sim_rx_t* r = &rx[obj - inst];
+	sim_frame_t* frame = &r->frames[r->head++ % SIM_QUEUE_SIZE];
+	*src = frame->source;
+	*len = frame->len;
+	memcpy(data, frame->data, frame->len);
+	r->broadcast = frame->broadcast;
+	radio_node_set_rssi(obj, frame->source, frame->rssi);
+	return 0;
+}
+
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	sim_put((uint8_t)(obj - inst), dest, data, len, true, now + SIM_ACK_DELAY);
+	return 0;
+}
+
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+	sim_rx_t* r = &rx[obj - inst];
+	if (!r->ack) { return 0; }
+	r->ack = false;
+	return 1;
+}
+
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+	return !rx[obj - inst].broadcast;
+}
+
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+	sim_rx_t* r = &rx[obj - inst];
+	return r->head != r->tail;
+}
+
+// profile of the transceiver: link_rate / link_power of the instance
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+	return 1;
+}
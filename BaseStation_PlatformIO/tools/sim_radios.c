@@ -0,0 +1,293 @@
+/////////////////////////////////////////////////////
+// FILENAME:    sim_radios.c                       //
+// DESCRIPTION: host simulation of two base radios //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+// Simulation of a base station with one or two transceivers (route.h) and two nodes on a host:
+// - node 0x11 is heard by both base radios (radio 1 better), node 0x21 only by radio 0
+// - air: every frame reaches the radios with a link to the sender, SIM_LOSS_PCT of the frames and ACKs are lost,
+//   an ACK arrives SIM_ACK_MS after the frame was read, no collisions
+// - uplinks: each node sends SIM_UPLINKS messages, heard twice by the base if both radios have a link
+//   (passed on once, ACKed by the radio of the node only)
+// - downlinks: messages to both nodes at the same time, then a burst without losses (time with both radios in
+//   flight), then radio 0 gets better for 0x11 (route switch, sequence numbers continued)
+//
+// build (from BaseStation_PlatformIO):
+//   gcc -O2 -std=gnu99 -Iinclude -o sim_radios tools/sim_radios.c src/route.c src/radio.c src/radio_lz.c src/heap.c
+// usage:
+//   ./sim_radios [radios (1 or 2)]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "radio.h"
+#include "route.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define SIM_LOSS_PCT          5
+#define SIM_ACK_MS            20        // frame read -> ACK at the sender
+#define SIM_UPLINKS           200       // per node
+#define SIM_DOWNLINKS         100       // per node
+#define SIM_BURST             15        // per node, queued at once
+#define SIM_QUEUE_SIZE        256       // frames on air per receiver (power of 2)
+#define SIM_INSTANCES         4         // base radio 0, base radio 1, node 0x11, node 0x21
+#define SIM_NO_LINK           -200
+
+
+/* Private typedef ------------------------------------------------------------------------------*/
+
+typedef struct {
+	uint8_t source;
+	uint8_t len;
+	uint8_t data[RADIO_FRAME_SIZE_MAX];
+	uint8_t from;                       // instance
+	int16_t rssi;
+} sim_frame_t;
+
+typedef struct {
+	sim_frame_t frames[SIM_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t tail;
+	uint8_t  last_from;                 // sender of the last frame read (ACK)
+	uint32_t ack_time;                  // ACK of the last frame of the instance arrives, 0 = none
+	uint32_t acks_sent;
+} sim_air_t;
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+static uint32_t now = 1;
+static radio_t base[ROUTE_MAX_RADIOS];
+static radio_t nodes[2];
+static route_t route;
+static sim_air_t air[SIM_INSTANCES];
+static uint8_t loss_pct = SIM_LOSS_PCT;
+static int16_t link_rssi[ROUTE_MAX_RADIOS][2] = { { -80, -55 }, { -60, SIM_NO_LINK } };   // [base radio][node]
+static const uint8_t node_address[2] = { 0x11, 0x21 };
+static uint32_t delivered[2];           // uplinks passed on by the route
+static uint32_t node_received[2];
+static uint32_t tx_status_count[radio_tx_COUNT];
+static uint32_t steps_in_flight = 0;    // any / both base radios waiting for an ACK
+static uint32_t steps_both = 0;
+RADIO_DEFINE_GEOMETRY(geometry_base0, 25, 25, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry_base1, 25, 25, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry_node0, 25, 25, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry_node1, 25, 25, RADIO_FRAME_SIZE_MAX);
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t  sim_index       (radio_t* obj);
+void     sim_put         (uint8_t k, uint8_t from, uint8_t source, uint8_t* data, uint8_t len, int16_t rssi);
+void     sim_step        (void);
+void     receive_base    (uint8_t source, uint8_t* data, uint16_t len);
+void     receive_node0   (uint8_t source, uint8_t* data, uint16_t len);
+void     receive_node1   (uint8_t source, uint8_t* data, uint16_t len);
+void     tx_status       (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+void     error_handler   (radio_error_code_t error);
+void     sim_delay       (uint32_t ms);
+uint32_t sim_millis      (void);
+
+
+/* Main -----------------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+	uint8_t radios = (argc > 1 && atoi(argv[1]) == 1) ? 1 : 2;
+	if (radios == 1) { link_rssi[1][0] = SIM_NO_LINK; }
+
+	const radio_geometry_t* geometry[SIM_INSTANCES] = { &geometry_base0, &geometry_base1, &geometry_node0, &geometry_node1 };
+	for (uint8_t i = 0; i < ROUTE_MAX_RADIOS; i++) {
+		radio_init(&base[i], 0x01, geometry[i]);
+		radio_set_cb_func(&base[i], receive_base, sim_delay, error_handler, sim_millis);
+		radio_set_cb_tx_status(&base[i], (void*)tx_status);
+	}
+	radio_init(&nodes[0], node_address[0], geometry[2]);
+	radio_set_cb_func(&nodes[0], receive_node0, sim_delay, error_handler, sim_millis);
+	radio_init(&nodes[1], node_address[1], geometry[3]);
+	radio_set_cb_func(&nodes[1], receive_node1, sim_delay, error_handler, sim_millis);
+	route_init(&route, base, radios);
+
+	// uplinks
+	uint8_t uplink[] = "{\"t\":21.5}";
+	for (uint16_t i = 0; i < SIM_UPLINKS; i++) {
+		radio_transmit(&nodes[0], 0x01, uplink, sizeof(uplink) - 1, NULL);
+		radio_transmit(&nodes[1], 0x01, uplink, sizeof(uplink) - 1, NULL);
+		for (uint8_t j = 0; j < 30; j++) { sim_step(); }
+	}
+	for (uint16_t j = 0; j < 5000; j++) { sim_step(); }
+	route_node_t* route0 = route_node_find(&route, node_address[0]);
+	route_node_t* route1 = route_node_find(&route, node_address[1]);
+	printf("radios %u, loss %u%%, ACK %u ms\n", radios, loss_pct, SIM_ACK_MS);
+	printf("uplink:   passed on 0x11 %lu / 0x21 %lu of %u, duplicates suppressed %lu, route 0x11 -> %d, 0x21 -> %d, "
+	       "ACKs radio 0 %lu / radio 1 %lu\n",
+	       (unsigned long)delivered[0], (unsigned long)delivered[1], SIM_UPLINKS, (unsigned long)route.duplicates,
+	       route0 ? route0->radio : -1, route1 ? route1->radio : -1,
+	       (unsigned long)air[0].acks_sent, (unsigned long)air[1].acks_sent);
+
+	// downlinks to both nodes
+	uint8_t downlink[100];
+	memset(downlink, 'x', sizeof(downlink));
+	uint32_t time_start = now;
+	for (uint16_t i = 0; i < SIM_DOWNLINKS; i++) {
+		route_transmit(&route, node_address[0], downlink, 40 + (i % 3), NULL);
+		route_transmit(&route, node_address[1], downlink, 40 + (i % 3), NULL);
+		for (uint8_t j = 0; j < 12; j++) { sim_step(); }
+	}
+	while (!route_buffer_empty_tx(&route) && now - time_start < 1000000) { sim_step(); }
+	printf("downlink: received 0x11 %lu / 0x21 %lu of %u in %lu ms, delivered %lu, failed %lu, rejected %lu\n",
+	       (unsigned long)node_received[0], (unsigned long)node_received[1], SIM_DOWNLINKS, (unsigned long)(now - time_start),
+	       (unsigned long)tx_status_count[radio_tx_DELIVERED], (unsigned long)tx_status_count[radio_tx_FAILED],
+	       (unsigned long)(tx_status_count[radio_tx_REJECTED_FULL] + tx_status_count[radio_tx_REJECTED_LIMIT] +
+	                       tx_status_count[radio_tx_REJECTED]));
+
+	// burst without losses: both radios in flight
+	loss_pct = 0;
+	steps_in_flight = 0;
+	steps_both = 0;
+	time_start = now;
+	for (uint8_t i = 0; i < SIM_BURST; i++) {
+		route_transmit(&route, node_address[0], downlink, 50, NULL);
+		route_transmit(&route, node_address[1], downlink, 50, NULL);
+	}
+	while (!route_buffer_empty_tx(&route)) { sim_step(); }
+	printf("burst:    2 x %u messages in %lu ms, in flight %lu ms, both radios %lu ms\n", SIM_BURST,
+	       (unsigned long)(now - time_start), (unsigned long)steps_in_flight, (unsigned long)steps_both);
+
+	// radio 0 becomes better for 0x11: route switch
+	if (radios > 1) {
+		link_rssi[0][0] = -50;
+		for (uint8_t i = 0; i < 20; i++) {
+			radio_transmit(&nodes[0], 0x01, uplink, sizeof(uplink) - 1, NULL);
+			for (uint8_t j = 0; j < 30; j++) { sim_step(); }
+		}
+		printf("switch:   route 0x11 -> %d, switches %lu, sequence number radio 0 %u / radio 1 %u\n",
+		       route0 ? route0->radio : -1, (unsigned long)route.switches,
+		       radio_node_find(&base[0], node_address[0])->seq_tx, radio_node_find(&base[1], node_address[0])->seq_tx);
+	}
+	return 0;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+// 0, 1 = base radios, 2, 3 = nodes
+uint8_t sim_index(radio_t* obj) {
+	return (obj >= base && obj < base + ROUTE_MAX_RADIOS) ? (uint8_t)(obj - base) : (uint8_t)(2 + (obj - nodes));
+}
+
+void sim_put(uint8_t k, uint8_t from, uint8_t source, uint8_t* data, uint8_t len, int16_t rssi) {
+	sim_air_t* a = &air[k];
+	if (a->tail - a->head >= SIM_QUEUE_SIZE) { return; }
+	sim_frame_t* frame = &a->frames[a->tail++ % SIM_QUEUE_SIZE];
+	frame->from = from;
+	frame->source = source;
+	frame->len = len;
+	frame->rssi = rssi;
+	memcpy(frame->data, data, len);
+}
+
+// 1 ms: loop() of the nodes and the base station
+void sim_step(void) {
+	radio_loop(&nodes[0]);
+	radio_loop(&nodes[1]);
+	route_loop(&route);
+	uint8_t in_flight = 0;
+	for (uint8_t i = 0; i < ROUTE_MAX_RADIOS; i++) {
+		in_flight += base[i].tx_wait ? 1 : 0;
+	}
+	if (in_flight > 0) { steps_in_flight++; }
+	if (in_flight > 1) { steps_both++; }
+	now++;
+}
+
+void receive_base(uint8_t source, uint8_t* data, uint16_t len) {
+	if (!route_deliver(&route, source, now)) { return; }
+	delivered[source == node_address[0] ? 0 : 1]++;
+}
+
+void receive_node0(uint8_t source, uint8_t* data, uint16_t len) {
+	node_received[0]++;
+}
+
+void receive_node1(uint8_t source, uint8_t* data, uint16_t len) {
+	node_received[1]++;
+}
+
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	tx_status_count[status]++;
+}
+
+void error_handler(radio_error_code_t error) {
+}
+
+void sim_delay(uint32_t ms) {
+	now = now + ms;
+}
+
+uint32_t sim_millis(void) {
+	return now;
+}
+
+
+/* Transceiver functions (radio.h, RADIO_RFM_STATIC) --------------------------------------------*/
+
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	uint8_t k = sim_index(obj);
+	air[k].ack_time = 0;
+	if (k < 2) {
+		uint8_t n = (dest == node_address[0]) ? 0 : 1;
+		if (link_rssi[k][n] > SIM_NO_LINK && rand() % 100 >= loss_pct) { sim_put(2 + n, k, obj->address, data, len, link_rssi[k][n]); }
+	} else {
+		for (uint8_t b = 0; b < ROUTE_MAX_RADIOS; b++) {
+			if (link_rssi[b][k - 2] > SIM_NO_LINK && rand() % 100 >= loss_pct) { sim_put(b, k, obj->address, data, len, link_rssi[b][k - 2]); }
+		}
+	}
+	return 0;
+}
+
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+	uint8_t k = sim_index(obj);
+	sim_air_t* a = &air[k];
+	sim_frame_t* frame = &a->frames[a->head++ % SIM_QUEUE_SIZE];
+	*src = frame->source;
+	*len = frame->len;
+	memcpy(data, frame->data, frame->len);
+	a->last_from = frame->from;
+	if (k < 2) {
+		radio_node_set_rssi(obj, frame->source, frame->rssi);
+		route_rx(&route, obj, frame->source, frame->rssi, now);
+	}
+	return 0;
+}
+
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	sim_air_t* a = &air[sim_index(obj)];
+	a->acks_sent++;
+	if (rand() % 100 >= loss_pct) { air[a->last_from].ack_time = now + SIM_ACK_MS; }
+	return 0;
+}
+
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+	sim_air_t* a = &air[sim_index(obj)];
+	if (a->ack_time == 0 || (int32_t)(now - a->ack_time) < 0) { return 0; }
+	a->ack_time = 0;
+	return 1;
+}
+
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+	return (sim_index(obj) < 2) ? route_ack(&route, obj, src) : 1;
+}
+
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+	sim_air_t* a = &air[sim_index(obj)];
+	return a->head != a->tail;
+}
+
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+	return 1;
+}
@@ -0,0 +1,395 @@
+/////////////////////////////////////////////////////
+// FILENAME:    sim_relay.c                        //
+// DESCRIPTION: host simulation of relayed frames  //
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+// Simulation of a repeater chain on a host: base 0x01 - repeater 0x02 - repeater 0x03 - repeater 0x04, one node
+// per hop count (0x11 at the base, 0x12 at 0x02, 0x13 at 0x03, 0x14 at 0x04, paths set by radio_relay_set_path()).
+// - air: frames only reach the neighbours of the sender, the given loss applies to frames and ACKs, an ACK arrives
+//   SIM_ACK_MS after the frame was read, no collisions
+// - per hop count and direction: latency of single messages (queued -> receive() up, queued -> DELIVERED down),
+//   frames per uplink message, then goodput of SIM_BURST messages queued at once (received bytes / time until
+//   all are confirmed)
+// - bulk transfer of SIM_BULK_SIZE bytes from the base to the node of each hop count: a paused transfer is resumed
+//   after SIM_BULK_RESUME_MS (at most SIM_BULK_RESUMES times, like BULK_RESUME_INTERVAL_MS / BULK_MAX_RESUMES of the
+//   firmware), bytes/s until the node has all data, pauses, frames per chunk, data checked at the node (gaps, content)
+//
+// build (from BaseStation_PlatformIO):
+//   gcc -O2 -std=gnu99 -Iinclude -o sim_relay tools/sim_relay.c src/radio.c src/radio_lz.c src/heap.c
+// usage:
+//   ./sim_relay [loss (%)] [message length]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "radio.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define SIM_ACK_MS            8         // frame read -> ACK at the sender
+#define SIM_MESSAGES          20        // latency: messages per hop count and direction
+#define SIM_BURST             12        // goodput: messages queued at once
+#define SIM_QUEUE_SIZE        256       // frames on air per receiver (power of 2)
+#define SIM_INSTANCES         8
+#define SIM_HANDLES           65536
+#define SIM_BULK_SIZE         8192
+#define SIM_BULK_RESUME_MS    5000
+#define SIM_BULK_RESUMES      10
+#define SIM_BULK_LIMIT        600000    // ms per transfer
+
+
+/* Private typedef ------------------------------------------------------------------------------*/
+
+typedef struct {
+	uint8_t source;
+	uint8_t len;
+	uint8_t data[RADIO_FRAME_SIZE_MAX];
+	uint8_t from;                       // instance
+} sim_frame_t;
+
+typedef struct {
+	sim_frame_t frames[SIM_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t tail;
+	uint8_t  last_from;                 // sender of the last frame read (ACK)
+	uint32_t ack_time;                  // ACK of the last frame of the instance arrives, 0 = none
+} sim_air_t;
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+static uint32_t now = 1;
+static radio_t inst[SIM_INSTANCES];
+static const uint8_t address[SIM_INSTANCES] = { 0x01, 0x02, 0x03, 0x04, 0x11, 0x12, 0x13, 0x14 };
+static bool link[SIM_INSTANCES][SIM_INSTANCES];
+static sim_air_t air[SIM_INSTANCES];
+static uint8_t loss_pct = 0;
+static uint32_t frames_tx = 0;
+static uint32_t errors[radio_error_COUNT];
+
+// uplink: receive(), downlink: tx_status()
+static uint32_t rx_count = 0;
+static uint32_t rx_bytes = 0;
+static uint64_t rx_latency_sum = 0;
+static uint32_t rx_latency_max = 0;
+static uint32_t tx_status_count[radio_tx_COUNT];
+static uint64_t tx_latency_sum = 0;
+static uint32_t tx_latency_max = 0;
+static uint32_t tx_time[SIM_HANDLES];
+
+// bulk transfer: source data, state at the node
+static uint8_t  bulk_data[SIM_BULK_SIZE];
+static uint32_t bulk_expected;          // next offset the node expects
+static uint32_t bulk_chunks;            // chunks passed to the node
+static uint32_t bulk_gaps;              // chunks not at the expected offset
+static uint32_t bulk_corrupt;           // chunks with wrong content
+static bool     bulk_complete;          // node: radio_bulk_DONE
+static uint32_t bulk_pauses;            // base: radio_bulk_PAUSED
+static uint32_t bulk_time_paused;
+
+RADIO_DEFINE_GEOMETRY(geometry0, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry1, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry2, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry3, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry4, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry5, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry6, 30, 30, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry7, 30, 30, RADIO_FRAME_SIZE_MAX);
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t  sim_index       (radio_t* obj);
+void     sim_connect     (uint8_t a, uint8_t b);
+void     sim_step        (void);
+bool     sim_idle        (void);
+void     sim_send        (radio_t* src, uint8_t dest, uint8_t* data, uint16_t len);
+void     receive         (uint8_t source, uint8_t* data, uint16_t len);
+void     tx_status       (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+uint16_t bulk_read       (uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len);
+void     bulk_receive    (uint8_t source, uint8_t transfer_id, uint32_t offset, uint32_t total, uint8_t* data, uint16_t len);
+void     bulk_done       (uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset);
+void     error_handler   (radio_error_code_t error);
+void     sim_delay       (uint32_t ms);
+uint32_t sim_millis      (void);
+
+
+/* Main -----------------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+	loss_pct = (argc > 1) ? atoi(argv[1]) : 0;
+	uint16_t len = (argc > 2) ? atoi(argv[2]) : 40;
+	if (len < 4 || len > 200) { len = 40; }
+
+	const radio_geometry_t* geometry[SIM_INSTANCES] = {
+		&geometry0, &geometry1, &geometry2, &geometry3, &geometry4, &geometry5, &geometry6, &geometry7 };
+	for (uint8_t k = 0; k < SIM_INSTANCES; k++) {
+		radio_init(&inst[k], address[k], geometry[k]);
+		radio_set_cb_func(&inst[k], receive, sim_delay, error_handler, sim_millis);
+		radio_set_cb_tx_status(&inst[k], (void*)tx_status);
+		radio_set_cb_bulk(&inst[k], (void*)bulk_read, (void*)bulk_receive, (void*)bulk_done);
+	}
+	sim_connect(0, 1);
+	sim_connect(1, 2);
+	sim_connect(2, 3);
+	sim_connect(0, 4);
+	sim_connect(1, 5);
+	sim_connect(2, 6);
+	sim_connect(3, 7);
+	for (uint8_t k = 1; k <= 3; k++) {
+		radio_set_relay(&inst[k], true);
+	}
+	uint8_t path1[] = { 0x02 };
+	uint8_t path2[] = { 0x03, 0x02 };
+	uint8_t path3[] = { 0x04, 0x03, 0x02 };
+	radio_relay_set_path(&inst[5], 0x01, path1, 1);
+	radio_relay_set_path(&inst[6], 0x01, path2, 2);
+	radio_relay_set_path(&inst[7], 0x01, path3, 3);
+
+	uint8_t data[200];
+	memset(data, 'x', sizeof(data));
+	printf("loss %u%%, %u bytes, ACK turnaround %u ms\n", loss_pct, len, SIM_ACK_MS);
+	printf("hops | up: latency avg / max  goodput  frames/msg | down: latency avg / max  goodput  delivered / failed\n");
+	for (uint8_t hops = 0; hops <= 3; hops++) {
+		uint8_t node = 4 + hops;
+		double latency[2];
+		uint32_t latency_max[2];
+		double goodput[2];
+		double frames_per_msg = 0;
+		uint32_t ok = 0;
+		uint32_t failed = 0;
+		for (uint8_t down = 0; down < 2; down++) {
+			radio_t* src = down ? &inst[0] : &inst[node];
+			uint8_t dest = down ? address[node] : 0x01;
+
+			// latency: one message at a time
+			rx_count = 0;
+			rx_latency_sum = 0;
+			rx_latency_max = 0;
+			tx_latency_sum = 0;
+			tx_latency_max = 0;
+			uint32_t delivered0 = tx_status_count[radio_tx_DELIVERED];
+			uint32_t failed0 = tx_status_count[radio_tx_FAILED];
+			uint32_t frames0 = frames_tx;
+			for (uint8_t i = 0; i < SIM_MESSAGES; i++) {
+				sim_send(src, dest, data, len);
+				uint32_t time_start = now;
+				while ((!radio_buffer_empty_tx(src) || !sim_idle()) && now - time_start < 60000) { sim_step(); }
+				for (uint8_t j = 0; j < 20; j++) { sim_step(); }
+			}
+			if (down) {
+				ok = tx_status_count[radio_tx_DELIVERED] - delivered0;
+				failed = tx_status_count[radio_tx_FAILED] - failed0;
+				latency[1] = ok ? (double)tx_latency_sum / ok : 0;
+				latency_max[1] = tx_latency_max;
+			} else {
+				latency[0] = rx_count ? (double)rx_latency_sum / rx_count : 0;
+				latency_max[0] = rx_latency_max;
+				frames_per_msg = (double)(frames_tx - frames0) / SIM_MESSAGES;
+			}
+
+			// goodput: messages queued at once
+			rx_bytes = 0;
+			uint32_t time_start = now;
+			for (uint8_t i = 0; i < SIM_BURST; i++) {
+				sim_send(src, dest, data, len);
+			}
+			while (!sim_idle() && now - time_start < 600000) { sim_step(); }
+			goodput[down] = rx_bytes * 1000.0 / (now - time_start);
+		}
+		printf("%u    | %5.0f / %5lu ms  %5.0f B/s  %5.1f      | %5.0f / %5lu ms    %5.0f B/s  %lu / %lu\n", hops,
+		       latency[0], (unsigned long)latency_max[0], goodput[0], frames_per_msg,
+		       latency[1], (unsigned long)latency_max[1], goodput[1], (unsigned long)ok, (unsigned long)failed);
+	}
+	printf("hops of 0x14 at the base %u, forwarded %lu / %lu / %lu, dropped %lu / %lu / %lu, "
+	       "errors relay dropped %lu / timeout %lu, status forwarded %lu\n",
+	       radio_node_find(&inst[0], 0x14)->relay_hops,
+	       (unsigned long)inst[1].relay_forwarded, (unsigned long)inst[2].relay_forwarded, (unsigned long)inst[3].relay_forwarded,
+	       (unsigned long)inst[1].relay_dropped, (unsigned long)inst[2].relay_dropped, (unsigned long)inst[3].relay_dropped,
+	       (unsigned long)errors[radio_error_RELAY_DROPPED], (unsigned long)errors[radio_error_RELAY_TIMEOUT],
+	       (unsigned long)tx_status_count[radio_tx_FORWARDED]);
+
+	// bulk transfer to the node of each hop count
+	for (uint32_t i = 0; i < SIM_BULK_SIZE; i++) { bulk_data[i] = (uint8_t)(i * 7 + (i >> 8)); }
+	printf("bulk %u bytes base -> node, resume after %u ms (max %u)\n", SIM_BULK_SIZE, SIM_BULK_RESUME_MS, SIM_BULK_RESUMES);
+	printf("hops | bytes/s  (without pauses) | pauses  frames/chunk | received  gaps  corrupt\n");
+	for (uint8_t hops = 0; hops <= 3; hops++) {
+		uint8_t node = 4 + hops;
+		bulk_expected = 0;
+		bulk_chunks = 0;
+		bulk_gaps = 0;
+		bulk_corrupt = 0;
+		bulk_complete = false;
+		bulk_pauses = 0;
+		bulk_time_paused = 0;
+		uint32_t frames0 = frames_tx;
+		uint32_t time_start = now;
+		uint8_t resumes = 0;
+		radio_bulk_send(&inst[0], address[node], hops + 1, SIM_BULK_SIZE, 0);
+		while (!bulk_complete && now - time_start < SIM_BULK_LIMIT) {
+			if (inst[0].bulk_tx.state == radio_bulk_PAUSED) {
+				if (resumes == SIM_BULK_RESUMES) { break; }
+				for (uint32_t t = 0; t < SIM_BULK_RESUME_MS; t++) { sim_step(); }
+				bulk_time_paused += SIM_BULK_RESUME_MS;
+				radio_bulk_resume(&inst[0]);
+				resumes++;
+			}
+			sim_step();
+		}
+		uint32_t time = now - time_start;
+		while (!sim_idle() && now - time_start < SIM_BULK_LIMIT) { sim_step(); }
+		printf("%u    | %6.0f   (%6.0f)         | %5lu   %5.2f         | %5lu%s  %4lu  %7lu\n", hops,
+		       bulk_expected * 1000.0 / time, bulk_expected * 1000.0 / (time - bulk_time_paused + 1),
+		       (unsigned long)bulk_pauses, bulk_chunks ? (double)(frames_tx - frames0) / bulk_chunks : 0,
+		       (unsigned long)bulk_expected, bulk_complete ? " " : "!", (unsigned long)bulk_gaps, (unsigned long)bulk_corrupt);
+		inst[0].bulk_tx.state = radio_bulk_IDLE;
+	}
+	return 0;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+uint8_t sim_index(radio_t* obj) {
+	return (uint8_t)(obj - inst);
+}
+
+void sim_connect(uint8_t a, uint8_t b) {
+	link[a][b] = true;
+	link[b][a] = true;
+}
+
+// 1 ms: loop() of all instances
+void sim_step(void) {
+	for (uint8_t k = 0; k < SIM_INSTANCES; k++) {
+		radio_loop(&inst[k]);
+	}
+	now++;
+}
+
+// nothing queued, no relayed message waiting for its confirmation
+bool sim_idle(void) {
+	for (uint8_t k = 0; k < SIM_INSTANCES; k++) {
+		if (!radio_buffer_empty_tx(&inst[k]) || inst[k].relay_wait[0].valid) { return false; }
+	}
+	return true;
+}
+
+// payload starts with the queue time (latency at the receiver)
+void sim_send(radio_t* src, uint8_t dest, uint8_t* data, uint16_t len) {
+	uint16_t handle = 0;
+	memcpy(data, &now, sizeof(now));
+	radio_transmit(src, dest, data, len, &handle);
+	tx_time[handle] = now;
+}
+
+void receive(uint8_t source, uint8_t* data, uint16_t len) {
+	uint32_t time;
+	memcpy(&time, data, sizeof(time));
+	rx_count++;
+	rx_bytes += len;
+	rx_latency_sum += now - time;
+	if (now - time > rx_latency_max) { rx_latency_max = now - time; }
+}
+
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+	tx_status_count[status]++;
+	if (status == radio_tx_DELIVERED) {
+		uint32_t latency = now - tx_time[handle];
+		tx_latency_sum += latency;
+		if (latency > tx_latency_max) { tx_latency_max = latency; }
+	}
+}
+
+// base: the chunk of the source data
+uint16_t bulk_read(uint8_t dest, uint8_t transfer_id, uint32_t offset, uint8_t* data, uint16_t len) {
+	if (offset + len > SIM_BULK_SIZE) { return 0; }
+	memcpy(data, bulk_data + offset, len);
+	return len;
+}
+
+// node: chunks must continue at the last offset (a resumed transfer repeats nothing) and match the source
+void bulk_receive(uint8_t source, uint8_t transfer_id, uint32_t offset, uint32_t total, uint8_t* data, uint16_t len) {
+	bulk_chunks++;
+	if (offset != bulk_expected) { bulk_gaps++; }
+	if (offset + len > SIM_BULK_SIZE || memcmp(data, bulk_data + offset, len) != 0) { bulk_corrupt++; }
+	bulk_expected = offset + len;
+}
+
+// node: complete (source 0x01), base: paused or done (destination)
+void bulk_done(uint8_t address, uint8_t transfer_id, radio_bulk_status_t status, uint32_t offset) {
+	if (address == 0x01 && status == radio_bulk_DONE) { bulk_complete = true; }
+	if (address != 0x01 && status == radio_bulk_PAUSED) { bulk_pauses++; }
+}
+
+void error_handler(radio_error_code_t error) {
+	errors[error]++;
+}
+
+void sim_delay(uint32_t ms) {
+	now = now + ms;
+}
+
+uint32_t sim_millis(void) {
+	return now;
+}
+
+
+/* Transceiver functions (radio.h, RADIO_RFM_STATIC) --------------------------------------------*/
+
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	uint8_t k = sim_index(obj);
+	air[k].ack_time = 0;
+	frames_tx++;
+	for (uint8_t j = 0; j < SIM_INSTANCES; j++) {
+		if (!link[k][j] || (address[j] != dest && dest != RADIO_BROADCAST) || rand() % 100 < loss_pct) { continue; }
+		sim_air_t* a = &air[j];
+		if (a->tail - a->head >= SIM_QUEUE_SIZE) { continue; }
+		sim_frame_t* frame = &a->frames[a->tail++ % SIM_QUEUE_SIZE];
+		frame->source = obj->address;
+		frame->from = k;
+		frame->len = len;
+		memcpy(frame->data, data, len);
+	}
+	return 0;
+}
+
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+	sim_air_t* a = &air[sim_index(obj)];
+	sim_frame_t* frame = &a->frames[a->head++ % SIM_QUEUE_SIZE];
+	*src = frame->source;
+	*len = frame->len;
+	memcpy(data, frame->data, frame->len);
+	a->last_from = frame->from;
+	return 0;
+}
+
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	sim_air_t* a = &air[sim_index(obj)];
+	if (rand() % 100 >= loss_pct) { air[a->last_from].ack_time = now + SIM_ACK_MS; }
+	return 0;
+}
+
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+	sim_air_t* a = &air[sim_index(obj)];
+	if (a->ack_time == 0 || (int32_t)(now - a->ack_time) < 0) { return 0; }
+	a->ack_time = 0;
+	return 1;
+}
+
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+	return 1;
+}
+
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+	sim_air_t* a = &air[sim_index(obj)];
+	return a->head != a->tail;
+}
+
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+	return 1;
+}
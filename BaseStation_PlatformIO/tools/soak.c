@@ -0,0 +1,260 @@
+/////////////////////////////////////////////////////
+// FILENAME:    soak.c                             //
+// DESCRIPTION: host soak test of the heap counters//
+// AUTHOR:      Moritz Kimmig                      //
+// DATE:        see header                         //
+// VERSION:     see header                         //
+/////////////////////////////////////////////////////
+
+// Soak test of the radio lib on a host: a base (address 1) and a node (address 2) exchange messages over a lossy
+// link while allocations fail now and then, afterwards the heap counters of heap.c have to be back at the baseline
+// (no block / byte left, no invalid free). Exit code 0 = passed, the leaking call sites are listed otherwise.
+// - messages: single and multi frame, compressible and random data, uplinks of the node, messages to a node that
+//   never answers (retries, failed), group messages with ACKs
+// - air: frames go to a queue of the other instance, SOAK_LOSS_PCT of the frames (and their ACKs) are lost, the
+//   receiver of a frame runs its loop before the sender checks the ACK (synchronous peer)
+// - allocation failures: heap.c is compiled with malloc() replaced by soak_malloc(), which fails
+//   SOAK_MALLOC_FAIL_PCT of the allocations during the test
+// - after the test the buffers are drained, timed out and swept (radio_sweep())
+//
+// build (from BaseStation_PlatformIO):
+//   gcc -O2 -std=gnu99 -Iinclude -Dmalloc=soak_malloc -c -o soak_heap.o src/heap.c
+//   gcc -O2 -std=gnu99 -Iinclude -o soak tools/soak.c src/radio.c src/radio_lz.c soak_heap.o
+// usage:
+//   ./soak [messages] [seed]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "radio.h"
+#include "heap.h"
+
+
+/* Private define -------------------------------------------------------------------------------*/
+
+#define SOAK_MESSAGES         100000    // default number of messages of the base
+#define SOAK_LOSS_PCT         5         // frames lost on air
+#define SOAK_MALLOC_FAIL_PCT  2         // failed allocations
+#define SOAK_QUEUE_SIZE       256       // frames on air per receiver (power of 2)
+#define SOAK_BASE             0x01
+#define SOAK_NODE             0x02
+#define SOAK_ABSENT           0x33      // node that never answers
+#define SOAK_DRAIN_MS         200000
+#define SOAK_SWEEP_MS         4000000   // idle time before radio_sweep(), longer than every timeout
+
+
+/* Private typedef ------------------------------------------------------------------------------*/
+
+typedef struct {
+	uint8_t source;
+	uint8_t dest;
+	uint8_t len;
+	uint8_t data[RADIO_FRAME_SIZE_MAX];
+} soak_frame_t;
+
+typedef struct {
+	soak_frame_t frames[SOAK_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t tail;
+	bool     ack;                       // last frame of the instance reached the receiver
+} soak_air_t;
+
+
+/* Private variables ----------------------------------------------------------------------------*/
+
+static uint32_t now = 0;
+static radio_t radios[2];
+static soak_air_t air[2];               // frames to radios[n], ACK of the last frame of radios[n]
+static bool in_peer = false;
+static uint8_t loss_pct = 0;
+static uint8_t malloc_fail_pct = 0;
+static uint32_t received[2];
+static uint32_t malloc_fails = 0;
+static uint32_t overruns = 0;
+RADIO_DEFINE_GEOMETRY(geometry_base, 50, 50, RADIO_FRAME_SIZE_MAX);
+RADIO_DEFINE_GEOMETRY(geometry_node, 50, 50, RADIO_FRAME_SIZE_MAX);
+
+
+/* Private function prototypes ------------------------------------------------------------------*/
+
+uint8_t  soak_index      (radio_t* obj);
+void     soak_step       (uint16_t loops, uint32_t ms);
+void     receive_base    (uint8_t source, uint8_t* data, uint16_t len);
+void     receive_node    (uint8_t source, uint8_t* data, uint16_t len);
+void     tx_status       (uint8_t dest, uint16_t handle, radio_tx_status_t status);
+void     error_handler   (radio_error_code_t error);
+void     soak_delay      (uint32_t ms);
+uint32_t soak_millis     (void);
+void*    soak_malloc     (size_t size);
+
+
+/* Main -----------------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+	uint32_t messages = (argc > 1) ? strtoul(argv[1], NULL, 0) : SOAK_MESSAGES;
+	srand((argc > 2) ? strtoul(argv[2], NULL, 0) : 1);
+
+	radio_init(&radios[0], SOAK_BASE, &geometry_base);
+	radio_set_cb_func(&radios[0], receive_base, soak_delay, error_handler, soak_millis);
+	radio_set_cb_tx_status(&radios[0], (void*)tx_status);
+	radio_init(&radios[1], SOAK_NODE, &geometry_node);
+	radio_set_cb_func(&radios[1], receive_node, soak_delay, error_handler, soak_millis);
+
+	// baseline after the init (static buffers, nothing malloc'ed yet)
+	heap_t* heap = heap_get();
+	uint32_t base_blocks = heap->blocks;
+	uint32_t base_bytes = heap->bytes;
+
+	loss_pct = SOAK_LOSS_PCT;
+	malloc_fail_pct = SOAK_MALLOC_FAIL_PCT;
+	uint8_t data[600];
+	for (uint32_t k = 0; k < messages; k++) {
+		uint16_t len = (k % 10 == 0) ? 300 + rand() % 300 : 1 + rand() % 80;
+		for (uint16_t i = 0; i < len; i++) {
+			data[i] = (k % 3 == 0) ? 'a' + (i % 4) : rand();
+		}
+		radio_transmit(&radios[0], SOAK_NODE, data, len, NULL);
+		if (k % 7 == 0) { radio_transmit(&radios[1], SOAK_BASE, data, len % 50 + 1, NULL); }
+		if (k % 101 == 0) { radio_transmit(&radios[0], SOAK_ABSENT, data, len % 200 + 1, NULL); }
+		if (k % 211 == 0) { radio_group_transmit(&radios[0], SOAK_NODE & 0xF0, data, len % 40 + 1, true); }
+		soak_step(3, 10);
+	}
+
+	// drain, time out what is left and sweep
+	loss_pct = 0;
+	malloc_fail_pct = 0;
+	soak_step(SOAK_DRAIN_MS / 10, 10);
+	now = now + SOAK_SWEEP_MS;
+	radio_sweep(&radios[0]);
+	radio_sweep(&radios[1]);
+	soak_step(100, 1);
+
+	bool passed = heap->blocks == base_blocks && heap->bytes == base_bytes && heap->invalid_frees == 0;
+	printf("messages %lu, received base %lu / node %lu, overruns %lu\n",
+	       (unsigned long)messages, (unsigned long)received[0], (unsigned long)received[1], (unsigned long)overruns);
+	printf("tx status of the base:");
+	for (uint8_t i = 0; i < radio_tx_COUNT; i++) {
+		printf(" %lu", (unsigned long)radios[0].tx_status_cnt[i]);
+	}
+	printf("\nheap: allocs %lu, fails %lu (injected %lu), invalid frees %lu, peak %lu bytes\n",
+	       (unsigned long)heap->allocs, (unsigned long)heap->fails, (unsigned long)malloc_fails,
+	       (unsigned long)heap->invalid_frees, (unsigned long)heap->bytes_max);
+	printf("heap: blocks %lu (baseline %lu), bytes %lu (baseline %lu), orphans %lu / %lu\n",
+	       (unsigned long)heap->blocks, (unsigned long)base_blocks, (unsigned long)heap->bytes,
+	       (unsigned long)base_bytes, (unsigned long)radios[0].orphans, (unsigned long)radios[1].orphans);
+	for (uint8_t i = 0; i <= HEAP_MAX_SITES; i++) {
+		heap_site_t* site = &heap->sites[i];
+		if (site->blocks) {
+			printf("leak: %s:%u, %lu blocks, %lu bytes\n", site->file ? site->file : "other", site->line,
+			       (unsigned long)site->blocks, (unsigned long)site->bytes);
+		}
+	}
+	printf("%s\n", passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+
+/* Private functions ----------------------------------------------------------------------------*/
+
+uint8_t soak_index(radio_t* obj) {
+	return (obj == &radios[1]);
+}
+
+// loops of both instances, time steps in between
+void soak_step(uint16_t loops, uint32_t ms) {
+	for (uint16_t i = 0; i < loops; i++) {
+		radio_loop(&radios[0]);
+		radio_loop(&radios[1]);
+		now = now + ms;
+	}
+}
+
+void receive_base(uint8_t source, uint8_t* data, uint16_t len) {
+	received[0]++;
+}
+
+void receive_node(uint8_t source, uint8_t* data, uint16_t len) {
+	received[1]++;
+}
+
+// counted by the radio lib (tx_status_cnt)
+void tx_status(uint8_t dest, uint16_t handle, radio_tx_status_t status) {
+}
+
+void error_handler(radio_error_code_t error) {
+}
+
+void soak_delay(uint32_t ms) {
+	now = now + ms;
+}
+
+uint32_t soak_millis(void) {
+	return now;
+}
+
+// malloc() of heap.c (-Dmalloc=soak_malloc)
+void* soak_malloc(size_t size) {
+	if (malloc_fail_pct && rand() % 100 < malloc_fail_pct) {
+		malloc_fails++;
+		return NULL;
+	}
+	return malloc(size);
+}
+
+
+/* Transceiver functions (radio.h, RADIO_RFM_STATIC) --------------------------------------------*/
+
+uint8_t radio_rfm_transmit(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	uint8_t k = soak_index(obj);
+	air[k].ack = false;
+	if (dest == SOAK_ABSENT || rand() % 100 < loss_pct) { return 0; }
+	soak_air_t* a = &air[1 - k];
+	if (a->tail - a->head >= SOAK_QUEUE_SIZE) {
+		overruns++;
+		return 0;
+	}
+	soak_frame_t* frame = &a->frames[a->tail++ % SOAK_QUEUE_SIZE];
+	frame->source = obj->address;
+	frame->dest = dest;
+	frame->len = len;
+	memcpy(frame->data, data, len);
+	air[k].ack = (rand() % 100 >= loss_pct);
+	return 0;
+}
+
+uint8_t radio_rfm_receive(radio_t* obj, uint8_t* src, uint8_t* data, uint8_t* len) {
+	soak_air_t* a = &air[soak_index(obj)];
+	soak_frame_t* frame = &a->frames[a->head++ % SOAK_QUEUE_SIZE];
+	*src = frame->source;
+	*len = frame->len;
+	memcpy(data, frame->data, frame->len);
+	return 0;
+}
+
+uint8_t radio_rfm_sendACK(radio_t* obj, uint8_t dest, uint8_t* data, uint8_t len) {
+	return 0;
+}
+
+// the receiver reads the frame (and the ACK data) before the sender checks the ACK
+uint8_t radio_rfm_ACKReceived(radio_t* obj, uint8_t dest) {
+	uint8_t k = soak_index(obj);
+	if (!in_peer) {
+		in_peer = true;
+		radio_loop(&radios[1 - k]);
+		in_peer = false;
+	}
+	return air[k].ack;
+}
+
+uint8_t radio_rfm_ACKRequested(radio_t* obj, uint8_t src) {
+	return 1;
+}
+
+uint8_t radio_rfm_receiveDone(radio_t* obj) {
+	soak_air_t* a = &air[soak_index(obj)];
+	return a->head != a->tail;
+}
+
+uint8_t radio_rfm_setLink(radio_t* obj, uint8_t rate, int8_t power) {
+	return 1;
+}